@@ -0,0 +1,62 @@
+#!/bin/bash
+
+# Runs the same Algorand scenario with the libsodium and the simulated VRF backend for several key seeds
+# and compares the mean committee sizes (block proposal, soft vote, certify vote) of both backends.
+# For every phase the difference of the means over the runs has to be within TOLERANCE standard errors:
+#   |mean_sodium - mean_simulated| <= TOLERANCE * sqrt(var_sodium / RUNS + var_simulated / RUNS)
+# The script exits with 1 if a phase differs more, with 2 if a run did not print its statistics.
+# Launch it from the ns-3 folder, the parameters are passed to algorand-test.
+#
+# Environment: RUNS - number of the seeds per backend (default 10)
+#              TOLERANCE - allowed difference in standard errors (default 3)
+
+RUNS=${RUNS:-10}
+TOLERANCE=${TOLERANCE:-3}
+PARAMS=${@:-"--stop=3 --nodes=50 --lzBP=1 --lzSV=0 --lzCV=0 --intervalBP=3 --intervalSV=1 --intervalCV=2"}
+RESULTS=$(mktemp)
+trap 'rm -f "$RESULTS"' EXIT
+
+for BACKEND in false true
+do
+  for SEED in $(seq 1 "$RUNS")
+  do
+    OUTPUT=$(./waf --run "algorand-test $PARAMS --simulatedVrf=$BACKEND --keySeed=$SEED" 2>/dev/null)
+    BP=$(echo "$OUTPUT" | sed -n 's/^Mean Block Proposal Committee Size = //p')
+    SV=$(echo "$OUTPUT" | sed -n 's/^Mean Soft Vote Committee Size = //p')
+    CV=$(echo "$OUTPUT" | sed -n 's/^Mean Certify Vote Committee Size = //p')
+
+    if [ -z "$BP" ] || [ -z "$SV" ] || [ -z "$CV" ]
+    then
+      echo "simulatedVrf=$BACKEND keySeed=$SEED: no committee size statistics"
+      exit 2
+    fi
+
+    echo "simulatedVrf=$BACKEND keySeed=$SEED: BP $BP, SV $SV, CV $CV"
+    echo "$BACKEND $BP $SV $CV" >> "$RESULTS"
+  done
+done
+
+awk -v tolerance="$TOLERANCE" '
+  {
+    b = ($1 == "true") ? 1 : 0
+    n[b]++
+    for (p = 2; p <= 4; p++) { sum[b, p] += $p; sumSq[b, p] += $p * $p }
+  }
+  END {
+    split("BP SV CV", names, " ")
+    failed = 0
+    printf "%-6s %12s %12s %12s %12s %8s\n", "phase", "sodium mean", "sodium var", "sim. mean", "sim. var", "z"
+    for (p = 2; p <= 4; p++) {
+      for (b = 0; b <= 1; b++) {
+        mean[b] = sum[b, p] / n[b]
+        var[b] = (n[b] > 1) ? (sumSq[b, p] - n[b] * mean[b] * mean[b]) / (n[b] - 1) : 0
+        if (var[b] < 0) var[b] = 0
+      }
+      diff = mean[0] - mean[1]; if (diff < 0) diff = -diff
+      se = sqrt(var[0] / n[0] + var[1] / n[1])
+      z = (se > 0) ? diff / se : (diff > 0 ? 1e9 : 0)
+      if (z > tolerance) failed = 1
+      printf "%-6s %12.4f %12.4f %12.4f %12.4f %8.2f%s\n", names[p - 1], mean[0], var[0], mean[1], var[1], z, (z > tolerance) ? " DIFFERENT" : ""
+    }
+    exit failed
+  }' "$RESULTS"
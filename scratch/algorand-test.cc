@@ -83,8 +83,20 @@ main (int argc, char *argv[])
   bool allPrint = false;
 
   bool attack = false;
+  bool jsonCodec = false;
+  bool simulatedVrf = false;
+  double vrfProveDelay = 0;
+  double vrfVerifyDelay = 0;
+  int vrfThreads = 1;
+  int keySeed = -1;
+  std::string keyPool = "";
+  bool generateKeyPool = false;
+  bool vrfCrossCheck = false;
   int noAttackers = 1;
   double attackPower = 0.3;
+  int committeeStake = 0;
+  int sortitionSize = 0;
+  long sortitionTotalStake = 0;
 
   // intervals between phases (in seconds)
   double intervalBP = 4;
@@ -153,9 +165,49 @@ main (int argc, char *argv[])
   cmd.AddValue ("allPrint", "On the end of simulation, each participant will print its blockchain stats", allPrint);
   cmd.AddValue ("attack", "Provide attack scenario when attacker was chosen to soft vote committee", attack);
   cmd.AddValue ("attackPower", "Wanted attack power (attacker stake : total stakes) of the attackers vote", attackPower);
-
+  cmd.AddValue ("committeeStake", "Expected stake of the vote committee, the vote phases end as soon as its quorum is reached (0 waits for the intervals)", committeeStake);
+  cmd.AddValue ("sortitionSize", "Expected weight of the vote committee selected by the stake weighted sortition (0 for the VRF threshold)", sortitionSize);
+  cmd.AddValue ("sortitionTotalStake", "Total stake of all participants for the sortition (0 = nodes * stakeSize)", sortitionTotalStake);
+
+  cmd.AddValue ("jsonCodec", "Send the messages as json instead of the compact binary encoding (debugging)", jsonCodec);
+  cmd.AddValue ("simulatedVrf", "Use the keyed hash instead of the libsodium VRF (faster, not secure)", simulatedVrf);
+  cmd.AddValue ("vrfProveDelay", "Simulated CPU time of one VRF prove (seconds)", vrfProveDelay);
+  cmd.AddValue ("vrfVerifyDelay", "Simulated CPU time of one VRF verification (seconds)", vrfVerifyDelay);
+  cmd.AddValue ("vrfThreads", "Number of threads computing the VRF proofs of the participants due at the same time", vrfThreads);
+  cmd.AddValue ("keySeed", "Derive the VRF keys and seeds from the seed, the runs select the same committees (-1 = random keys)", keySeed);
+  cmd.AddValue ("keyPool", "Load the VRF keys of the participants from the pool file", keyPool);
+  cmd.AddValue ("generateKeyPool", "Write the keys derived from keySeed (required) for all nodes to the keyPool file and exit", generateKeyPool);
+  cmd.AddValue ("vrfCrossCheck", "Verify the cached VRF verification results again and stop on mismatch (debugging)", vrfCrossCheck);
   cmd.Parse(argc, argv);
 
+  if (jsonCodec)
+    MessageCodec::SetDefaultType (JSON_CODEC);
+  if (simulatedVrf)
+    VrfBackend::SetType (SIMULATED_VRF);
+  VrfBackend::SetCpuDelays (vrfProveDelay, vrfVerifyDelay);
+  BatchVrfProver::GetInstance().SetNoThreads (vrfThreads);
+  if (sortitionTotalStake == 0 && stakeSize != -1)
+    sortitionTotalStake = static_cast<long>(totalNoNodes) * stakeSize;
+  if (generateKeyPool && keySeed < 0)
+  {
+    std::cout << "generateKeyPool requires keySeed >= 0, the keys of the pool are derived from it\n";
+    return 1;
+  }
+  if (keySeed >= 0)
+    VrfKeyPool::GetInstance().SetSeed (keySeed);
+  if (generateKeyPool)
+  {
+    if (!VrfKeyPool::GetInstance().Save (keyPool, totalNoNodes))
+      std::cout << "Cannot write the key pool " << keyPool << "\n";
+    return 0;
+  }
+  if (keyPool != "" && !VrfKeyPool::GetInstance().Load (keyPool))
+  {
+    std::cout << "Cannot load the key pool " << keyPool << "\n";
+    return 0;
+  }
+  VrfVerifyCache::GetInstance().SetCrossCheck (vrfCrossCheck);
+
   // all nodes are participants
   noMiners = totalNoNodes;
 
@@ -258,6 +310,9 @@ main (int argc, char *argv[])
         algorandVoterHelper.SetAttribute("FixedBlockSize", UintegerValue(blockSize));
       if (stakeSize != -1)
         algorandVoterHelper.SetAttribute("FixedStakeSize", UintegerValue(stakeSize));
+      algorandVoterHelper.SetAttribute("TotalCommitteeStake", UintegerValue(committeeStake));
+      algorandVoterHelper.SetAttribute("SortitionCommitteeSize", UintegerValue(sortitionSize));
+      algorandVoterHelper.SetAttribute("SortitionTotalStake", UintegerValue(sortitionTotalStake));
 
       if(systemId == 0 && attack && noAttackers != 0){
         algorandVoterHelper.SetAttribute("IsAttacker", BooleanValue(true));
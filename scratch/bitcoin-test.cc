@@ -54,6 +54,7 @@ main (int argc, char *argv[])
   bool sendheaders = false;
   bool blockTorrent = false;
   bool spv = false;
+  bool jsonCodec = false;
   long blockSize = -1;
   int invTimeoutMins = -1;
   int chunkSize = -1;
@@ -143,7 +144,11 @@ main (int argc, char *argv[])
   cmd.AddValue ("blockTorrent", "Enable the BlockTorrent protocol", blockTorrent);
   cmd.AddValue ("spv", "Enable the spv mechanism", spv);
 
+  cmd.AddValue ("jsonCodec", "Send the messages as json instead of the compact binary encoding (debugging)", jsonCodec);
   cmd.Parse(argc, argv);
+
+  if (jsonCodec)
+    MessageCodec::SetDefaultType (JSON_CODEC);
  
   if (noMiners % 16 != 0)
   {
@@ -66,6 +66,10 @@ main (int argc, char *argv[])
   bool sendheaders = false;
   bool blockTorrent = false;
   bool spv = false;
+  bool jsonCodec = false;
+  bool simulatedVrf = false;
+  bool pruneFinalized = false;
+  bool earlyJustification = false;
   long blockSize = -1;
   int invTimeoutMins = -1;
   int chunkSize = -1;
@@ -144,8 +148,17 @@ main (int argc, char *argv[])
   cmd.AddValue ("stop", "Stop simulation after X simulation minutes", stop);
   cmd.AddValue ("epochSize", "Number of blocks in one Gasper epoch", epochSize);
 
+  cmd.AddValue ("jsonCodec", "Send the messages as json instead of the compact binary encoding (debugging)", jsonCodec);
+  cmd.AddValue ("simulatedVrf", "Use the keyed hash instead of the libsodium VRF (faster, not secure)", simulatedVrf);
+  cmd.AddValue ("pruneFinalized", "Prune the blocks below the finalized checkpoints (long simulations)", pruneFinalized);
+  cmd.AddValue ("earlyJustification", "Justify a link as soon as it has votes of more than 2/3 of the voters (not waiting for the next checkpoint)", earlyJustification);
   cmd.Parse(argc, argv);
 
+  if (jsonCodec)
+    MessageCodec::SetDefaultType (JSON_CODEC);
+  if (simulatedVrf)
+    VrfBackend::SetType (SIMULATED_VRF);
+
   // total number of nodes is Miners + Voters (standard nodes are out of game for our simulation purposes)
   totalNoNodes = noMiners + noVoters;
 
@@ -243,6 +256,7 @@ main (int argc, char *argv[])
   {
     bitcoinMinerHelper.SetAttribute("FixedBlockIntervalGeneration", DoubleValue(averageBlockGenIntervalSeconds));
   }
+  bitcoinMinerHelper.SetAttribute("PruneFinalized", BooleanValue(pruneFinalized));
 
   for(auto &miner : miners)
   {
@@ -292,6 +306,8 @@ main (int argc, char *argv[])
                                           nodesConnections[miners[0]], noMiners, peersDownloadSpeeds[0], peersUploadSpeeds[0],
                                           nodesInternetSpeeds[0], stats);
   ApplicationContainer casperVoters;
+  casperHelper.SetAttribute("PruneFinalized", BooleanValue(pruneFinalized));
+  casperHelper.SetAttribute("TotalVoteWeight", UintegerValue(earlyJustification ? noVoters : 0));
 
   for(auto &node : nodesConnections)
   {
@@ -73,6 +73,8 @@ main (int argc, char *argv[])
 
   long blockSize = -1;
   int stakeSize = -1;
+  int sortitionSize = 0;
+  long sortitionTotalStake = 0;
   int totalNoNodes = 16;
   int failedNodes = 0;
   int minConnectionsPerNode = -1;
@@ -81,6 +83,16 @@ main (int argc, char *argv[])
   enum BitcoinRegion *minersRegions;
   int noMiners = 16;
   bool allPrint = false;
+  bool jsonCodec = false;
+  bool simulatedVrf = false;
+  double vrfProveDelay = 0;
+  double vrfVerifyDelay = 0;
+  int vrfThreads = 1;
+  int keySeed = -1;
+  std::string keyPool = "";
+  bool generateKeyPool = false;
+  bool vrfCrossCheck = false;
+  bool pruneFinalized = false;
 
   int epochSize = 64;
 
@@ -128,6 +140,8 @@ main (int argc, char *argv[])
   cmd.AddValue ("nullmsg", "Enable the use of null-message synchronization", nullmsg);
   cmd.AddValue ("blockSize", "The the fixed block size (Bytes)", blockSize);
   cmd.AddValue ("stakeSize", "The the fixed stake size", stakeSize);
+  cmd.AddValue ("sortitionSize", "Expected weight of the attest committee selected by the stake weighted sortition (0 for the VRF threshold)", sortitionSize);
+  cmd.AddValue ("sortitionTotalStake", "Total stake of all participants for the sortition (0 = nodes * stakeSize)", sortitionTotalStake);
   cmd.AddValue ("nodes", "The total number of nodes in the network", totalNoNodes);
   cmd.AddValue ("failedNodes", "The total number of failed nodes in the network, does not participate", failedNodes);
 //  cmd.AddValue ("miners", "The total number of miners in the network", noMiners);
@@ -145,8 +159,46 @@ main (int argc, char *argv[])
   cmd.AddValue ("allPrint", "On the end of simulation, each participant will print its blockchain stats", allPrint);
   cmd.AddValue ("epochSize", "Number of blocks in one Gasper epoch", epochSize);
 
+  cmd.AddValue ("jsonCodec", "Send the messages as json instead of the compact binary encoding (debugging)", jsonCodec);
+  cmd.AddValue ("simulatedVrf", "Use the keyed hash instead of the libsodium VRF (faster, not secure)", simulatedVrf);
+  cmd.AddValue ("vrfProveDelay", "Simulated CPU time of one VRF prove (seconds)", vrfProveDelay);
+  cmd.AddValue ("vrfVerifyDelay", "Simulated CPU time of one VRF verification (seconds)", vrfVerifyDelay);
+  cmd.AddValue ("vrfThreads", "Number of threads computing the VRF proofs of the participants due at the same time", vrfThreads);
+  cmd.AddValue ("keySeed", "Derive the VRF keys and seeds from the seed, the runs select the same committees (-1 = random keys)", keySeed);
+  cmd.AddValue ("keyPool", "Load the VRF keys of the participants from the pool file", keyPool);
+  cmd.AddValue ("generateKeyPool", "Write the keys derived from keySeed (required) for all nodes to the keyPool file and exit", generateKeyPool);
+  cmd.AddValue ("vrfCrossCheck", "Verify the cached VRF verification results again and stop on mismatch (debugging)", vrfCrossCheck);
+  cmd.AddValue ("pruneFinalized", "Prune the blocks below the finalized checkpoints (long simulations)", pruneFinalized);
   cmd.Parse(argc, argv);
 
+  if (jsonCodec)
+    MessageCodec::SetDefaultType (JSON_CODEC);
+  if (simulatedVrf)
+    VrfBackend::SetType (SIMULATED_VRF);
+  VrfBackend::SetCpuDelays (vrfProveDelay, vrfVerifyDelay);
+  BatchVrfProver::GetInstance().SetNoThreads (vrfThreads);
+  if (sortitionTotalStake == 0 && stakeSize != -1)
+    sortitionTotalStake = static_cast<long>(totalNoNodes) * stakeSize;
+  if (generateKeyPool && keySeed < 0)
+  {
+    std::cout << "generateKeyPool requires keySeed >= 0, the keys of the pool are derived from it\n";
+    return 1;
+  }
+  if (keySeed >= 0)
+    VrfKeyPool::GetInstance().SetSeed (keySeed);
+  if (generateKeyPool)
+  {
+    if (!VrfKeyPool::GetInstance().Save (keyPool, totalNoNodes))
+      std::cout << "Cannot write the key pool " << keyPool << "\n";
+    return 0;
+  }
+  if (keyPool != "" && !VrfKeyPool::GetInstance().Load (keyPool))
+  {
+    std::cout << "Cannot load the key pool " << keyPool << "\n";
+    return 0;
+  }
+  VrfVerifyCache::GetInstance().SetCrossCheck (vrfCrossCheck);
+
   // all nodes are participants
   noMiners = totalNoNodes;
 
@@ -246,8 +298,11 @@ main (int argc, char *argv[])
         gasperVoterHelper.SetAttribute("FixedBlockSize", UintegerValue(blockSize));
       if (stakeSize != -1)
         gasperVoterHelper.SetAttribute("FixedStakeSize", UintegerValue(stakeSize));
+      gasperVoterHelper.SetAttribute("SortitionCommitteeSize", UintegerValue(sortitionSize));
+      gasperVoterHelper.SetAttribute("SortitionTotalStake", UintegerValue(sortitionTotalStake));
 
       gasperVoterHelper.SetAttribute("Cryptocurrency", UintegerValue(GASPER));
+      gasperVoterHelper.SetAttribute("PruneFinalized", BooleanValue(pruneFinalized));
 
       gasperVoterHelper.SetPeersAddresses (nodesConnections[miner]);
 	  gasperVoterHelper.SetPeersDownloadSpeeds (peersDownloadSpeeds[miner]);
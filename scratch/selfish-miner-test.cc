@@ -62,6 +62,7 @@ main (int argc, char *argv[])
   double bandwidth = 8;
   double latency = 40;
   bool test = false;
+  bool jsonCodec = false;
   
   
   double minersHash[] = {0.185, 0.159, 0.133, 0.066, 0.054,
@@ -136,7 +137,11 @@ main (int argc, char *argv[])
   cmd.AddValue ("relayNetwork", "Change the miners block broadcast type to RELAY_NETWORK", relayNetwork);
   cmd.AddValue ("unsolicitedRelayNetwork", "Change the miners block broadcast type to UNSOLICITED_RELAY_NETWORK", unsolicitedRelayNetwork);
   
+  cmd.AddValue ("jsonCodec", "Send the messages as json instead of the compact binary encoding (debugging)", jsonCodec);
   cmd.Parse(argc, argv);
+
+  if (jsonCodec)
+    MessageCodec::SetDefaultType (JSON_CODEC);
   
   averageBlockGenIntervalSeconds = averageBlockGenIntervalMinutes * secsPerMin;
   stop = targetNumberOfBlocks * averageBlockGenIntervalMinutes; //seconds
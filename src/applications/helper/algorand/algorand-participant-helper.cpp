@@ -10,6 +10,7 @@
 #include "ns3/algorand-participant.h"
 #include "ns3/log.h"
 #include "ns3/double.h"
+#include "ns3/vrf-key-pool.h"
 #include <algorithm>
 #include "../../libsodium/include/sodium.h"
 
@@ -31,7 +32,8 @@ namespace ns3 {
         std::random_device rd; // obtain a random number from hardware
         m_generator.seed(rd()); // seed the generator
 
-        randombytes_buf(m_genesisVrfSeed, sizeof m_genesisVrfSeed);
+        if (!VrfKeyPool::GetInstance().GetGenesisSeed(m_genesisVrfSeed))
+            randombytes_buf(m_genesisVrfSeed, sizeof m_genesisVrfSeed);
 //        m_genesisVrfSeed = m_generator();
 
         // committee size distribution with μ set to 9 (https://www.youtube.com/watch?v=CFuzi-ZGwDY)
@@ -41,6 +43,9 @@ namespace ns3 {
         // block proposal member distribution (nod based on amount of stake)
         std::uniform_int_distribution<> bpDistribution(0, m_noMiners - 1);
         m_memberDistribution = bpDistribution;
+
+        m_firstCommitteeIteration = 1;
+        m_committeeWindow = 8;
     }
 
     Ptr<Application>
@@ -144,6 +149,11 @@ namespace ns3 {
         m_intervalCV = interval;
     }
 
+    void
+    AlgorandParticipantHelper::SetCommitteeWindow(int window) {
+        m_committeeWindow = std::max(window, 1);
+    }
+
     void
     AlgorandParticipantHelper::SetFactoryAttributes (void)
     {
@@ -155,95 +165,81 @@ namespace ns3 {
     AlgorandParticipantHelper::GetCommitteeSize(int iteration, enum AlgorandPhase algorandPhase) {
         NS_LOG_FUNCTION (this);
 
-        // choose committee by actual phase
-        std::vector<std::vector<int>> *phaseCommittee;
-        if(algorandPhase == BLOCK_PROPOSAL_PHASE)
-            phaseCommittee = &m_committeeBP;
-        else if(algorandPhase == SOFT_VOTE_PHASE)
-            phaseCommittee = &m_committeeSV;
-        else if(algorandPhase == CERTIFY_VOTE_PHASE)
-            phaseCommittee = &m_committeeCV;
-        else
+        const IterationCommittees *committees = FindCommittees(iteration);
+        if(committees == nullptr)
             return 0;
-
-
-        if(phaseCommittee->size() < iteration)
-            return 0;
-        return phaseCommittee->at(iteration - 1).size();
+        return committees->sizes[algorandPhase];
     }
 
 
     bool AlgorandParticipantHelper::IsChosenByVRF(int iteration, int participantId, enum AlgorandPhase algorandPhase) {
         NS_LOG_FUNCTION (this);
 
-        // choose committee by actual phase
-        std::vector<std::vector<int>> *phaseCommittee;
-        if(algorandPhase == BLOCK_PROPOSAL_PHASE)
-            phaseCommittee = &m_committeeBP;
-        else if(algorandPhase == SOFT_VOTE_PHASE)
-            phaseCommittee = &m_committeeSV;
-        else if(algorandPhase == CERTIFY_VOTE_PHASE)
-            phaseCommittee = &m_committeeCV;
-        else
+        if(participantId < 0 || participantId >= m_noMiners)
             return false;
 
         // check if VRF has chosen members for this iteration and if no do so
-        if(phaseCommittee->size() < iteration)
-            CreateCommittee(iteration, algorandPhase);
+        CreateCommittees(iteration);
 
-        // check if participant is member of committee
-        std::vector<int> committee = phaseCommittee->at(iteration-1);
-        for(auto i = committee.begin(); i != committee.end(); i++){
-            if(*i == participantId)
-                return true;
+        const IterationCommittees *committees = FindCommittees(iteration);
+        if(committees == nullptr) {
+            NS_LOG_INFO("Committee num. " << iteration << " was already retired");
+            return false;
         }
 
-        return false;
+        // check if participant is member of committee
+        return committees->members[algorandPhase][participantId];
+    }
+
+    const AlgorandParticipantHelper::IterationCommittees*
+    AlgorandParticipantHelper::FindCommittees(int iteration) const {
+        int index = iteration - m_firstCommitteeIteration;
+        if(index < 0 || index >= (int) m_committees.size())
+            return nullptr;
+        return &m_committees.at(index);
     }
 
-    void AlgorandParticipantHelper::CreateCommittee(int iteration, enum AlgorandPhase algorandPhase) {
+    void AlgorandParticipantHelper::CreateCommittees(int iteration) {
         NS_LOG_FUNCTION (this);
-        int committeeSize;
-
-        // choose committee by actual phase
-        std::vector<std::vector<int>> *phaseCommittee;
-        if(algorandPhase == BLOCK_PROPOSAL_PHASE)
-            phaseCommittee = &m_committeeBP;
-        else if(algorandPhase == SOFT_VOTE_PHASE)
-            phaseCommittee = &m_committeeSV;
-        else if(algorandPhase == CERTIFY_VOTE_PHASE)
-            phaseCommittee = &m_committeeCV;
-        else
-            return;
-
-        // resize committee vector
-        int actSize = phaseCommittee->size();
-        phaseCommittee->resize(iteration);
-
-        // create committees for missing iterations
-        for(int i = actSize; i<iteration; i++){
-            // get random size of committee
-            committeeSize = m_committeeSizeDistribution(m_generator);
-            // for creating quorum we need at least 3 members
-            if(committeeSize < 3 || committeeSize > m_noMiners)
-                committeeSize = m_noMiners;
-
-            NS_LOG_INFO("Committee size: " << committeeSize);
-
-            for(int m=0; m<committeeSize; ){
-                int memberId = m_memberDistribution(m_generator);// get random between 0 and participants-1
-
-                // check if member is not already in committee
-                if(std::find(phaseCommittee->at(i).begin(),
-                             phaseCommittee->at(i).end(),
-                             memberId) == phaseCommittee->at(i).end()){
-
-                    // insert new member id to vector
-                    phaseCommittee->at(i).push_back(memberId);
-                    NS_LOG_INFO("Committee num. " << (i+1) << "; inserting value: " << memberId);
-                    m++;
+        int lastIteration = m_firstCommitteeIteration + m_committees.size() - 1;
+
+        // create committees of all phases for missing iterations
+        for(int i = lastIteration + 1; i <= iteration; i++){
+            IterationCommittees committees;
+
+            for(int phase = BLOCK_PROPOSAL_PHASE; phase <= CERTIFY_VOTE_PHASE; phase++){
+                // get random size of committee
+                int committeeSize = m_committeeSizeDistribution(m_generator);
+                // for creating quorum we need at least 3 members
+                if(committeeSize < 3 || committeeSize > m_noMiners)
+                    committeeSize = m_noMiners;
+
+                NS_LOG_INFO("Committee size: " << committeeSize);
+
+                // the committee of all participants does not need the random members
+                bool allMembers = committeeSize == m_noMiners;
+                committees.members[phase].assign(m_noMiners, allMembers);
+                committees.sizes[phase] = committeeSize;
+
+                for(int m = allMembers ? committeeSize : 0; m<committeeSize; ){
+                    int memberId = m_memberDistribution(m_generator);// get random between 0 and participants-1
+
+                    // check if member is not already in committee
+                    if(!committees.members[phase][memberId]){
+                        committees.members[phase][memberId] = true;
+                        NS_LOG_INFO("Committee num. " << i << "; inserting value: " << memberId);
+                        m++;
+                    }
                 }
             }
+
+            m_committees.push_back(std::move(committees));
+
+            // retire the committees which left the window
+            while((int) m_committees.size() > m_committeeWindow){
+                m_committees.pop_front();
+                m_firstCommitteeIteration++;
+            }
         }
     }
 
@@ -9,6 +9,7 @@
 #define SIMPOS_ALGORAND_PARTICIPANT_HELPER_H
 
 #include "ns3/bitcoin-node-helper.h"
+#include <deque>
 #include <vector>
 #include <random>
 
@@ -53,6 +54,12 @@ class AlgorandParticipantHelper : public BitcoinNodeHelper {
     void SetIntervalSV (double interval);
     void SetIntervalCV (double interval);
 
+    /**
+     * sets the number of the last iterations which committees are kept, older committees are retired
+     * @param window number of the kept iterations
+     */
+    void SetCommitteeWindow (int window);
+
     /**
      * Pseudo VRF function for validation if participant is allowed for block proposal or soft vote in certain Algorand iteration phase
      * @param iteration iteration number
@@ -65,7 +72,7 @@ class AlgorandParticipantHelper : public BitcoinNodeHelper {
      * returns committee size in the iteration of algorand phase
      * @param iteration iteration number
      * @param algorandPhase phase of Algorand process (blockProposal, soft vote, certify vote)
-     * @return size of algorand phase committee size
+     * @return size of algorand phase committee size, 0 if the committee was not created yet or was already retired
      */
     int GetCommitteeSize(int iteration, enum AlgorandPhase algorandPhase);
 
@@ -84,7 +91,28 @@ protected:
      */
     void SetFactoryAttributes (void);
 
-    void CreateCommittee(int iteration, enum AlgorandPhase algorandPhase);
+    /**
+     * Members of the committees of all Algorand phases in one iteration
+     */
+    struct IterationCommittees
+    {
+        std::vector<bool> members[3];       // dense bitset of the members by participant id, indexed by the Algorand phase
+        int sizes[3];                       // number of the members of each phase committee
+    };
+
+    /**
+     * creates the committees of all phases for the missing iterations up to the iteration at once,
+     * the committees out of the window are retired
+     * @param iteration iteration number
+     */
+    void CreateCommittees(int iteration);
+
+    /**
+     * finds the committees of the iteration
+     * @param iteration iteration number
+     * @return committees of the iteration, nullptr if they were not created yet or were already retired
+     */
+    const IterationCommittees* FindCommittees(int iteration) const;
 
     enum MinerType              m_minerType;
     enum BlockBroadcastType     m_blockBroadcastType;
@@ -104,9 +132,9 @@ protected:
     std::mt19937 m_generator;
     std::poisson_distribution<int> m_committeeSizeDistribution;
     std::uniform_int_distribution<int> m_memberDistribution;
-    std::vector<std::vector<int>> m_committeeBP;
-    std::vector<std::vector<int>> m_committeeSV;
-    std::vector<std::vector<int>> m_committeeCV;
+    std::deque<IterationCommittees> m_committees;   // committees of the last iterations, the newest at the back
+    int m_firstCommitteeIteration;                  // iteration of the oldest kept committees
+    int m_committeeWindow;                          // number of the kept iterations
 };
 
 }// Namespace ns3
@@ -10,6 +10,7 @@
 #include "ns3/gasper-participant.h"
 #include "ns3/log.h"
 #include "ns3/double.h"
+#include "ns3/vrf-key-pool.h"
 #include <algorithm>
 #include "../../libsodium/include/sodium.h"
 
@@ -31,7 +32,8 @@ namespace ns3 {
         std::random_device rd; // obtain a random number from hardware
         m_generator.seed(rd()); // seed the generator
 
-        randombytes_buf(m_genesisVrfSeed, sizeof m_genesisVrfSeed);
+        if (!VrfKeyPool::GetInstance().GetGenesisSeed(m_genesisVrfSeed))
+            randombytes_buf(m_genesisVrfSeed, sizeof m_genesisVrfSeed);
     }
 
     Ptr<Application>
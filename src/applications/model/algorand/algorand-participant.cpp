@@ -13,6 +13,11 @@
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
 #include "ns3/simulator.h"
+#include "ns3/vrf-verify-cache.h"
+#include "ns3/vrf-backend.h"
+#include "ns3/batch-vrf-prover.h"
+#include "ns3/vrf-key-pool.h"
+#include "ns3/stake-sortition.h"
 #include <algorithm>
 #include <utility>
 #include "../../libsodium/include/sodium.h"
@@ -82,6 +87,21 @@ AlgorandParticipant::GetTypeId(void) {
                            DoubleValue (0.3),
                            MakeDoubleAccessor (&AlgorandParticipant::m_attackPower),
                            MakeDoubleChecker<double> ())
+            .AddAttribute ("TotalCommitteeStake",
+                           "Expected stake of the vote committee, the phase ends as soon as its quorum is reached (0 waits for the interval)",
+                           UintegerValue (0),
+                           MakeUintegerAccessor (&AlgorandParticipant::m_totalCommitteeStake),
+                           MakeUintegerChecker<uint32_t> ())
+            .AddAttribute ("SortitionCommitteeSize",
+                           "Expected weight of the vote committee selected by the stake weighted sortition (0 for the VRF threshold)",
+                           UintegerValue (0),
+                           MakeUintegerAccessor (&AlgorandParticipant::m_sortitionCommitteeSize),
+                           MakeUintegerChecker<uint32_t> ())
+            .AddAttribute ("SortitionTotalStake",
+                           "Total stake of all participants for the stake weighted sortition",
+                           UintegerValue (0),
+                           MakeUintegerAccessor (&AlgorandParticipant::m_sortitionTotalStake),
+                           MakeUintegerChecker<uint64_t> ())
                            ;
     return tid;
 }
@@ -97,7 +117,8 @@ AlgorandParticipant::AlgorandParticipant() : AlgorandNode(),
     memset(m_pk, 0, sizeof m_pk);
     memset(m_vrfProof, 0, sizeof m_vrfProof);
     memset(m_vrfOut, 0, sizeof m_vrfOut);
-    crypto_vrf_keypair(m_pk, m_sk);
+    if (!VrfKeyPool::GetInstance().IsEnabled())
+        VrfBackend::Keypair(m_pk, m_sk);
 
     if (m_fixedBlockSize > 0)
         m_nextBlockSize = m_fixedBlockSize;
@@ -106,6 +127,9 @@ AlgorandParticipant::AlgorandParticipant() : AlgorandNode(),
 
     m_chosenToSVCommitteeTimes = 0;
     m_averageStakeSize = 0;
+    m_sortitionCommitteeSize = 0;
+    m_sortitionTotalStake = 0;
+    m_sortition = nullptr;
 
     if (m_fixedStakeSize > 0)
         m_nextStakeSize = m_fixedStakeSize;
@@ -117,6 +141,11 @@ AlgorandParticipant::AlgorandParticipant() : AlgorandNode(),
     m_iterationBP = 0;
     m_iterationSV = 0;
     m_iterationCV = 0;
+
+    m_totalCommitteeStake = 0;
+    m_roundStart = 0;
+    m_averageRoundTime = 0;
+    m_earlyQuorums = 0;
 }
 
 AlgorandParticipant::~AlgorandParticipant(void) {
@@ -161,6 +190,13 @@ void AlgorandParticipant::StartApplication() {
 
     AlgorandNode::StartApplication ();
 
+    // participant i takes the key i of the pool, the node id is not known in the constructor
+    if (VrfKeyPool::GetInstance().IsEnabled())
+        VrfKeyPool::GetInstance().GetKeypair(GetNode()->GetId(), m_pk, m_sk);
+
+    if (m_sortitionCommitteeSize > 0)
+        m_sortition = StakeSortition::Get(m_sortitionCommitteeSize, m_sortitionTotalStake);
+
     if(m_isFailed){
         return;
     }
@@ -216,6 +252,7 @@ void AlgorandParticipant::StartApplication() {
 
     // scheduling algorand events
     m_nextBlockProposalEvent = Simulator::Schedule (Seconds(m_intervalCV), &AlgorandParticipant::BlockProposalPhase, this);
+    BatchVrfProver::GetInstance().Expect(Simulator::Now() + Seconds(m_intervalCV), m_sk);
     NS_LOG_INFO("Node " << GetNode()->GetId() << ": scheduled block proposal");
 }
 
@@ -246,7 +283,7 @@ void AlgorandParticipant::GenNextStakeSize(AlgorandPhase phase) {
     && m_chosenToSVCommitteeTimes != 0
     && m_attackPower != 0.0){
         int lastStake = m_mySoftVoteStakes.at(m_mySoftVoteStakes.size()-1);
-        int lastTotal = m_softVotes.at(m_softVotes.size() -1);
+        int lastTotal = m_softVoteTallies.at(m_softVoteTallies.size() -1).GetTotalStake();
 
         if(lastStake == lastTotal)
             m_nextStakeSize = lastStake;
@@ -260,6 +297,17 @@ void AlgorandParticipant::GenNextStakeSize(AlgorandPhase phase) {
 
 }
 
+bool AlgorandParticipant::IsVoteChosen(const unsigned char *vrfOut, const unsigned char *threshold, rapidjson::Document *message) {
+    if (!m_sortition)
+        return memcmp(vrfOut, threshold, 64) <= 0;
+
+    // the weight of the vote has to match the sub-users selected from the stake of the voter
+    if (!message->HasMember("balance"))
+        return false;
+    uint32_t votes = (*message)["algoAmount"].GetUint();
+    return votes > 0 && m_sortition->Select(vrfOut, (*message)["balance"].GetUint()) == votes;
+}
+
 void AlgorandParticipant::StopApplication() {
     NS_LOG_FUNCTION(this);
     AlgorandNode::StopApplication ();
@@ -289,6 +337,13 @@ void AlgorandParticipant::StopApplication() {
         std::cout << "avg CV committee size = " << m_nodeStats->meanCVCommitteeSize << std::endl;
         std::cout << "chosen to SV committee (times) = " << m_chosenToSVCommitteeTimes << std::endl;
         std::cout << "avg SV stake size = " << m_averageStakeSize << std::endl;
+        std::cout << "avg round time = " << m_averageRoundTime << std::endl;
+        std::cout << "early quorums = " << m_earlyQuorums << std::endl;
+        std::cout << "duplicate BP/SV/CV messages = " << m_seenMessages.GetDuplicateRate(BLOCK_PROPOSAL)
+                  << " / " << m_seenMessages.GetDuplicateRate(SOFT_VOTE)
+                  << " / " << m_seenMessages.GetDuplicateRate(CERTIFY_VOTE) << std::endl;
+        std::cout << "VRF verify cache hits/misses (process) = " << VrfVerifyCache::GetInstance().GetNoHits()
+                  << " / " << VrfVerifyCache::GetInstance().GetNoMisses() << std::endl;
         std::cout << "failed = " << (m_isFailed ? "true" : "false") << std::endl;
         if(m_isAttacker) {
             std::cout << "attacker = " << (m_isAttacker ? "true" : "false") << std::endl;
@@ -316,13 +371,13 @@ int AlgorandParticipant::GetAvgCommitteeSize(AlgorandPhase phase) {
             count++;
         }
     }else if(phase == SOFT_VOTE_PHASE){
-        for(auto votes: m_softVoters){
-            total += votes;
+        for(auto &tally: m_softVoteTallies){
+            total += tally.GetNoVoters();
             count++;
         }
     }else if(phase == CERTIFY_VOTE_PHASE){
-        for(auto votes: m_certifyVoters){
-            total += votes;
+        for(auto &tally: m_certifyVoteTallies){
+            total += tally.GetNoVoters();
             count++;
         }
     }else{
@@ -419,11 +474,8 @@ void AlgorandParticipant::AdvertiseVoteOrProposal(enum Messages messageType, rap
     int count = 0;
     double sendTime;
 
-    // create json string buffer
-    rapidjson::StringBuffer jsonBuffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-    d.Accept(writer);
-    std::string msg = jsonBuffer.GetString();
+    // encode the message only once, all peers share the same frame
+    Ptr<Packet> frame = CreateSharedFrame(messageType, d);
 
     // sending to each peer in node list
     for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
@@ -453,20 +505,12 @@ void AlgorandParticipant::AdvertiseVoteOrProposal(enum Messages messageType, rap
         }
 
         count++;
-        Simulator::Schedule (Seconds(sendTime), &AlgorandParticipant::SendMessage, this, NO_MESSAGE, messageType, msg, m_peersSockets[*i]);
+        Simulator::Schedule (Seconds(GetCpuDelay() + sendTime), &AlgorandParticipant::SendSharedFrame, this, messageType, frame, m_peersSockets[*i]);
     }
 
     NS_LOG_INFO(GetNode()->GetId() << " - advertised vote or proposal to " << count << " nodes.");
 }
 
-void
-AlgorandParticipant::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, std::string d, Ptr<Socket> outgoingSocket){
-    rapidjson::Document msg;
-    msg.Parse(d.c_str());
-
-    BitcoinNode::SendMessage(receivedMessage, responseMessage, msg, outgoingSocket, "^#EOM#^");
-    NS_LOG_INFO(GetNode()->GetId() << " - Message sent, respMsg: " << getMessageName(responseMessage));
-}
 
 bool
 AlgorandParticipant::SaveBlockToVector(std::vector<std::vector<Block>> *blockVector, int iteration, Block block) {
@@ -485,58 +529,13 @@ AlgorandParticipant::SaveBlockToVector(std::vector<std::vector<Block>> *blockVec
     return true;
 }
 
-bool
-AlgorandParticipant::SaveBlockToVector(std::vector<std::vector<Block*>> *blockVector, int iteration, Block *block) {
-    NS_LOG_FUNCTION (this);
-    // check if our vector have place for blocks in received iteration
-    if(blockVector->size() < iteration)
-        blockVector->resize(iteration);
-
-    // Checking already saved block
-    for(auto b: blockVector->at(iteration - 1))
-        if((*block) == (*b) && block->GetBlockProposalIteration() == b->GetBlockProposalIteration())
-            return false;
-
-    // Inserting block to vector
-    blockVector->at(iteration - 1).push_back(block);
-    return true;
-}
-
-int
-AlgorandParticipant::SaveBlockToVector(std::vector<std::vector<std::pair<Block*, int>>> *blockVector, int iteration, Block *block, int algoAmount) {
-    NS_LOG_FUNCTION (this);
-    // check if our vector have place for blocks in received iteration
-    if(blockVector->size() < iteration)
-        blockVector->resize(iteration);
-
-    // Checking already saved block
-    bool found = false;
-    std::vector<std::pair<Block*, int>>::iterator m;
-
-
-    for (m = blockVector->at(iteration - 1).begin(); m != blockVector->at(iteration - 1).end(); m++)
-    {
-        // if block already in vector of votes, than increase number of votes by one
-        if ((*block) == (*(m->first))) {
-            m->second = m->second + algoAmount;
-            NS_LOG_INFO(GetNode()->GetId() << " - SBV, s: "  << blockVector->at(iteration - 1).size() << ", i: "  << iteration << ", stake: " << algoAmount << ", total for the block: " << m->second);
-            return m->second;
-        }
-    }
-
-    // Inserting block to vector because it was not found in vector
-    blockVector->at(iteration - 1).push_back(std::make_pair(block, algoAmount));
-    NS_LOG_INFO(GetNode()->GetId() << " - SBV, s: "  << blockVector->at(iteration - 1).size() << ", i: "  << iteration << ", stake: " << algoAmount << ", total for the block: " << algoAmount);
-    return algoAmount;   // count of total votes is algoAmount for newly inserted vote
-}
-
 Block*
-AlgorandParticipant::FindBlockInVector(std::vector<std::vector<Block>> *blockVector, int iteration, std::string blockHash) {
+AlgorandParticipant::FindBlockInVector(std::vector<std::vector<Block>> *blockVector, int iteration, const BlockKey &blockKey) {
     if(blockVector->size() < iteration)
         return nullptr;
 
     for(auto i = blockVector->at(iteration - 1).begin(); i != blockVector->at(iteration - 1).end(); i++){
-        if(i->GetBlockHash() == blockHash)
+        if(i->GetBlockKey() == blockKey)
             return &(*i);
     }
 
@@ -558,49 +557,86 @@ AlgorandParticipant::IncreaseCntOfReceivedVotes(std::vector <int> *counterVector
     return counterVector->at(iteration-1);
 }
 
+AlgorandVoteTally&
+AlgorandParticipant::GetVoteTally(AlgorandPhase phase, int iteration) {
+    std::vector<AlgorandVoteTally> *tallies = (phase == SOFT_VOTE_PHASE) ? &m_softVoteTallies : &m_certifyVoteTallies;
+
+    // check if our vector have place for votes in received iteration
+    if((int) tallies->size() < iteration)
+        tallies->resize(iteration);
+
+    return tallies->at(iteration - 1);
+}
+
 Block*
 AlgorandParticipant::GetConfirmedBlock(AlgorandPhase phase, int iteration) {
-    std::vector<std::pair<Block*, int>> *preTally;
-    std::vector<int> *voters;
-    int totalVotes = 0;
+    std::vector<AlgorandVoteTally> *tallies;
 
     if(iteration == 0)
         return nullptr;
 
-    if(phase == SOFT_VOTE_PHASE){
-        if(m_receivedSoftVotePreTally.size() < iteration || m_softVoters.size() < iteration)
-            return nullptr;
-        preTally = &(m_receivedSoftVotePreTally.at(iteration-1));
-        voters = &m_softVoters;
-        totalVotes = m_softVotes.at(iteration-1);
-    }else if(phase == CERTIFY_VOTE_PHASE){
-        if(m_receivedCertifyVotePreTally.size() < iteration || m_certifyVoters.size() < iteration)
-            return nullptr;
-        preTally = &(m_receivedCertifyVotePreTally.at(iteration-1));
-        voters = &m_certifyVoters;
-        totalVotes = m_certifyVotes.at(iteration-1);
-    }else{
+    if(phase == SOFT_VOTE_PHASE)
+        tallies = &m_softVoteTallies;
+    else if(phase == CERTIFY_VOTE_PHASE)
+        tallies = &m_certifyVoteTallies;
+    else
+        return nullptr;
+
+    if((int) tallies->size() < iteration)
         return nullptr;
-    }
 
     // we need at least 3 voters for reaching quorum
-    if(voters->size() < iteration || voters->at(iteration-1) < 3)
+    const AlgorandVoteTally &tally = tallies->at(iteration - 1);
+    const BlockKey *blockKey = tally.GetQuorumBlock(3);
+    if(blockKey == nullptr)
         return nullptr;
 
-    // searching for block which reached quorum
-    std::vector<std::pair<Block*, int>>::iterator m;
-    for(m = preTally->begin(); m != preTally->end(); m++){
-        // try to check if has been reached quorum
-        if (m->second > (2 * (totalVotes / 3))) {
-            // if so, save to tally
-            NS_LOG_INFO(GetNode()->GetId() << " - Quorum " << phase << " in iteration " << iteration << " reached, tv: " << m->second
-                << ", totalStakes: " << totalVotes << ", committeeSize: " << voters->at(iteration-1)
-                <<", minimum for quorum: " << ((2 * (totalVotes / 3))+1) );
-            NS_LOG_INFO (GetNode()->GetId() << " - Quorum " << phase << " in iteration " << iteration << " reached for: " << (*(m->first)));
-            return (m->first);
-        }
+    // voted blocks are proposals of the same iteration
+    Block *block = FindBlockInVector(&m_receivedBlockProposals, iteration, *blockKey);
+    if(block == nullptr)
+        return nullptr;
+
+    NS_LOG_INFO(GetNode()->GetId() << " - Quorum " << phase << " in iteration " << iteration << " reached, tv: " << tally.GetBlockStake(*blockKey)
+        << ", totalStakes: " << tally.GetTotalStake() << ", committeeSize: " << tally.GetNoVoters()
+        <<", minimum for quorum: " << ((2 * (tally.GetTotalStake() / 3))+1) );
+    NS_LOG_INFO (GetNode()->GetId() << " - Quorum " << phase << " in iteration " << iteration << " reached for: " << (*block));
+    return block;
+}
+
+void
+AlgorandParticipant::CheckEarlyQuorum(AlgorandPhase phase, int iteration) {
+    if(m_totalCommitteeStake == 0 || iteration == 0)
+        return;
+
+    if(phase == SOFT_VOTE_PHASE) {
+        // soft vote phase of the iteration is running and certify vote phase is still waiting for the interval
+        if(iteration != m_iterationSV || m_iterationCV >= m_iterationSV
+           || !Simulator::GetDelayLeft(m_nextCertificationEvent).IsStrictlyPositive())
+            return;
+
+        if(GetVoteTally(SOFT_VOTE_PHASE, iteration).GetQuorumBlock(3, m_totalCommitteeStake) == nullptr)
+            return;
+
+        NS_LOG_INFO(GetNode()->GetId() << " - Early quorum SV in iteration " << iteration);
+        Simulator::Cancel(m_nextCertificationEvent);
+        m_nextCertificationEvent = Simulator::ScheduleNow (&AlgorandParticipant::CertifyVotePhase, this);
+    } else if(phase == CERTIFY_VOTE_PHASE) {
+        // certify vote phase of the iteration is running and block proposal phase is still waiting for the interval
+        if(iteration != m_iterationCV || m_iterationBP != m_iterationCV
+           || !Simulator::GetDelayLeft(m_nextBlockProposalEvent).IsStrictlyPositive())
+            return;
+
+        if(GetVoteTally(CERTIFY_VOTE_PHASE, iteration).GetQuorumBlock(3, m_totalCommitteeStake) == nullptr)
+            return;
+
+        NS_LOG_INFO(GetNode()->GetId() << " - Early quorum CV in iteration " << iteration);
+        Simulator::Cancel(m_nextBlockProposalEvent);
+        m_nextBlockProposalEvent = Simulator::ScheduleNow (&AlgorandParticipant::BlockProposalPhase, this);
+    } else {
+        return;
     }
-    return nullptr;
+
+    m_earlyQuorums++;
 }
 
 void
@@ -640,12 +676,21 @@ void AlgorandParticipant::BlockProposalPhase() {
     }
 
     // ------ start real block proposal ------
+    double now = Simulator::Now().GetSeconds();
+    if(m_iterationBP != 0)
+        m_averageRoundTime = (m_iterationBP - 1) / static_cast<double>(m_iterationBP) * m_averageRoundTime
+                             + (now - m_roundStart) / m_iterationBP;
+    m_roundStart = now;
+
     m_iterationBP++;    // increase number of block proposal iterations
     InformAboutState(m_iterationBP);  // print state to stderr
     int participantId = GetNode()->GetId();
 
-    crypto_vrf_prove(m_vrfProof, m_sk, (const unsigned char*) m_actualVrfSeed, sizeof m_actualVrfSeed);
-    crypto_vrf_proof_to_hash(m_vrfOut, m_vrfProof);
+    // the committee membership (threshold or sortition) may only be decided by the output of a valid proof
+    if(BatchVrfProver::GetInstance().Prove(m_vrfProof, m_sk, (const unsigned char*) m_actualVrfSeed, sizeof m_actualVrfSeed) != 0
+       || VrfBackend::ProofToHash(m_vrfOut, m_vrfProof) != 0)
+        NS_FATAL_ERROR(GetNode()->GetId() << " - Cannot compute the VRF proof of the participant");
+    ChargeCpuTime(VrfBackend::GetProveDelay());
 
     // print generated VRF output
 //    for(int i=0; i<(sizeof m_vrfOut); ++i)
@@ -670,7 +715,11 @@ void AlgorandParticipant::BlockProposalPhase() {
                         currentTime, currentTime, Ipv4Address("127.0.0.1"));
         newBlock.SetBlockProposalIteration(m_iterationBP);
 //        newBlock.SetVrfSeed(GenerateVrfSeed());
-        randombytes_buf(m_nextVrfSeed, sizeof m_nextVrfSeed);
+        // with the key pool the seed is the hash of the leader's VRF output, so the runs are reproducible
+        if (VrfKeyPool::GetInstance().IsEnabled())
+            crypto_generichash(m_nextVrfSeed, sizeof m_nextVrfSeed, m_vrfOut, sizeof m_vrfOut, NULL, 0);
+        else
+            randombytes_buf(m_nextVrfSeed, sizeof m_nextVrfSeed);
         newBlock.SetVrfSeed(m_nextVrfSeed);
         newBlock.SetParticipantPublicKey(m_pk);
         newBlock.SetVrfOutput(m_vrfOut);
@@ -689,6 +738,7 @@ void AlgorandParticipant::BlockProposalPhase() {
         AdvertiseVoteOrProposal(BLOCK_PROPOSAL, document);
         // inserting to block proposals vector -> in case that we will get this block again we do not advertise it again
         SaveBlockToVector(&m_receivedBlockProposals, m_iterationBP, newBlock);
+        m_seenMessages.Insert(BLOCK_PROPOSAL, participantId, m_iterationBP);
         NS_LOG_INFO (GetNode()->GetId() << " - Advertised block proposal:  " << newBlock);
     }
 
@@ -701,6 +751,12 @@ void AlgorandParticipant::ProcessReceivedProposedBlock(rapidjson::Document *mess
 
     // Converting from rapidjson document message to block object
 
+    // already accepted proposals are dropped before parsing and VRF verification
+    if(m_seenMessages.IsDuplicate(BLOCK_PROPOSAL, (*message)["minerId"].GetInt(), (*message)["blockProposalIteration"].GetInt())) {
+        m_nodeStats->blockReceivedBytes += (*message)["size"].GetInt();
+        return;
+    }
+
     // FIXED - Upper line is commented for correct checking of same blocks
     // (A->B, B->C, C->B => B receives the block from A and B, so block would not be compared as equal even when they are the same block created by A)
     Block proposedBlock = Block::FromJSON(message, InetSocketAddress::ConvertFrom(receivedFrom).GetIpv4 ());
@@ -726,7 +782,15 @@ void AlgorandParticipant::ProcessReceivedProposedBlock(rapidjson::Document *mess
     memcpy(actualVrfSeed, (*message)["currentSeed"].GetString(), sizeof actualVrfSeed);
 
     // generate vfrOut for proof and check if it is same as VRF output inside of the received block
-    crypto_vrf_verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    int vrfRc = VrfVerifyCache::GetInstance().Verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    ChargeCpuTime(VrfBackend::GetVerifyDelay());
+
+    if(vrfRc != 0) {
+        NS_LOG_INFO(
+                GetNode()->GetId() << " - INVALID Block proposal - participantId: " << participantId << " block iterationBP: " << blockIteration
+                                                           << "Reason: invalid VRF proof");
+        return;
+    }
 
     int chosenBP = memcmp(vrfOut, m_vrfThresholdBP, sizeof vrfOut);
     bool chosen = (chosenBP <= 0) ? true : false;
@@ -748,6 +812,7 @@ void AlgorandParticipant::ProcessReceivedProposedBlock(rapidjson::Document *mess
 
     // Inserting received block proposal into vector
     bool inserted = SaveBlockToVector(&m_receivedBlockProposals, blockIteration, proposedBlock);
+    m_seenMessages.Insert(BLOCK_PROPOSAL, participantId, blockIteration);
 
     // sending only if this is new proposal
     if(inserted){
@@ -771,9 +836,15 @@ AlgorandParticipant::SoftVotePhase() {
     int stake = 0;
 //    bool chosen = m_helper->IsChosenByVRF(m_iterationSV, participantId, SOFT_VOTE_PHASE);
 
-    int chosenSV = memcmp(m_vrfOut, m_vrfThresholdSV, sizeof m_vrfOut);
-    NS_LOG_INFO ( participantId << " - Chosen SV ("<<m_iterationSV<<"): " << chosenSV << " r: " << ((chosenSV <= 0) ? "Chosen" : "Not chosen"));
-    bool chosen = (chosenSV <= 0) ? true : false;
+    // with the sortition the stake is drawn first, the VRF output selects the votes of its sub-users
+    int votes = 0;
+    if (m_sortition) {
+        GenNextStakeSize(SOFT_VOTE_PHASE);
+        votes = m_sortition->Select(m_vrfOut, m_nextStakeSize);
+    } else if (memcmp(m_vrfOut, m_vrfThresholdSV, sizeof m_vrfOut) <= 0)
+        votes = 1;
+    NS_LOG_INFO ( participantId << " - Chosen SV ("<<m_iterationSV<<"): " << votes << " r: " << ((votes > 0) ? "Chosen" : "Not chosen"));
+    bool chosen = votes > 0;
     // check output of VRF and if chosen then vote for lowest VRF proposal
     if (chosen
         && m_receivedBlockProposals.size() >= m_iterationSV
@@ -790,8 +861,11 @@ AlgorandParticipant::SoftVotePhase() {
         }
 
         if(lowestProposal) {
-            // generate next stake size
-            GenNextStakeSize(SOFT_VOTE_PHASE);
+            if(!m_sortition) {
+                // generate next stake size, the whole stake is the weight of the vote
+                GenNextStakeSize(SOFT_VOTE_PHASE);
+                votes = m_nextStakeSize;
+            }
 
             // Extract values from block to rapidjson document vote and broadcast the vote
             rapidjson::Document document;
@@ -808,9 +882,13 @@ AlgorandParticipant::SoftVotePhase() {
             document.AddMember("blockIteration", value, document.GetAllocator());
             value = participantId;
             document.AddMember("voterId", value, document.GetAllocator());
-            NS_LOG_INFO(GetNode()->GetId() << " - sendAlgo: " << m_nextStakeSize);
-            value = m_nextStakeSize;
+            NS_LOG_INFO(GetNode()->GetId() << " - sendAlgo: " << votes);
+            value = votes;
             document.AddMember("algoAmount", value, document.GetAllocator());
+            if(m_sortition) {
+                value = m_nextStakeSize;
+                document.AddMember("balance", value, document.GetAllocator());
+            }
 
             value.SetString((const char *) m_vrfProof, 80, document.GetAllocator());
             document.AddMember("vrfProof", value, document.GetAllocator());
@@ -821,21 +899,18 @@ AlgorandParticipant::SoftVotePhase() {
 
             AdvertiseVoteOrProposal(SOFT_VOTE, document);
             NS_LOG_INFO(GetNode()->GetId() << " - Advertised soft vote("<<m_iterationSV<<"): " << (*lowestProposal));
-            SaveBlockToVector(&m_receivedSoftVotes, participantId + 1, lowestProposal);
 
-            // save also to pretally
-            SaveBlockToVector(&m_receivedSoftVotePreTally, m_iterationSV, lowestProposal, m_nextStakeSize);
-            int tot = IncreaseCntOfReceivedVotes(&m_softVotes, m_iterationSV, m_nextStakeSize);
-            NS_LOG_INFO (GetNode()->GetId() << " - Total Votes SV("<<m_iterationSV<<"): " << tot);
+            // save also to tally
+            AlgorandVoteTally &tally = GetVoteTally(SOFT_VOTE_PHASE, m_iterationSV);
+            tally.AddVote(participantId, lowestProposal->GetBlockKey(), votes);
+            m_seenMessages.Insert(SOFT_VOTE, participantId, m_iterationSV);
+            NS_LOG_INFO (GetNode()->GetId() << " - Total Votes SV("<<m_iterationSV<<"): " << tally.GetTotalStake());
 
-            // increase count of voters in the iterations
-            IncreaseCntOfReceivedVotes(&m_softVoters, m_iterationSV);
-
-            stake = m_nextStakeSize;
+            stake = votes;
             // statistics update
             m_averageStakeSize = m_chosenToSVCommitteeTimes / static_cast<double>(m_chosenToSVCommitteeTimes + 1) *
                                  m_averageStakeSize
-                                 + static_cast<double>(m_nextStakeSize) / (m_chosenToSVCommitteeTimes + 1);
+                                 + static_cast<double>(votes) / (m_chosenToSVCommitteeTimes + 1);
             m_chosenToSVCommitteeTimes++;
         }
     }
@@ -846,6 +921,9 @@ AlgorandParticipant::SoftVotePhase() {
     }
     // Create new certify vote event in m_certifyVoteInterval seconds
     m_nextCertificationEvent = Simulator::Schedule (Seconds(m_intervalSV), &AlgorandParticipant::CertifyVotePhase, this);
+
+    // votes received before the phase may already reach the quorum
+    CheckEarlyQuorum(SOFT_VOTE_PHASE, m_iterationSV);
 }
 
 Block*
@@ -906,14 +984,18 @@ AlgorandParticipant::ProcessReceivedSoftVote(rapidjson::Document *message, ns3::
     NS_LOG_FUNCTION (this);
 
     // Checking valid VRF
-    std::string blockHash = (*message)["blockHash"].GetString();
+    BlockKey blockKey = BlockKey::FromString((*message)["blockHash"].GetString());
     int blockIteration = (*message)["blockIteration"].GetInt();
     int participantId = (*message)["voterId"].GetInt();
 
     // update statistics
     m_nodeStats->voteReceivedBytes += m_fixedVoteSize;
 
-    Block *votedBlock = FindBlockInVector(&m_receivedBlockProposals, blockIteration, blockHash);
+    // already accepted votes are dropped before VRF verification
+    if(m_seenMessages.IsDuplicate(SOFT_VOTE, participantId, blockIteration))
+        return;
+
+    Block *votedBlock = FindBlockInVector(&m_receivedBlockProposals, blockIteration, blockKey);
     if(votedBlock == nullptr) {
         // block proposal was not found
         NS_LOG_INFO (GetNode()->GetId() << " - block proposal was not found");
@@ -933,10 +1015,15 @@ AlgorandParticipant::ProcessReceivedSoftVote(rapidjson::Document *message, ns3::
     memcpy(actualVrfSeed, (*message)["currentSeed"].GetString(), sizeof actualVrfSeed);
 
     // generate vfrOut for proof for proof and check if it is lower than threshold
-    crypto_vrf_verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    int vrfRc = VrfVerifyCache::GetInstance().Verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    ChargeCpuTime(VrfBackend::GetVerifyDelay());
+
+    if(vrfRc != 0){
+        NS_LOG_INFO (GetNode()->GetId() << " - INVALID Soft vote - participantId: " << participantId << ", iterationSV: " << blockIteration << " Reason: invalid VRF proof");
+        return;
+    }
 
-    int chosenSV = memcmp(vrfOut, m_vrfThresholdSV, sizeof vrfOut);
-    bool chosen = (chosenSV <= 0) ? true : false;
+    bool chosen = IsVoteChosen(vrfOut, m_vrfThresholdSV, message);
 
 //    if(!m_helper->IsChosenByVRF(blockIteration, participantId, SOFT_VOTE_PHASE)){
     if(!chosen){
@@ -944,8 +1031,11 @@ AlgorandParticipant::ProcessReceivedSoftVote(rapidjson::Document *message, ns3::
         return;
     }
 
-    // Inserting received block proposal into vector - participantId is indexed from 0 so we increase value to prevent mem errors
-    bool inserted = SaveBlockToVector(&m_receivedSoftVotes, participantId + 1, votedBlock);
+    // Inserting received vote into tally of the iteration, only the first vote of the voter is counted
+    int algoAmount = (int) (*message)["algoAmount"].GetUint();
+    AlgorandVoteTally &tally = GetVoteTally(SOFT_VOTE_PHASE, blockIteration);
+    bool inserted = tally.AddVote(participantId, blockKey, algoAmount);
+    m_seenMessages.Insert(SOFT_VOTE, participantId, blockIteration);
     if(!inserted) {
         NS_LOG_INFO (GetNode()->GetId() << " - Already received Soft vote - participantId: " << participantId << ", iterationSV: " << blockIteration);
         return;     // block soft vote from this voter was already received
@@ -955,16 +1045,9 @@ AlgorandParticipant::ProcessReceivedSoftVote(rapidjson::Document *message, ns3::
     // advertise vote to other next peers
     AdvertiseVoteOrProposal(SOFT_VOTE, *message, &receivedFrom);
 
-    // and save to pre-tally
-    int algoAmount = (int) (*message)["algoAmount"].GetUint();
-    SaveBlockToVector(&m_receivedSoftVotePreTally, blockIteration, votedBlock, algoAmount);
-
-    // count total vote stakes
-    int tot = IncreaseCntOfReceivedVotes(&m_softVotes, blockIteration, algoAmount);
-    NS_LOG_INFO (GetNode()->GetId() << " - Total Votes SV("<<m_iterationSV<<"): " << tot);
+    NS_LOG_INFO (GetNode()->GetId() << " - Total Votes SV("<<blockIteration<<"): " << tally.GetTotalStake());
 
-    // increase count of voters in the iterations
-    IncreaseCntOfReceivedVotes(&m_softVoters, blockIteration);
+    CheckEarlyQuorum(SOFT_VOTE_PHASE, blockIteration);
 }
 
 /** ----------- end of: SOFT VOTE PHASE ----------- */
@@ -977,14 +1060,20 @@ AlgorandParticipant::CertifyVotePhase() {
     int participantId = GetNode()->GetId();
 //    bool chosen = m_helper->IsChosenByVRF(m_iterationCV, participantId, CERTIFY_VOTE_PHASE);
 
-    int chosenCV = memcmp(m_vrfOut, m_vrfThresholdCV, sizeof m_vrfOut);
-    NS_LOG_INFO ( participantId << " - Chosen CV ("<<m_iterationCV<<"): " << chosenCV << " r: " << ((chosenCV <= 0) ? "Chosen" : "Not chosen"));
-    bool chosen = (chosenCV <= 0) ? true : false;
+    // with the sortition the stake is drawn first, the VRF output selects the votes of its sub-users
+    int votes = 0;
+    if (m_sortition) {
+        GenNextStakeSize(CERTIFY_VOTE_PHASE);
+        votes = m_sortition->Select(m_vrfOut, m_nextStakeSize);
+    } else if (memcmp(m_vrfOut, m_vrfThresholdCV, sizeof m_vrfOut) <= 0)
+        votes = 1;
+    NS_LOG_INFO ( participantId << " - Chosen CV ("<<m_iterationCV<<"): " << votes << " r: " << ((votes > 0) ? "Chosen" : "Not chosen"));
+    bool chosen = votes > 0;
 
     // check output of VRF and if chosen then vote for lowest VRF proposal
     if (chosen
-        && m_receivedSoftVotePreTally.size() >= m_iterationCV
-        && m_receivedSoftVotePreTally.at(m_iterationCV - 1).size() != 0)
+        && (int) m_softVoteTallies.size() >= m_iterationCV
+        && m_softVoteTallies.at(m_iterationCV - 1).GetNoVoters() != 0)
     {
         // Get block with most votes
         Block *votedBlock = GetConfirmedBlock(SOFT_VOTE_PHASE, m_iterationCV);
@@ -995,8 +1084,11 @@ AlgorandParticipant::CertifyVotePhase() {
 
         // Check Block Validity
         if(votedBlock && IsVotedBlockValid(votedBlock)){
-            // generate next stake size
-            GenNextStakeSize(CERTIFY_VOTE_PHASE);
+            if(!m_sortition) {
+                // generate next stake size, the whole stake is the weight of the vote
+                GenNextStakeSize(CERTIFY_VOTE_PHASE);
+                votes = m_nextStakeSize;
+            }
 
             // Convert valid block to rapidjson document and broadcast the block
             rapidjson::Document document;
@@ -1013,8 +1105,12 @@ AlgorandParticipant::CertifyVotePhase() {
             document.AddMember("blockIteration", value, document.GetAllocator());
             value = participantId;
             document.AddMember("voterId", value, document.GetAllocator());
-            value = m_nextStakeSize;
+            value = votes;
             document.AddMember("algoAmount", value, document.GetAllocator());
+            if(m_sortition) {
+                value = m_nextStakeSize;
+                document.AddMember("balance", value, document.GetAllocator());
+            }
 
             value.SetString((const char*) m_vrfProof, 80, document.GetAllocator());
             document.AddMember("vrfProof", value, document.GetAllocator());
@@ -1025,18 +1121,19 @@ AlgorandParticipant::CertifyVotePhase() {
 
             AdvertiseVoteOrProposal(CERTIFY_VOTE, document);
             NS_LOG_INFO ("Advertised certify vote: " << (*votedBlock));
-            SaveBlockToVector(&m_receivedCertifyVotes, participantId + 1, votedBlock);
 
-            // save also to pre-tally
-            SaveBlockToVector(&m_receivedCertifyVotePreTally, m_iterationCV, votedBlock, m_nextStakeSize);
-            int tot = IncreaseCntOfReceivedVotes(&m_certifyVotes, m_iterationCV, m_nextStakeSize);
-            NS_LOG_INFO (GetNode()->GetId() << " - Total Votes CV("<<m_iterationCV<<"): " << tot);
-
-            // increase count of voters in the iterations
-            IncreaseCntOfReceivedVotes(&m_certifyVoters, m_iterationCV);
+            // save also to tally
+            AlgorandVoteTally &tally = GetVoteTally(CERTIFY_VOTE_PHASE, m_iterationCV);
+            tally.AddVote(participantId, votedBlock->GetBlockKey(), votes);
+            m_seenMessages.Insert(CERTIFY_VOTE, participantId, m_iterationCV);
+            NS_LOG_INFO (GetNode()->GetId() << " - Total Votes CV("<<m_iterationCV<<"): " << tally.GetTotalStake());
         }
     }
     m_nextBlockProposalEvent = Simulator::Schedule (Seconds(m_intervalCV), &AlgorandParticipant::BlockProposalPhase, this);
+    BatchVrfProver::GetInstance().Expect(Simulator::Now() + Seconds(m_intervalCV), m_sk);
+
+    // votes received before the phase may already reach the quorum
+    CheckEarlyQuorum(CERTIFY_VOTE_PHASE, m_iterationCV);
 }
 
 bool
@@ -1055,14 +1152,18 @@ AlgorandParticipant::ProcessReceivedCertifyVote(rapidjson::Document *message, Ad
     NS_LOG_FUNCTION (this);
 
     // Checking valid VRF
-    std::string blockHash = (*message)["blockHash"].GetString();
+    BlockKey blockKey = BlockKey::FromString((*message)["blockHash"].GetString());
     int blockIteration = (*message)["blockIteration"].GetInt();
     int participantId = (*message)["voterId"].GetInt();
 
     // update statistics
     m_nodeStats->voteReceivedBytes += m_fixedVoteSize;
 
-    Block *votedBlock = FindBlockInVector(&m_receivedBlockProposals, blockIteration, blockHash);
+    // already accepted votes are dropped before VRF verification
+    if(m_seenMessages.IsDuplicate(CERTIFY_VOTE, participantId, blockIteration))
+        return;
+
+    Block *votedBlock = FindBlockInVector(&m_receivedBlockProposals, blockIteration, blockKey);
     if(votedBlock == nullptr)
         // block proposal was not found
         return;
@@ -1079,10 +1180,15 @@ AlgorandParticipant::ProcessReceivedCertifyVote(rapidjson::Document *message, Ad
     memcpy(actualVrfSeed, (*message)["currentSeed"].GetString(), sizeof actualVrfSeed);
 
     // generate vfrOut for proof for proof and check if it is lower than threshold
-    crypto_vrf_verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    int vrfRc = VrfVerifyCache::GetInstance().Verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    ChargeCpuTime(VrfBackend::GetVerifyDelay());
+
+    if(vrfRc != 0){
+        NS_LOG_INFO (GetNode()->GetId() << " - INVALID Certify vote - participantId: " << participantId << " block iterationCV: " << blockIteration << " Reason: invalid VRF proof");
+        return;
+    }
 
-    int chosenCV = memcmp(vrfOut, m_vrfThresholdCV, sizeof vrfOut);
-    bool chosen = (chosenCV <= 0) ? true : false;
+    bool chosen = IsVoteChosen(vrfOut, m_vrfThresholdCV, message);
 
 //    if(!m_helper->IsChosenByVRF(blockIteration, participantId, CERTIFY_VOTE_PHASE)){
     if(!chosen){
@@ -1090,24 +1196,22 @@ AlgorandParticipant::ProcessReceivedCertifyVote(rapidjson::Document *message, Ad
         return;
     }
 
-    // Inserting received block proposal into vector - participantId is indexed from 0 so we increase value to prevent mem errors
-    bool inserted = SaveBlockToVector(&m_receivedCertifyVotes, participantId + 1, votedBlock);
+    // Inserting received vote into tally of the iteration, only the first vote of the voter is counted
+    int algoAmount = (int) (*message)["algoAmount"].GetUint();
+    AlgorandVoteTally &tally = GetVoteTally(CERTIFY_VOTE_PHASE, blockIteration);
+    bool inserted = tally.AddVote(participantId, blockKey, algoAmount);
+    m_seenMessages.Insert(CERTIFY_VOTE, participantId, blockIteration);
     if(!inserted) {
         NS_LOG_INFO (GetNode()->GetId() << " - Already received certify vote - participantId: " << participantId << ", iterationCV: " << blockIteration);
         return;     // block soft vote from this voter was already received
     }
     NS_LOG_INFO (GetNode()->GetId() << " - Received certify vote (i: "<< blockIteration <<", voter: "<< participantId <<"): " << (*votedBlock) );
 
-    // if so, save to pre-tally
-    int algoAmount = (int) (*message)["algoAmount"].GetUint();
-    SaveBlockToVector(&m_receivedCertifyVotePreTally, blockIteration, votedBlock, algoAmount);
-    int tot = IncreaseCntOfReceivedVotes(&m_certifyVotes, blockIteration, algoAmount);
-    NS_LOG_INFO (GetNode()->GetId() << " - Total Votes CV("<<m_iterationCV<<"): " << tot);
+    NS_LOG_INFO (GetNode()->GetId() << " - Total Votes CV("<<blockIteration<<"): " << tally.GetTotalStake());
 
     AdvertiseVoteOrProposal(CERTIFY_VOTE, *message, &receivedFrom);
 
-    // increase count of voters in the iterations
-    IncreaseCntOfReceivedVotes(&m_certifyVoters, blockIteration);
+    CheckEarlyQuorum(CERTIFY_VOTE_PHASE, blockIteration);
 }
 
 /** ----------- end of: CERTIFY VOTE PHASE ----------- */
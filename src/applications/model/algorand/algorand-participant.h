@@ -8,6 +8,9 @@
 
 #include "ns3/algorand-node.h"
 #include "ns3/algorand-participant-helper.h"
+#include "ns3/algorand-vote-tally.h"
+#include "ns3/seen-message-cache.h"
+#include "ns3/stake-sortition.h"
 #include <random>
 #include <utility>
 #include <vector>
@@ -64,15 +67,6 @@ protected:
 
     virtual void DoDispose (void);
 
-    /**
-     * \brief Sends a message to a peer
-     * \param receivedMessage the type of the received message
-     * \param responseMessage the type of the response message
-     * \param d the stringified rapidjson document containing the info of the outgoing message
-     * \param outgoingSocket the socket of the peer
-     */
-    void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, std::string d, Ptr<Socket> outgoingSocket);
-
     /**
      * \brief Handle a document received by the application with unknown type number
      * \param document the received document
@@ -162,35 +156,21 @@ protected:
     bool SaveBlockToVector(std::vector<std::vector<Block>> *blockVector, int iteration, Block block);
 
     /**
-     * saves block into vector (softVoteTally, certifyVoteTally, ...) if vector does not contains it yet
-     * if needed, it makes resize of vector to proper size (by iteration number)
-     * @param blockVector vector where pointer should be inserted
+     * returns tally of the votes in the iteration, if needed, it makes resize of vector to proper size (by iteration number)
+     * @param phase Algorand phase (soft vote, certify vote) - for decision from which vector we should take tally
      * @param iteration phase iteration number
-     * @param block pointer on block which we want to save
-     * @return true if block has been inserted into vector, false otherwise (block already inside)
+     * @return reference to the tally of the iteration
      */
-    bool SaveBlockToVector(std::vector<std::vector<Block*>> *blockVector, int iteration, Block *block);
-
-    /**
-     * saves pointer on block into vector of maps (softVotePreTally) and increases count of votes for this block
-     * if needed, it makes resize of vector to proper size (by iteration number)
-     * @param blockVector vector where pointer should be inserted
-     * @param iteration phase iteration number
-     * @param block pointer on block which we want to save
-     * @param algoAmount value of the vote
-     * @return count of total votes for this block (for checking if quorum has been reached)
-     */
-    int SaveBlockToVector(std::vector<std::vector<std::pair<Block*, int>>> *blockVector, int iteration,
-                          Block *block, int algoAmount);
+    AlgorandVoteTally& GetVoteTally(AlgorandPhase phase, int iteration);
 
     /**
      * Finds block in vector (blockProposals) and returns pointer to it
      * @param blockVector vector where pointer should be found
      * @param iteration phase iteration number
-     * @param blockHash hash of block which we are looking for
+     * @param blockKey key of block which we are looking for
      * @return returns pointer on block if block was found, nullptr otherwise
      */
-    Block* FindBlockInVector(std::vector<std::vector<Block>> *blockVector, int iteration, std::string blockHash);
+    Block* FindBlockInVector(std::vector<std::vector<Block>> *blockVector, int iteration, const BlockKey &blockKey);
 
     /**
      * increases total count of votes received in the iteration by the value
@@ -202,13 +182,21 @@ protected:
     int IncreaseCntOfReceivedVotes(std::vector<int> *counterVector, int iteration, int value = 1);
 
     /**
-     * from preTally vector and votes counter vector returns a pointer on block which reaches quorum in confirmed votes
+     * from tally of the iteration returns a pointer on block which reaches quorum in confirmed votes
      * @param phase Algorand phase (soft vote, certify vote) - for decision from which vector we should take values
      * @param iteration phase iteration number
      * @return pointer on confirmed blocks, if none of blocks reaches quorum we return nullptr
      */
     Block* GetConfirmedBlock(AlgorandPhase phase, int iteration);
 
+    /**
+     * starts the next phase without waiting for the end of the interval, if the quorum of the committee stake
+     * (m_totalCommitteeStake) was reached in the running phase of the iteration
+     * @param phase Algorand phase (soft vote, certify vote) of the received vote
+     * @param iteration phase iteration number of the received vote
+     */
+    void CheckEarlyQuorum(AlgorandPhase phase, int iteration);
+
     /**
      * prints actual state on stderr
      * @param iteration
@@ -226,6 +214,16 @@ protected:
      */
     void GenNextStakeSize(AlgorandPhase phase);
 
+    /**
+     * checks if the voter of the received vote was chosen to the committee, with the sortition the weight
+     * of the vote (algoAmount) has to be the number of the sub-users selected from the stake of the voter (balance)
+     * @param vrfOut verified VRF output of the voter
+     * @param threshold VRF threshold of the phase, used without the sortition
+     * @param message pointer to rapidjson document containing the vote
+     * @return true if the vote is from a committee member
+     */
+    bool IsVoteChosen(const unsigned char *vrfOut, const unsigned char *threshold, rapidjson::Document *message);
+
     /**
      * counts average committee size from received block proposals in each phase
      * @param phase Algorand phase (soft vote, certify vote) - for decision from which vector we should take values
@@ -274,16 +272,18 @@ protected:
 
     std::vector<std::vector<Block>> m_receivedBlockProposals;     // vector of block proposals received in certain iterations
 
-    std::vector<std::vector<Block*>> m_receivedSoftVotes;          // vector of soft votes received from certain voters (iteration is replaced with voterId) - in real Algorand voterId would be VRF proof
-    std::vector<std::vector<std::pair<Block*, int>>> m_receivedSoftVotePreTally; // vector of soft vote in certain iterations, with count of votes
-    std::vector<std::vector<Block*>> m_receivedSoftVoteTally;      // vector of soft vote in certain iterations with reached quorum
-    std::vector<int> m_softVotes;                                 // vector containing count of votes for each iteration (multiplied by stakes)
-    std::vector<int> m_softVoters;                                 // vector containing count of voters for each iteration of soft vote
+    std::vector<AlgorandVoteTally> m_softVoteTallies;             // tallies of soft votes in certain iterations (voters and stakes by voted block)
+    std::vector<AlgorandVoteTally> m_certifyVoteTallies;          // tallies of certify votes in certain iterations
+    SeenMessageCache m_seenMessages;                              // accepted proposals and votes, duplicates are dropped before VRF verification
+
+    uint32_t     m_totalCommitteeStake;         // expected stake of the vote committee, if not 0 the phase ends as soon as the quorum of it is reached
+    double       m_roundStart;                  // time when the last block proposal phase started
+    double       m_averageRoundTime;            // average time between two block proposal phases
+    int          m_earlyQuorums;                // count of phases ended by the early quorum
 
-    std::vector<std::vector<Block*>> m_receivedCertifyVotes;       // vector of certify votes received from certain voters similarly as in soft vote phase
-    std::vector<std::vector<std::pair<Block*, int>>> m_receivedCertifyVotePreTally; // vector of certify vote in certain iterations, with count of votes
-    std::vector<int> m_certifyVotes;                              // vector containing count of votes for each iteration (multiplied by stakes)
-    std::vector<int> m_certifyVoters;                                 // vector containing count of voters for each iteration of soft vote
+    uint32_t        m_sortitionCommitteeSize;   // expected weight of the vote committee selected by the stake weighted sortition, 0 for the VRF threshold
+    uint64_t        m_sortitionTotalStake;      // total stake of all participants for the sortition
+    StakeSortition *m_sortition;                // shared sortition tables, nullptr without the sortition
 
     EventId m_nextBlockProposalEvent; 				//!< Event to next block proposal
     EventId m_nextSoftVoteEvent; 				    //!< Event to next soft vote
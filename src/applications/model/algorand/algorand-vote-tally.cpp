@@ -0,0 +1,74 @@
+/**
+* Implementation of AlgorandVoteTally class
+*/
+
+#include "algorand-vote-tally.h"
+
+namespace ns3 {
+
+AlgorandVoteTally::AlgorandVoteTally () : m_totalStake(0)
+{
+}
+
+bool
+AlgorandVoteTally::AddVote (int voterId, const BlockKey &blockKey, int stake)
+{
+    if(!m_voters.insert(voterId).second)
+        return false;
+
+    auto index_it = m_blockIndices.find(blockKey);
+    if(index_it == m_blockIndices.end()) {
+        m_blockIndices[blockKey] = m_blockStakes.size();
+        m_blockStakes.push_back(std::make_pair(blockKey, stake));
+    }
+    else
+        m_blockStakes[index_it->second].second += stake;
+
+    m_totalStake += stake;
+    return true;
+}
+
+bool
+AlgorandVoteTally::HasVoted (int voterId) const
+{
+    return m_voters.find(voterId) != m_voters.end();
+}
+
+int
+AlgorandVoteTally::GetNoVoters (void) const
+{
+    return m_voters.size();
+}
+
+int
+AlgorandVoteTally::GetTotalStake (void) const
+{
+    return m_totalStake;
+}
+
+int
+AlgorandVoteTally::GetBlockStake (const BlockKey &blockKey) const
+{
+    auto index_it = m_blockIndices.find(blockKey);
+    return index_it != m_blockIndices.end() ? m_blockStakes[index_it->second].second : 0;
+}
+
+const BlockKey*
+AlgorandVoteTally::GetQuorumBlock (int minVoters, int totalStake) const
+{
+    if((int) m_voters.size() < minVoters)
+        return nullptr;
+
+    if(totalStake == 0)
+        totalStake = m_totalStake;
+
+    // only the voted blocks are scanned, there are only few proposals in one iteration
+    for(auto &block : m_blockStakes) {
+        if(block.second > (2 * (totalStake / 3)))
+            return &block.first;
+    }
+
+    return nullptr;
+}
+
+} // ns3 namespace
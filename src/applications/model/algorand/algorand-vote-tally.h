@@ -0,0 +1,72 @@
+/**
+ * AlgorandVoteTally class declarations
+ */
+
+#ifndef SIMPOS_ALGORAND_VOTE_TALLY_H
+#define SIMPOS_ALGORAND_VOTE_TALLY_H
+
+#include "ns3/blockchain.h"
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Votes of one Algorand step (soft vote or certify vote) in one iteration. The stakes are accumulated
+ * by the key of the voted block, every voter is counted only once in the iteration.
+ */
+class AlgorandVoteTally
+{
+public:
+    AlgorandVoteTally ();
+
+    /**
+     * adds the vote if the voter did not vote in the iteration yet
+     * @param voterId id of the voter
+     * @param blockKey key of the voted block
+     * @param stake stake of the vote
+     * @return true if the vote was added, false if the voter already voted
+     */
+    bool AddVote (int voterId, const BlockKey &blockKey, int stake);
+
+    /**
+     * @param voterId id of the voter
+     * @return true if the vote of the voter was already added
+     */
+    bool HasVoted (int voterId) const;
+
+    /**
+     * Gets the number of voters in the iteration
+     */
+    int GetNoVoters (void) const;
+
+    /**
+     * Gets the sum of the stakes of all votes in the iteration
+     */
+    int GetTotalStake (void) const;
+
+    /**
+     * @param blockKey key of the block
+     * @return sum of the stakes of the votes for the block
+     */
+    int GetBlockStake (const BlockKey &blockKey) const;
+
+    /**
+     * finds the first voted block which has more than 2/3 of the total stake
+     * @param minVoters minimal number of voters needed for the quorum
+     * @param totalStake total stake from which the quorum is counted, 0 for the stake of the received votes
+     * @return pointer to the key of the block which reached the quorum, nullptr otherwise
+     */
+    const BlockKey* GetQuorumBlock (int minVoters, int totalStake = 0) const;
+
+private:
+    BlockKeyMap<int>                          m_blockIndices;       // index of the block in m_blockStakes
+    std::vector<std::pair<BlockKey, int>>     m_blockStakes;        // stake of the votes by block, in order of the first vote
+    std::unordered_set<int>                   m_voters;             // ids of the voters in the iteration
+    int                                       m_totalStake;         // stake of all votes in the iteration
+};
+
+} // ns3 namespace
+
+#endif //SIMPOS_ALGORAND_VOTE_TALLY_H
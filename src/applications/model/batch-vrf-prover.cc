@@ -0,0 +1,113 @@
+/**
+ * This file contains the definitions of the functions declared in batch-vrf-prover.h
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "batch-vrf-prover.h"
+#include "vrf-backend.h"
+#include "../libsodium/include/sodium.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BatchVrfProver");
+
+BatchVrfProver&
+BatchVrfProver::GetInstance (void)
+{
+  static BatchVrfProver instance;
+  return instance;
+}
+
+BatchVrfProver::BatchVrfProver (void) : m_noThreads (1), m_batchTime (-1)
+{
+}
+
+void
+BatchVrfProver::SetNoThreads (uint32_t noThreads)
+{
+  // libsodium is thread safe only after its initialization, it has to be done before the workers start
+  if (noThreads >= 2 && sodium_init () < 0)
+    NS_FATAL_ERROR ("Cannot initialize libsodium for the parallel VRF proves");
+
+  m_noThreads = noThreads;
+}
+
+void
+BatchVrfProver::Expect (Time time, const unsigned char *sk)
+{
+  if (m_noThreads < 2)
+    return;
+
+  m_expected[time.GetTimeStep ()].insert (std::string ((const char*) sk, VrfBackend::SECRET_KEY_SIZE));
+}
+
+int
+BatchVrfProver::Prove (unsigned char *proof, const unsigned char *sk, const unsigned char *m, unsigned long long mlen)
+{
+  if (m_noThreads < 2)
+    return VrfBackend::Prove (proof, sk, m, mlen);
+
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  std::string seed ((const char*) m, mlen);
+
+  if (now != m_batchTime)
+  {
+    // the first prove at the time computes the batch for its seed, the previous batch is not needed anymore
+    m_batchTime = now;
+    m_batchSeed = seed;
+    m_results.clear ();
+    RunBatch ();
+    m_expected.erase (m_expected.begin (), m_expected.upper_bound (now));
+  }
+
+  auto it = m_results.find (std::string ((const char*) sk, VrfBackend::SECRET_KEY_SIZE));
+  if (seed != m_batchSeed || it == m_results.end ())
+    return VrfBackend::Prove (proof, sk, m, mlen);
+
+  memcpy (proof, it->second.proof, sizeof it->second.proof);
+  return it->second.rc;
+}
+
+void
+BatchVrfProver::RunBatch (void)
+{
+  const std::string &seed = m_batchSeed;
+  auto expected_it = m_expected.find (m_batchTime);
+  if (expected_it == m_expected.end () || expected_it->second.size () < 2)
+    return;
+
+  std::vector<const std::string*> keys;
+  for (auto &sk : expected_it->second)
+    keys.push_back (&sk);
+
+  std::vector<Result> results (keys.size ());
+  uint32_t noThreads = std::min<uint32_t> (m_noThreads, keys.size ());
+  std::vector<std::thread> workers;
+
+  // every worker takes every noThreads-th key, the workers share nothing but the read only inputs
+  for (uint32_t t = 0; t < noThreads; t++)
+  {
+    workers.push_back (std::thread ([&keys, &results, &seed, noThreads, t] ()
+    {
+      for (uint32_t i = t; i < keys.size (); i += noThreads)
+      {
+        results[i].rc = VrfBackend::Prove (results[i].proof, (const unsigned char*) keys[i]->data (),
+                                           (const unsigned char*) seed.data (), seed.size ());
+      }
+    }));
+  }
+
+  for (auto &worker : workers)
+    worker.join ();
+
+  for (uint32_t i = 0; i < keys.size (); i++)
+    m_results[*keys[i]] = results[i];
+
+  NS_LOG_INFO ("Computed " << keys.size () << " VRF proofs on " << noThreads << " threads");
+}
+
+} // Namespace ns3
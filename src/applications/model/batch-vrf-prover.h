@@ -0,0 +1,78 @@
+/**
+ * This file contains the declaration of the BatchVrfProver, which computes the VRF proofs
+ * of all participants due at the same simulated time in parallel.
+ */
+
+#ifndef SIMPOS_BATCH_VRF_PROVER_H
+#define SIMPOS_BATCH_VRF_PROVER_H
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * Process wide batching of the VRF proves. The participants announce the time of their next phase
+ * which starts with a prove. The first prove at that time computes the proofs of all announced
+ * participants for the same seed on the worker threads, the other participants then only take their
+ * proof. The proofs are deterministic, so the results and the order of the events are the same as
+ * with the proves computed one by one. A participant with another seed (e.g. on a fork) computes
+ * its proof itself.
+ */
+class BatchVrfProver
+{
+public:
+  /**
+   * \return the instance shared by all participants in the process
+   */
+  static BatchVrfProver& GetInstance (void);
+
+  /**
+   * \brief Sets the number of the worker threads, with less than 2 threads the proofs are computed one by one
+   */
+  void SetNoThreads (uint32_t noThreads);
+
+  /**
+   * \brief Announces the prove of the participant at the time
+   * \param time the simulated time of the phase which starts with the prove
+   * \param sk the secret key of the participant
+   */
+  void Expect (Time time, const unsigned char *sk);
+
+  /**
+   * \brief Same as VrfBackend::Prove, the proof is taken from the batch of the current time if it is there
+   */
+  int Prove (unsigned char *proof, const unsigned char *sk, const unsigned char *m, unsigned long long mlen);
+
+private:
+  BatchVrfProver (void);
+
+  struct Result
+  {
+    int           rc;
+    unsigned char proof[80];
+  };
+
+  /**
+   * \brief Computes the proofs of all participants announced at the current time for the seed
+   *
+   * Only one batch is computed per time step, for the seed of the first prove asked at the time. If that
+   * participant is on a minority fork, the participants on the main chain compute their proofs one by one.
+   */
+  void RunBatch (void);
+
+  uint32_t                                          m_noThreads;
+  std::map<int64_t, std::set<std::string>>          m_expected;       //the secret keys by the time step of the announced prove
+  int64_t                                           m_batchTime;      //the time step of the computed batch
+  std::string                                       m_batchSeed;      //the seed of the computed batch
+  std::unordered_map<std::string, Result>           m_results;        //the proofs of the batch by the secret key
+};
+
+} // Namespace ns3
+
+#endif /* SIMPOS_BATCH_VRF_PROVER_H */
@@ -430,11 +430,7 @@ BitcoinMiner::MineBlock (void)
   int minerId = GetNode ()->GetId ();
   int parentBlockMinerId = m_blockchain.GetCurrentTopBlock()->GetMinerId();
   double currentTime = Simulator::Now ().GetSeconds ();
-  std::ostringstream stringStream;  
-  std::string blockHash;
-  
-  stringStream << height << "/" << minerId;
-  blockHash = stringStream.str();
+  std::string blockHash = BlockKey(height, minerId).ToString();
   
   inv.SetObject();
   block.SetObject();
@@ -792,20 +788,20 @@ BitcoinMiner::MineBlock (void)
   rapidjson::StringBuffer blockInfo;
   rapidjson::Writer<rapidjson::StringBuffer> blockWriter(blockInfo);
   block.Accept(blockWriter);
+
+  std::string invFrame;
+  m_codec->EncodeFrame(inv, invFrame);
   
   int count = 0;
 
   for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i, ++count)
   {
-    
-    const uint8_t delimiter[] = "#";
 
     switch(m_blockBroadcastType)				  
     {
       case STANDARD:
       {
-        m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
-        m_peersSockets[*i]->Send (delimiter, 1, 0);
+        SendFrame (m_peersSockets[*i], invFrame);
 		
         if (m_protocolType == STANDARD_PROTOCOL && !m_blockTorrent)
           m_nodeStats->invSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
@@ -911,8 +907,7 @@ BitcoinMiner::MineBlock (void)
         }
         else
         {	    
-          m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
-          m_peersSockets[*i]->Send (delimiter, 1, 0);
+          SendFrame (m_peersSockets[*i], invFrame);
 	  
           if (m_protocolType == STANDARD_PROTOCOL && !m_blockTorrent)
             m_nodeStats->invSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
@@ -19,6 +19,7 @@
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
 #include "bitcoin-node.h"
+#include <algorithm>
 
 namespace ns3 {
 
@@ -63,6 +64,21 @@ BitcoinNode::GetTypeId (void)
                    UintegerValue (100000),
                    MakeUintegerAccessor (&BitcoinNode::m_chunkSize),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxOrphans",
+                   "The maximum number of orphan blocks kept by the node, 0 for unlimited",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&BitcoinNode::m_maxOrphans),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxOrphanAge",
+                   "The maximum time an orphan block is kept by the node, 0 for unlimited",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&BitcoinNode::m_maxOrphanAge),
+                   MakeTimeChecker())
+    .AddAttribute ("PruneFinalized",
+                   "Prune the blocks below the finalized checkpoints (Casper, Gasper)",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BitcoinNode::m_pruneFinalized),
+                   MakeBooleanChecker ())
     .AddTraceSource ("Rx",
                      "A packet has been received",
                      MakeTraceSourceAccessor (&BitcoinNode::m_rxTrace),
@@ -93,7 +109,8 @@ BitcoinNode::BitcoinNode (void) : m_bitcoinPort (8333), m_secondsPerMin(60), m_i
   m_maxBlockPropagationTime = 0;
   m_meanBlockSize = 0;
   m_numberOfPeers = m_peersAddresses.size();
-  
+  m_codec = MessageCodec::GetDefault ();
+  m_cpuBusyUntil = 0;
 }
 
 BitcoinNode::~BitcoinNode(void)
@@ -192,6 +209,10 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
   NS_LOG_WARN ("Node " << GetNode()->GetId() << ": m_protocolType = " << getProtocolType(m_protocolType));
   NS_LOG_WARN ("Node " << GetNode()->GetId() << ": m_blockTorrent = " << m_blockTorrent);
   NS_LOG_WARN ("Node " << GetNode()->GetId() << ": m_chunkSize = " << m_chunkSize << " Bytes");
+  NS_LOG_INFO ("Node " << GetNode()->GetId() << ": m_maxOrphans = " << m_maxOrphans << ", m_maxOrphanAge = " << m_maxOrphanAge.GetSeconds() << "s");
+
+  m_blockchain.SetOrphanLimits(m_maxOrphans, m_maxOrphanAge.GetSeconds());
+  m_blockchain.SetPruning(m_pruneFinalized);
 
   NS_LOG_INFO ("Node " << GetNode()->GetId() << ": My peers are");
   
@@ -352,50 +373,22 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
       if (InetSocketAddress::IsMatchingType (from)) {
           /**
            * We may receive more than one packets simultaneously on the socket,
-           * so we have to parse each one of them.
+           * so we have to parse each one of them. Every message is prefixed by
+           * the length of its payload (see MessageCodec::EncodeFrame).
            */
 
-          std::string delimiter = "#";
-          NS_LOG_INFO("Node " << GetNode()->GetId() << " CRYPTO: " << m_cryptocurrency);
+        StreamFramer &framer = m_streamFramers[from];
+        MessageView parsedPacket;
 
-        if(m_cryptocurrency == ALGORAND
-        || m_cryptocurrency == GASPER)
-        {
-            delimiter = "^#EOM#^";
-        }
+        framer.Append (packet);
+        NS_LOG_INFO("Node " << GetNode ()->GetId () << " received " << packet->GetSize ()
+                    << " bytes, buffered " << framer.GetBufferedSize () << " bytes");
 
-        std::string parsedPacket;
-        size_t pos = 0;
-        char *packetInfo = new char[packet->GetSize () + 1];
-        std::ostringstream totalStream;
-		
-        packet->CopyData (reinterpret_cast<uint8_t*>(packetInfo), packet->GetSize ());
-        packetInfo[packet->GetSize ()] = '\0'; // ensure that it is null terminated to avoid bugs
-        NS_LOG_INFO("Node " << GetNode ()->GetId () << " Packet Info: " << packetInfo);
-
-        /**
-         * Add the buffered data to complete the packet
-         */
-        totalStream << m_bufferedData[from] << packetInfo; 
-        std::string totalReceivedData(totalStream.str());
-        NS_LOG_INFO("Node " << GetNode ()->GetId () << " Total Received Data: " << totalReceivedData);
-
-        while ((pos = totalReceivedData.find(delimiter)) != std::string::npos)
+        while (framer.PeekFrame (parsedPacket))
         {
-
-          parsedPacket = totalReceivedData.substr(0, pos);
-          NS_LOG_INFO("Node " << GetNode ()->GetId () << " Parsed Packet: " << parsedPacket);
-
           ProcessParsedPacket(parsedPacket, packet, from, newBlockReceiveTime);
-          totalReceivedData.erase(0, pos + delimiter.length());
+          framer.PopFrame ();
         }
-		
-        /**
-        * Buffer the remaining data
-        */
-		 
-        m_bufferedData[from] = totalReceivedData;
-        delete[] packetInfo;
       }
       else if (Inet6SocketAddress::IsMatchingType (from))
       {
@@ -410,28 +403,23 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
 }
 
 void
-BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
+BitcoinNode::ProcessParsedPacket (const MessageView &parsedPacket, Ptr<Packet> packet,
                                   Address from, double newBlockReceiveTime){
 
     rapidjson::Document d;
-    d.Parse(parsedPacket.c_str());
 
-    if(!d.IsObject())
+    if(!m_codec->Decode(parsedPacket.data, parsedPacket.size, d))
     {
         NS_LOG_WARN("The parsed packet is corrupted");
         return;
     }
 
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    d.Accept(writer);
-
     NS_LOG_INFO ("At time "  << newBlockReceiveTime
                              << "s bitcoin node " << GetNode ()->GetId () << " received "
                              <<  packet->GetSize () << " bytes from "
                              << InetSocketAddress::ConvertFrom(from).GetIpv4 ()
                              << " port " << InetSocketAddress::ConvertFrom (from).GetPort ()
-                             << " with info = " << buffer.GetString());
+                             << " with info = " << RenderMessage(d));
 
     switch (d["message"].GetInt())
     {
@@ -439,23 +427,21 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
         {
             //NS_LOG_INFO ("INV");
             int j;
-            std::vector<std::string>            requestBlocks;
-            std::vector<std::string>::iterator  block_it;
+            std::vector<BlockKey>            requestBlocks;
+            std::vector<BlockKey>::iterator  block_it;
 
             m_nodeStats->invReceivedBytes += m_bitcoinMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
 
             for (j=0; j<d["inv"].Size(); j++)
             {
-                std::string   invDelimiter = "/";
-                std::string   parsedInv = d["inv"][j].GetString();
-                size_t        invPos = parsedInv.find(invDelimiter);
+                BlockKey      parsedInv = BlockKey::FromString(d["inv"][j].GetString());
                 EventId       timeout;
 
-                int height = atoi(parsedInv.substr(0, invPos).c_str());
-                int minerId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
+                int height = parsedInv.GetHeight();
+                int minerId = parsedInv.GetMinerId();
 
 
-                if (m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId) || ReceivedButNotValidated(parsedInv))
+                if (m_blockchain.HasBlock(parsedInv) || m_blockchain.IsOrphan(parsedInv) || ReceivedButNotValidated(parsedInv))
                 {
                     NS_LOG_INFO("INV: Bitcoin node " << GetNode ()->GetId ()
                                                      << " has already received the block with height = "
@@ -499,7 +485,8 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
                 for (block_it = requestBlocks.begin(); block_it < requestBlocks.end(); block_it++)
                 {
-                    value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
+                    std::string blockHash = block_it->ToString();
+                    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
                     array.PushBack(value, d.GetAllocator());
                 }
 
@@ -515,29 +502,27 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
         {
             //NS_LOG_INFO ("EXT_INV");
             int j;
-            std::vector<std::string>            requestHeaders;
+            std::vector<BlockKey>               requestHeaders;
             std::vector<std::string>            requestChunks;
 
-            std::vector<std::string>::iterator  block_it;
+            std::vector<BlockKey>::iterator     block_it;
 
             m_nodeStats->extInvReceivedBytes += m_bitcoinMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
 
             for (j=0; j<d["inv"].Size(); j++)
             {
-                std::string   invDelimiter = "/";
-                std::string   blockHash = d["inv"][j]["hash"].GetString();
+                BlockKey      blockHash = BlockKey::FromString(d["inv"][j]["hash"].GetString());
                 int           blockSize = d["inv"][j]["size"].GetInt();
-                size_t        invPos = blockHash.find(invDelimiter);
                 EventId       timeout;
 
-                int height = atoi(blockHash.substr(0, invPos).c_str());
-                int minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
+                int height = blockHash.GetHeight();
+                int minerId = blockHash.GetMinerId();
 
                 m_nodeStats->extInvReceivedBytes += 5;
                 if (!d["inv"][j]["fullBlock"].GetBool())
                     m_nodeStats->extInvReceivedBytes += d["inv"][j]["availableChunks"].Size();
 
-                if (m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId) || ReceivedButNotValidated(blockHash))
+                if (m_blockchain.HasBlock(blockHash) || m_blockchain.IsOrphan(blockHash) || ReceivedButNotValidated(blockHash))
                 {
                     NS_LOG_INFO("EXT_INV: Bitcoin node " << GetNode ()->GetId ()
                                                          << " has already received the block with height = "
@@ -603,14 +588,13 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                                                                        m_queueChunks[blockHash].end(), candidateChunks[randomIndex]),
                                                            m_queueChunks[blockHash].end());
 
-                            std::ostringstream chunk;
-                            chunk << blockHash << "/" << candidateChunks[randomIndex];
-                            requestChunks.push_back(chunk.str());
+                            std::string chunk = blockHash.ToChunkString(candidateChunks[randomIndex]);
+                            requestChunks.push_back(chunk);
 
                             timeout = Simulator::Schedule (Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))),
-                                                           &BitcoinNode::ChunkTimeoutExpired, this, chunk.str());
+                                                           &BitcoinNode::ChunkTimeoutExpired, this, chunk);
 
-                            m_chunkTimeouts[chunk.str()] = timeout;
+                            m_chunkTimeouts[chunk] = timeout;
                             m_queueChunkPeers[blockHash].push_back(from);
                         }
                         else
@@ -642,7 +626,8 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
                 for (block_it = requestHeaders.begin(); block_it < requestHeaders.end(); block_it++)
                 {
-                    value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
+                    std::string blockHash = block_it->ToString();
+                    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
                     array.PushBack(value, d.GetAllocator());
                 }
 
@@ -668,23 +653,8 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                 for (auto chunk_it = requestChunks.begin(); chunk_it < requestChunks.end(); chunk_it++)
                 {
 
-                    std::string            invDelimiter = "/";
-                    std::string            chunkHash = *chunk_it;
-                    std::string            chunkHashHelp = chunkHash.substr(0);
-                    std::ostringstream     help;
-                    std::string            blockHash;
-                    size_t                 invPos = chunkHashHelp.find(invDelimiter);
-
-                    int height = atoi(chunkHashHelp.substr(0, invPos).c_str());
-
-                    chunkHashHelp.erase(0, invPos + invDelimiter.length());
-                    invPos = chunkHashHelp.find(invDelimiter);
-                    int minerId = atoi(chunkHashHelp.substr(0, invPos).c_str());
-
-                    chunkHashHelp.erase(0, invPos + invDelimiter.length());
-                    int chunkId = atoi(chunkHashHelp.substr(0).c_str());
-                    help << height << "/" << minerId;
-                    blockHash = help.str();
+                    int                    chunkId;
+                    BlockKey               blockHash = BlockKey::FromChunkString(*chunk_it, chunkId);
 
                     if (m_receivedChunks.find(blockHash) != m_receivedChunks.end())
                     {
@@ -721,14 +691,12 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
             for (j=0; j<d["blocks"].Size(); j++)
             {
-                std::string   invDelimiter = "/";
-                std::string   blockHash = d["blocks"][j].GetString();
-                size_t        invPos = blockHash.find(invDelimiter);
+                BlockKey      blockHash = BlockKey::FromString(d["blocks"][j].GetString());
 
-                int height = atoi(blockHash.substr(0, invPos).c_str());
-                int minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
+                int height = blockHash.GetHeight();
+                int minerId = blockHash.GetMinerId();
 
-                if (m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId))
+                if (m_blockchain.GetBlockPointer(blockHash) != nullptr || m_blockchain.IsOrphan(blockHash))
                 {
                     NS_LOG_INFO("GET_HEADERS: Bitcoin node " << GetNode ()->GetId ()
                                                              << " has the block with height = "
@@ -801,14 +769,12 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
             for (j=0; j<d["blocks"].Size(); j++)
             {
-                std::string   invDelimiter = "/";
-                std::string   blockHash = d["blocks"][j].GetString();
-                size_t        invPos = blockHash.find(invDelimiter);
+                BlockKey      blockHash = BlockKey::FromString(d["blocks"][j].GetString());
 
-                int height = atoi(blockHash.substr(0, invPos).c_str());
-                int minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
+                int height = blockHash.GetHeight();
+                int minerId = blockHash.GetMinerId();
 
-                if (m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId))
+                if (m_blockchain.GetBlockPointer(blockHash) != nullptr || m_blockchain.IsOrphan(blockHash))
                 {
                     NS_LOG_INFO("EXT_GET_HEADERS: Bitcoin node " << GetNode ()->GetId ()
                                                                  << " has the block with height = "
@@ -843,8 +809,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                 rapidjson::Value     array(rapidjson::kArrayType);
                 rapidjson::Value     chunkArray(rapidjson::kArrayType);
                 rapidjson::Value     chunkInfo(rapidjson::kObjectType);
-                std::ostringstream   blockHashHelp;
-                std::string          blockHash;
+                BlockKey             blockHash;
 
                 d.RemoveMember("blocks");
 
@@ -852,8 +817,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                 {
                     NS_LOG_INFO ("In requestHeaders " << *block_it);
 
-                    blockHashHelp << block_it->GetBlockHeight () << "/" << block_it->GetMinerId ();
-                    blockHash = blockHashHelp.str();
+                    blockHash = block_it->GetBlockKey ();
 
                     value = block_it->GetBlockHeight ();
                     chunkInfo.AddMember("height", value, d.GetAllocator ());
@@ -873,8 +837,8 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                     value = block_it->GetTimeReceived ();
                     chunkInfo.AddMember("timeReceived", value, d.GetAllocator ());
 
-                    if (m_blockchain.HasBlock(block_it->GetBlockHeight (), block_it->GetMinerId ())
-                        || m_blockchain.IsOrphan(block_it->GetBlockHeight (), block_it->GetMinerId ())
+                    if (m_blockchain.HasBlock(blockHash)
+                        || m_blockchain.IsOrphan(blockHash)
                         || ReceivedButNotValidated(blockHash))
                     {
                         value = true;
@@ -925,14 +889,12 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
             for (j=0; j<d["blocks"].Size(); j++)
             {
-                std::string    invDelimiter = "/";
-                std::string    parsedInv = d["blocks"][j].GetString();
-                size_t         invPos = parsedInv.find(invDelimiter);
+                BlockKey       parsedInv = BlockKey::FromString(d["blocks"][j].GetString());
 
-                int height = atoi(parsedInv.substr(0, invPos).c_str());
-                int minerId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
+                int height = parsedInv.GetHeight();
+                int minerId = parsedInv.GetMinerId();
 
-                if (m_blockchain.HasBlock(height, minerId))
+                if (m_blockchain.GetBlockPointer(parsedInv) != nullptr)
                 {
                     NS_LOG_INFO("GET_DATA: Bitcoin node " << GetNode ()->GetId ()
                                                           << " has already received the block with height = "
@@ -1034,31 +996,20 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
             for (j=0; j<d["chunks"].Size(); j++)
             {
-                std::string            invDelimiter = "/";
                 std::string            chunkHash = d["chunks"][j]["chunk"].GetString();
-                std::string            chunkHashHelp = chunkHash.substr(0);
-                std::ostringstream     help;
-                std::string            blockHash;
-                size_t                 invPos = chunkHashHelp.find(invDelimiter);
+                int                    chunkId;
+                BlockKey               blockHash = BlockKey::FromChunkString(chunkHash, chunkId);
                 std::vector<int>       candidateChunks;
                 int                    blockSize = -1;
 
-                int height = atoi(chunkHashHelp.substr(0, invPos).c_str());
-
-                chunkHashHelp.erase(0, invPos + invDelimiter.length());
-                invPos = chunkHashHelp.find(invDelimiter);
-                int minerId = atoi(chunkHashHelp.substr(0, invPos).c_str());
-
-                chunkHashHelp.erase(0, invPos + invDelimiter.length());
-                int chunkId = atoi(chunkHashHelp.substr(0).c_str());
-                help << height << "/" << minerId;
-                blockHash = help.str();
+                int height = blockHash.GetHeight();
+                int minerId = blockHash.GetMinerId();
 
                 m_nodeStats->extGetDataReceivedBytes += 6; //1Byte(fullBlock) + 4Bytes(numberOfChunks) + 1Byte(requested chunk)
                 if (!d["chunks"][j]["fullBlock"].GetBool())
                     m_nodeStats->extGetDataReceivedBytes += d["chunks"][j]["availableChunks"].Size();
 
-                if (m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId) || ReceivedButNotValidated(blockHash))
+                if (m_blockchain.HasBlock(blockHash) || m_blockchain.IsOrphan(blockHash) || ReceivedButNotValidated(blockHash))
                 {
                     NS_LOG_INFO("EXT_GET_DATA: Bitcoin node " << GetNode ()->GetId ()
                                                               << " has already received the block with height = "
@@ -1111,8 +1062,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                                                                m_queueChunks[blockHash].end(), candidateChunks[randomIndex]),
                                                    m_queueChunks[blockHash].end());
 
-                    std::ostringstream chunk;
-                    chunk << blockHash << "/" << candidateChunks[randomIndex];
+                    std::string chunk = blockHash.ToChunkString(candidateChunks[randomIndex]);
                     requestedChunks[chunkHash] = candidateChunks[randomIndex];
 
 
@@ -1120,9 +1070,9 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                         NS_FATAL_ERROR ("blockSize == -1");
 
                     timeout = Simulator::Schedule (Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))),
-                                                   &BitcoinNode::ChunkTimeoutExpired, this, chunk.str());
+                                                   &BitcoinNode::ChunkTimeoutExpired, this, chunk);
 
-                    m_chunkTimeouts[chunk.str()] = timeout;
+                    m_chunkTimeouts[chunk] = timeout;
                     m_queueChunkPeers[blockHash].push_back(from);
                 }
                 else
@@ -1148,28 +1098,15 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                     rapidjson::Value requestChunks(rapidjson::kArrayType);
                     rapidjson::Value chunkInfo(rapidjson::kObjectType);
 
-                    std::string            invDelimiter = "/";
-                    std::ostringstream     help;
-                    std::string            blockHash;
-                    std::string            chunkHash = requestedChunk.first.substr(0);
-                    size_t                 invPos = chunkHash.find(invDelimiter);
+                    int                    chunkId;
+                    BlockKey               blockHash = BlockKey::FromChunkString(requestedChunk.first, chunkId);
                     Block                  newBlock;
                     int                    blockSize;
-                    int height = atoi(chunkHash.substr(0, invPos).c_str());
-
-                    chunkHash.erase(0, invPos + invDelimiter.length());
-                    invPos = chunkHash.find(invDelimiter);
-                    int minerId = atoi(chunkHash.substr(0, invPos).c_str());
 
-                    chunkHash.erase(0, invPos + invDelimiter.length());
-                    int chunkId = atoi(chunkHash.substr(0).c_str());
-                    help << height << "/" << minerId;
-                    blockHash = help.str();
 
-
-                    if (m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId))
+                    if (m_blockchain.GetBlockPointer(blockHash) != nullptr || m_blockchain.IsOrphan(blockHash))
                     {
-                        newBlock = m_blockchain.ReturnBlock (height, minerId);
+                        newBlock = m_blockchain.ReturnBlock (blockHash.GetHeight(), blockHash.GetMinerId());
                         value = true;
                         chunkInfo.AddMember("fullBlock", value, d.GetAllocator ());
                         blockSize = newBlock.GetBlockSizeBytes ();
@@ -1292,9 +1229,9 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
         {
             NS_LOG_INFO ("HEADERS");
 
-            std::vector<std::string>              requestHeaders;
-            std::vector<std::string>              requestBlocks;
-            std::vector<std::string>::iterator    block_it;
+            std::vector<BlockKey>                 requestHeaders;
+            std::vector<BlockKey>                 requestBlocks;
+            std::vector<BlockKey>::iterator       block_it;
             int j;
 
             m_nodeStats->headersReceivedBytes += m_bitcoinMessageHeader + m_countBytes + d["blocks"].Size()*m_headersSizeBytes;
@@ -1309,12 +1246,9 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
 
                 EventId              timeout;
-                std::ostringstream   stringStream;
-                std::string          blockHash;
-                std::string          parentBlockHash ;
+                BlockKey             blockHash(height, minerId);
+                BlockKey             parentBlockHash(parentHeight, parentMinerId);
 
-                stringStream << height << "/" << minerId;
-                blockHash = stringStream.str();
                 Block newBlockHeaders(d["blocks"][j]["height"].GetInt(), d["blocks"][j]["minerId"].GetInt(), d["blocks"][j]["parentBlockMinerId"].GetInt(),
                                       d["blocks"][j]["size"].GetInt(), d["blocks"][j]["timeCreated"].GetDouble(),
                                       Simulator::Now ().GetSeconds (), InetSocketAddress::ConvertFrom(from).GetIpv4 ());
@@ -1323,13 +1257,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                                                           Simulator::Now ().GetSeconds (), InetSocketAddress::ConvertFrom(from).GetIpv4 ());
                 //PrintOnlyHeadersReceived();
 
-                stringStream.clear();
-                stringStream.str("");
-
-                stringStream << parentHeight << "/" << parentMinerId;
-                parentBlockHash = stringStream.str();
-
-                if(m_protocolType == SENDHEADERS && !m_blockchain.HasBlock(height, minerId) && !m_blockchain.IsOrphan(height, minerId) && !ReceivedButNotValidated(blockHash))
+                if(m_protocolType == SENDHEADERS && !m_blockchain.HasBlock(blockHash) && !m_blockchain.IsOrphan(blockHash) && !ReceivedButNotValidated(blockHash))
                 {
                     NS_LOG_INFO("We have not received an INV for the block with height = " << d["blocks"][j]["height"].GetInt()
                                                                                            << " and minerId = " << d["blocks"][j]["minerId"].GetInt());
@@ -1342,7 +1270,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                     {
                         NS_LOG_INFO("HEADERS: Bitcoin node " << GetNode ()->GetId ()
                                                              << " has not requested the block yet");
-                        requestBlocks.push_back(blockHash.c_str());
+                        requestBlocks.push_back(blockHash);
                         timeout = Simulator::Schedule (m_invTimeoutMinutes, &BitcoinNode::InvTimeoutExpired, this, blockHash);
                         m_invTimeouts[blockHash] = timeout;
                     }
@@ -1357,7 +1285,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                 }
 
 
-                if (!m_blockchain.HasBlock(parentHeight, parentMinerId) && !m_blockchain.IsOrphan(parentHeight, parentMinerId) && !ReceivedButNotValidated(parentBlockHash))
+                if (!m_blockchain.HasBlock(parentBlockHash) && !m_blockchain.IsOrphan(parentBlockHash) && !ReceivedButNotValidated(parentBlockHash))
                 {
                     NS_LOG_INFO("The Block with height = " << d["blocks"][j]["height"].GetInt()
                                                            << " and minerId = " << d["blocks"][j]["minerId"].GetInt()
@@ -1376,7 +1304,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                            (m_protocolType == SENDHEADERS && std::find(requestBlocks.begin(), requestBlocks.end(), parentBlockHash) == requestBlocks.end()))
                         {
                             if (!OnlyHeadersReceived(parentBlockHash))
-                                requestHeaders.push_back(parentBlockHash.c_str());
+                                requestHeaders.push_back(parentBlockHash);
                             timeout = Simulator::Schedule (m_invTimeoutMinutes, &BitcoinNode::InvTimeoutExpired, this, parentBlockHash);
                             m_invTimeouts[parentBlockHash] = timeout;
                         }
@@ -1416,7 +1344,8 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
                 for (block_it = requestHeaders.begin(); block_it < requestHeaders.end(); block_it++)
                 {
-                    value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
+                    std::string blockHash = block_it->ToString();
+                    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
                     array.PushBack(value, d.GetAllocator());
                 }
 
@@ -1437,7 +1366,8 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
                 for (block_it = requestBlocks.begin(); block_it < requestBlocks.end(); block_it++)
                 {
-                    value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
+                    std::string blockHash = block_it->ToString();
+                    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
                     array.PushBack(value, d.GetAllocator());
                 }
 
@@ -1451,9 +1381,9 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
         {
             NS_LOG_INFO ("EXT_HEADERS");
 
-            std::vector<std::string>              requestHeaders;
+            std::vector<BlockKey>                 requestHeaders;
             std::vector<std::string>              requestChunks;
-            std::vector<std::string>::iterator    block_it;
+            std::vector<BlockKey>::iterator       block_it;
             int j;
 
             m_nodeStats->extHeadersReceivedBytes += m_bitcoinMessageHeader + m_countBytes + d["blocks"].Size()*m_headersSizeBytes;
@@ -1469,16 +1399,13 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
 
                 EventId              timeout;
-                std::ostringstream   stringStream;
-                std::string          blockHash;
-                std::string          parentBlockHash ;
+                BlockKey             blockHash(height, minerId);
+                BlockKey             parentBlockHash(parentHeight, parentMinerId);
 
                 m_nodeStats->extHeadersReceivedBytes += 1;//fullBlock
                 if (!d["blocks"][j]["fullBlock"].GetBool())
                     m_nodeStats->extHeadersReceivedBytes += d["blocks"][j]["availableChunks"].Size();
 
-                stringStream << height << "/" << minerId;
-                blockHash = stringStream.str();
                 Block newBlockHeaders(d["blocks"][j]["height"].GetInt(), d["blocks"][j]["minerId"].GetInt(), d["blocks"][j]["parentBlockMinerId"].GetInt(),
                                       d["blocks"][j]["size"].GetInt(), d["blocks"][j]["timeCreated"].GetDouble(),
                                       Simulator::Now ().GetSeconds (), InetSocketAddress::ConvertFrom(from).GetIpv4 ());
@@ -1490,13 +1417,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                 }
                 //PrintOnlyHeadersReceived();
 
-                stringStream.clear();
-                stringStream.str("");
-
-                stringStream << parentHeight << "/" << parentMinerId;
-                parentBlockHash = stringStream.str();
-
-                if(!m_blockchain.HasBlock(height, minerId) && !m_blockchain.IsOrphan(height, minerId) && !ReceivedButNotValidated(blockHash))
+                if(!m_blockchain.HasBlock(blockHash) && !m_blockchain.IsOrphan(blockHash) && !ReceivedButNotValidated(blockHash))
                 {
 /*                   NS_LOG_INFO("We have not received an INV for the block with height = " << d["blocks"][j]["height"].GetInt()
                                << " and minerId = " << d["blocks"][j]["minerId"].GetInt()); */
@@ -1555,14 +1476,13 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                                                                        m_queueChunks[blockHash].end(), candidateChunks[randomIndex]),
                                                            m_queueChunks[blockHash].end());
 
-                            std::ostringstream chunk;
-                            chunk << blockHash << "/" << candidateChunks[randomIndex];
-                            requestChunks.push_back(chunk.str());
+                            std::string chunk = blockHash.ToChunkString(candidateChunks[randomIndex]);
+                            requestChunks.push_back(chunk);
 
                             timeout = Simulator::Schedule (Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))),
-                                                           &BitcoinNode::ChunkTimeoutExpired, this, chunk.str());
+                                                           &BitcoinNode::ChunkTimeoutExpired, this, chunk);
 
-                            m_chunkTimeouts[chunk.str()] = timeout;
+                            m_chunkTimeouts[chunk] = timeout;
                             m_queueChunkPeers[blockHash].push_back(from);
                         }
                         else
@@ -1598,7 +1518,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                                                            << " has already been received\n");
                 }
 
-                if (!m_blockchain.HasBlock(parentHeight, parentMinerId) && !m_blockchain.IsOrphan(parentHeight, parentMinerId) && !ReceivedButNotValidated(parentBlockHash))
+                if (!m_blockchain.HasBlock(parentBlockHash) && !m_blockchain.IsOrphan(parentBlockHash) && !ReceivedButNotValidated(parentBlockHash))
                 {
                     NS_LOG_INFO("The Block with height = " << d["blocks"][j]["height"].GetInt()
                                                            << " and minerId = " << d["blocks"][j]["minerId"].GetInt()
@@ -1613,7 +1533,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                     {
                         NS_LOG_INFO("EXT_HEADERS: Bitcoin node " << GetNode ()->GetId ()
                                                                  << " has not requested parent block chunks from this peer yet");
-                        requestHeaders.push_back(parentBlockHash.c_str());
+                        requestHeaders.push_back(parentBlockHash);
                     }
                     else
                     {
@@ -1622,7 +1542,7 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                     }
 
                     if(m_protocolType == STANDARD_PROTOCOL ||
-                       (m_protocolType == SENDHEADERS && std::find(requestChunks.begin(), requestChunks.end(), parentBlockHash) == requestChunks.end()))
+                       (m_protocolType == SENDHEADERS && std::find(requestChunks.begin(), requestChunks.end(), parentBlockHash.ToString()) == requestChunks.end()))
                         m_queueInv[parentBlockHash].push_back(from);
 
                     //PrintQueueInv();
@@ -1650,7 +1570,8 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
 
                 for (block_it = requestHeaders.begin(); block_it < requestHeaders.end(); block_it++)
                 {
-                    value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
+                    std::string blockHash = block_it->ToString();
+                    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
                     array.PushBack(value, d.GetAllocator());
                 }
 
@@ -1676,23 +1597,8 @@ BitcoinNode::ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet,
                 for (auto chunk_it = requestChunks.begin(); chunk_it < requestChunks.end(); chunk_it++)
                 {
 
-                    std::string            invDelimiter = "/";
-                    std::string            chunkHash = *chunk_it;
-                    std::string            chunkHashHelp = chunkHash.substr(0);
-                    std::ostringstream     help;
-                    std::string            blockHash;
-                    size_t                 invPos = chunkHashHelp.find(invDelimiter);
-
-                    int height = atoi(chunkHashHelp.substr(0, invPos).c_str());
-
-                    chunkHashHelp.erase(0, invPos + invDelimiter.length());
-                    invPos = chunkHashHelp.find(invDelimiter);
-                    int minerId = atoi(chunkHashHelp.substr(0, invPos).c_str());
-
-                    chunkHashHelp.erase(0, invPos + invDelimiter.length());
-                    int chunkId = atoi(chunkHashHelp.substr(0).c_str());
-                    help << height << "/" << minerId;
-                    blockHash = help.str();
+                    int                    chunkId;
+                    BlockKey               blockHash = BlockKey::FromChunkString(*chunk_it, chunkId);
 
                     if (m_receivedChunks.find(blockHash) != m_receivedChunks.end())
                     {
@@ -1885,12 +1791,8 @@ BitcoinNode::ReceivedBlockMessage(std::string &blockInfo, Address &from)
 				
 
     EventId              timeout;
-    std::ostringstream   stringStream;  
-    std::string          blockHash;
-    std::string          parentBlockHash;
-				
-    stringStream << height << "/" << minerId;
-    blockHash = stringStream.str();
+    BlockKey             blockHash(height, minerId);
+    BlockKey             parentBlockHash(parentHeight, parentMinerId);
 
     if (m_onlyHeadersReceived.find(blockHash) != m_onlyHeadersReceived.end())
       m_onlyHeadersReceived.erase(blockHash);
@@ -1901,13 +1803,7 @@ BitcoinNode::ReceivedBlockMessage(std::string &blockInfo, Address &from)
     if (m_receivedChunks.find(blockHash) != m_receivedChunks.end())
       m_receivedChunks.erase (blockHash);
 	  
-    stringStream.clear();
-    stringStream.str("");
-				
-    stringStream << parentHeight << "/" << parentMinerId;
-    parentBlockHash = stringStream.str();
-				
-    if (!m_blockchain.HasBlock(parentHeight, parentMinerId) && !m_blockchain.IsOrphan(parentHeight, parentMinerId) 
+    if (!m_blockchain.HasBlock(parentBlockHash) && !m_blockchain.IsOrphan(parentBlockHash) 
         && !ReceivedButNotValidated(parentBlockHash) && !OnlyHeadersReceived(parentBlockHash))
     {				  
       NS_LOG_INFO("The Block with height = " << d["blocks"][j]["height"].GetInt() 
@@ -1923,6 +1819,7 @@ BitcoinNode::ReceivedBlockMessage(std::string &blockInfo, Address &from)
       Block newBlock (d["blocks"][j]["height"].GetInt(), d["blocks"][j]["minerId"].GetInt(), d["blocks"][j]["parentBlockMinerId"].GetInt(), 
                       d["blocks"][j]["size"].GetInt(), d["blocks"][j]["timeCreated"].GetDouble(), 
                       Simulator::Now ().GetSeconds (), InetSocketAddress::ConvertFrom(from).GetIpv4 ());
+      newBlock.Intern (false);
 
       ReceiveBlock (newBlock);
     }
@@ -1956,26 +1853,11 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
     int chunkId = d["chunks"][j]["chunk"].GetInt();
 
     EventId              timeout;
-    std::ostringstream   stringStream;  
-    std::string          blockHash;
-    std::string          chunkHash;
-    std::string          parentBlockHash;
+    BlockKey             blockHash(height, minerId);
+    BlockKey             parentBlockHash(parentHeight, parentMinerId);
+    std::string          chunkHash = blockHash.ToChunkString(chunkId);
     std::string          blockType;
     std::vector<int>     candidateChunks;
-
-    stringStream << height << "/" << minerId;
-    blockHash = stringStream.str();
-
-		
-    stringStream.clear();
-    stringStream.str("");
-    stringStream << parentHeight << "/" << parentMinerId;
-    parentBlockHash = stringStream.str();
-
-    stringStream.clear();
-    stringStream.str("");
-    stringStream << height << "/" << minerId << "/" << chunkId;
-    chunkHash = stringStream.str();
 				
     blockType = d["type"].GetString();
 
@@ -1992,7 +1874,7 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
     }
 
 	
-    if (!m_blockchain.HasBlock(height, minerId) && !m_blockchain.IsOrphan(height, minerId) && !ReceivedButNotValidated(blockHash))
+    if (!m_blockchain.HasBlock(blockHash) && !m_blockchain.IsOrphan(blockHash) && !ReceivedButNotValidated(blockHash))
     {
       auto it = std::find(m_queueChunkPeers[blockHash].begin(), m_queueChunkPeers[blockHash].end(), from);
       if(it !=  m_queueChunkPeers[blockHash].end())
@@ -2013,7 +1895,7 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
 				
         if (m_receivedChunks[blockHash].size() == ceil(d["chunks"][j]["size"].GetInt()/static_cast<double>(m_chunkSize)))
         {
-          if (!m_blockchain.HasBlock(parentHeight, parentMinerId) && !m_blockchain.IsOrphan(parentHeight, parentMinerId)
+          if (!m_blockchain.HasBlock(parentBlockHash) && !m_blockchain.IsOrphan(parentBlockHash)
               && !ReceivedButNotValidated(parentBlockHash) && !OnlyHeadersReceived(parentBlockHash))
           {				  
             NS_LOG_INFO("The Block with height = " << d["chunks"][j]["height"].GetInt() 
@@ -2029,6 +1911,7 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
             Block newBlock (d["chunks"][j]["height"].GetInt(), d["chunks"][j]["minerId"].GetInt(), d["chunks"][j]["parentBlockMinerId"].GetInt(), 
                             d["chunks"][j]["size"].GetInt(), d["chunks"][j]["timeCreated"].GetDouble(), 
                             Simulator::Now ().GetSeconds (), InetSocketAddress::ConvertFrom(from).GetIpv4 ());
+            newBlock.Intern (false);
 
             ReceivedLastChunk (newBlock);
           }
@@ -2077,11 +1960,10 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
                                                        m_queueChunks[blockHash].end(), candidateChunks[randomIndex]),
                                                        m_queueChunks[blockHash].end());
 																		  
-            std::ostringstream chunk;
-            chunk << blockHash << "/" << candidateChunks[randomIndex];
+            std::string chunk = blockHash.ToChunkString(candidateChunks[randomIndex]);
 
             if (d["chunks"][j]["requestChunks"].Size() == 0)
-              getDataMessages.push_back(chunk.str());
+              getDataMessages.push_back(chunk);
             else
             {
               for (int ii = 0; ii < d["chunks"][j]["requestChunks"].Size(); ii++)
@@ -2095,9 +1977,9 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
             }
 					  
             timeout = Simulator::Schedule (Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(d["chunks"][j]["size"].GetInt()/static_cast<double>(m_chunkSize))),
-                                                   &BitcoinNode::ChunkTimeoutExpired, this, chunk.str());
+                                                   &BitcoinNode::ChunkTimeoutExpired, this, chunk);
 													 
-            m_chunkTimeouts[chunk.str()] = timeout;
+            m_chunkTimeouts[chunk] = timeout;
             m_queueChunkPeers[blockHash].push_back(from);
           }
           else
@@ -2151,23 +2033,8 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
     {
       NS_LOG_INFO("In getDataMessages: " << *chunk_it);
 	  
-      std::string            invDelimiter = "/";
-      std::string            chunkHash = *chunk_it;
-      std::string            chunkHashHelp = chunkHash.substr(0);
-      std::ostringstream     help;
-      std::string            blockHash;
-      size_t                 invPos = chunkHashHelp.find(invDelimiter);
-				  
-      int height = atoi(chunkHashHelp.substr(0, invPos).c_str());
-				  
-      chunkHashHelp.erase(0, invPos + invDelimiter.length());
-      invPos = chunkHashHelp.find(invDelimiter);
-      int minerId = atoi(chunkHashHelp.substr(0, invPos).c_str());
-				  
-      chunkHashHelp.erase(0, invPos + invDelimiter.length());
-      int chunkId = atoi(chunkHashHelp.substr(0).c_str());
-      help << height << "/" << minerId;
-      blockHash = help.str();
+      int                    chunkId;
+      BlockKey               blockHash = BlockKey::FromChunkString(*chunk_it, chunkId);
 				
       if (m_receivedChunks.find(blockHash) != m_receivedChunks.end())
       {
@@ -2206,16 +2073,7 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
     {
       NS_LOG_INFO("In chunkMessages: " << chunk.first);
 
-      std::string            invDelimiter = "/";
-      std::string            chunkHash;
-      std::string            blockHash;
-      std::ostringstream     stringStream;				  
-
-      stringStream << chunk.first.GetBlockHeight() << "/" << chunk.first.GetMinerId();
-      blockHash = stringStream.str();
-      stringStream.clear();
-      stringStream << chunk.first.GetBlockHeight() << "/" << chunk.first.GetMinerId() << "/" << chunk.first.GetChunkId();
-      chunkHash = stringStream.str();
+      BlockKey               blockHash = chunk.first.GetBlockKey();
 
       for (auto requestedChunk_it = chunk.second.begin(); requestedChunk_it != chunk.second.end(); requestedChunk_it++)
       {
@@ -2250,8 +2108,8 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
         }
         chunkInfo.AddMember("requestChunks", requestChunks, d.GetAllocator ());
 		
-        if (m_blockchain.HasBlock(chunk.first.GetBlockHeight (), chunk.first.GetMinerId ()) 
-            || m_blockchain.IsOrphan(chunk.first.GetBlockHeight (), chunk.first.GetMinerId ())
+        if (m_blockchain.HasBlock(blockHash) 
+            || m_blockchain.IsOrphan(blockHash)
             || ReceivedButNotValidated(blockHash))
         {
           value = true;							
@@ -2338,11 +2196,7 @@ BitcoinNode::ReceiveBlock(const Block &newBlock)
   NS_LOG_INFO ("ReceiveBlock: At time " << Simulator::Now ().GetSeconds ()
                 << "s bitcoin node " << GetNode ()->GetId () << " received " << newBlock);
 
-  std::ostringstream   stringStream;  
-  std::string          blockHash = stringStream.str();
-				
-  stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
-  blockHash = stringStream.str();
+  BlockKey             blockHash = newBlock.GetBlockKey();
   
   if (m_blockchain.HasBlock(newBlock) || m_blockchain.IsOrphan(newBlock) || ReceivedButNotValidated(blockHash))
   {
@@ -2385,11 +2239,7 @@ BitcoinNode::ReceivedLastChunk(const Block &newBlock)
                 << "s bitcoin node " << GetNode ()->GetId () 
                 << " received the last chunk of block " << newBlock);
 				
-  std::ostringstream   stringStream;  
-  std::string          blockHash = stringStream.str();
-				
-  stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
-  blockHash = stringStream.str();
+  BlockKey             blockHash = newBlock.GetBlockKey();
   
   if (m_blockchain.HasBlock(newBlock) || m_blockchain.IsOrphan(newBlock) || ReceivedButNotValidated(blockHash))
   {
@@ -2452,7 +2302,13 @@ BitcoinNode::ValidateBlock(const Block &newBlock)
   
   const Block *parent = m_blockchain.GetParent(newBlock);
   
-  if (parent == nullptr)
+  if (parent == nullptr && newBlock.GetBlockHeight() - 1 < m_blockchain.GetPrunedHeight())
+  {
+    NS_LOG_INFO("ValidateBlock: Block " << newBlock << " is below the finalized checkpoint, its parent was pruned\n");
+
+    RemoveReceivedButNotValidated(newBlock.GetBlockKey());
+  }
+  else if (parent == nullptr)
   {
     NS_LOG_INFO("ValidateBlock: Block " << newBlock << " is an orphan\n"); 
 	 
@@ -2483,15 +2339,7 @@ BitcoinNode::AfterBlockValidation(const Block &newBlock)
 {
   NS_LOG_FUNCTION (this);
 
-  int height = newBlock.GetBlockHeight();
-  int minerId = newBlock.GetMinerId();
-  std::ostringstream   stringStream;  
-  std::string          blockHash = stringStream.str();
-				
-  stringStream << height << "/" << minerId;
-  blockHash = stringStream.str();
-  
-  RemoveReceivedButNotValidated(blockHash);
+  RemoveReceivedButNotValidated(newBlock.GetBlockKey());
   
   NS_LOG_INFO ("AfterBlockValidation: At time " << Simulator::Now ().GetSeconds ()
                << "s bitcoin node " << GetNode ()->GetId () 
@@ -2586,8 +2434,7 @@ BitcoinNode::AdvertiseNewBlock (const Block &newBlock)
   rapidjson::Document d;
   rapidjson::Value value;
   rapidjson::Value array(rapidjson::kArrayType);  
-  std::ostringstream stringStream;  
-  std::string blockHash = stringStream.str();
+  std::string blockHash;
   d.SetObject();
   
   value.SetString("block");
@@ -2598,8 +2445,7 @@ BitcoinNode::AdvertiseNewBlock (const Block &newBlock)
     value = INV;
     d.AddMember("message", value, d.GetAllocator());
 
-    stringStream << newBlock.GetBlockHeight () << "/" << newBlock.GetMinerId ();
-    blockHash = stringStream.str();
+    blockHash = newBlock.GetBlockHash ();
     value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
     array.PushBack(value, d.GetAllocator());
     d.AddMember("inv", array, d.GetAllocator());
@@ -2633,19 +2479,15 @@ BitcoinNode::AdvertiseNewBlock (const Block &newBlock)
     d.AddMember("blocks", array, d.GetAllocator());      
   }	
 
-  // Stringify the DOM
-  rapidjson::StringBuffer packetInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-  d.Accept(writer);
+  // Encode the DOM
+  std::string packetInfo;
+  m_codec->EncodeFrame(d, packetInfo);
   
   for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
   {
     if ( *i != newBlock.GetReceivedFromIpv4 () )
     {
-      const uint8_t delimiter[] = "#";
-
-      m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-	  m_peersSockets[*i]->Send (delimiter, 1, 0);
+      SendFrame (m_peersSockets[*i], packetInfo);
 	  
       if (m_protocolType == STANDARD_PROTOCOL)
         m_nodeStats->invSentBytes += m_bitcoinMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
@@ -2669,8 +2511,7 @@ BitcoinNode::AdvertiseFullBlock (const Block &newBlock)
   rapidjson::Value value;
   rapidjson::Value array(rapidjson::kArrayType);  
   rapidjson::Value blockInfo(rapidjson::kObjectType);
-  std::ostringstream stringStream;  
-  std::string blockHash = stringStream.str();
+  std::string blockHash;
   d.SetObject();
   
   value.SetString("block");
@@ -2681,8 +2522,7 @@ BitcoinNode::AdvertiseFullBlock (const Block &newBlock)
     value = EXT_INV;
     d.AddMember("message", value, d.GetAllocator());
   
-    stringStream << newBlock.GetBlockHeight () << "/" << newBlock.GetMinerId ();
-    blockHash = stringStream.str();
+    blockHash = newBlock.GetBlockHash ();
     value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
     blockInfo.AddMember("hash", value, d.GetAllocator ());
 
@@ -2735,17 +2575,13 @@ BitcoinNode::AdvertiseFullBlock (const Block &newBlock)
     d.AddMember("blocks", array, d.GetAllocator());      
   }	
 
-  // Stringify the DOM
-  rapidjson::StringBuffer packetInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-  d.Accept(writer);
+  // Encode the DOM
+  std::string packetInfo;
+  m_codec->EncodeFrame(d, packetInfo);
   
   for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
   {
-    const uint8_t delimiter[] = "#";
-
-    m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-    m_peersSockets[*i]->Send (delimiter, 1, 0);
+    SendFrame (m_peersSockets[*i], packetInfo);
 	  
     if (m_protocolType == STANDARD_PROTOCOL)
     {
@@ -2785,13 +2621,11 @@ BitcoinNode::AdvertiseFirstChunk (const Block &newBlock)
   rapidjson::Value array(rapidjson::kArrayType); 
   rapidjson::Value chunkArray(rapidjson::kArrayType); 
   rapidjson::Value blockInfo(rapidjson::kObjectType);  
-  std::ostringstream stringStream;  
-  std::string blockHash;
+  BlockKey blockKey = newBlock.GetBlockKey ();
+  std::string blockHash = blockKey.ToString ();
   int noChunks = ceil(newBlock.GetBlockSizeBytes ()/static_cast<double>(m_chunkSize));
 
   d.SetObject();
-  stringStream << newBlock.GetBlockHeight () << "/" << newBlock.GetMinerId ();
-  blockHash = stringStream.str();
 
   value.SetString("block");
   d.AddMember("type", value, d.GetAllocator());
@@ -2808,7 +2642,7 @@ BitcoinNode::AdvertiseFirstChunk (const Block &newBlock)
     blockInfo.AddMember("size", value, d.GetAllocator ());
 		  
 					
-    if (m_receivedChunks[blockHash].size() == noChunks)
+    if ((int) m_receivedChunks[blockKey].size() == noChunks)
     {
       value = true;
       blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
@@ -2818,7 +2652,7 @@ BitcoinNode::AdvertiseFirstChunk (const Block &newBlock)
       value = false;							
       blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
 
-      for (auto &chunk : m_receivedChunks[blockHash])
+      for (auto &chunk : m_receivedChunks[blockKey])
       {
         value = chunk;
         chunkArray.PushBack(value, d.GetAllocator());
@@ -2861,11 +2695,11 @@ BitcoinNode::AdvertiseFirstChunk (const Block &newBlock)
       value = EXT_HEADERS;
       d.AddMember("message", value, d.GetAllocator());
 		  
-      if (m_receivedChunks[blockHash].size() == noChunks)
+      if ((int) m_receivedChunks[blockKey].size() == noChunks)
       {
         value = true;
         blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
-        NS_LOG_DEBUG("1 " << m_receivedChunks[blockHash].size());
+        NS_LOG_DEBUG("1 " << m_receivedChunks[blockKey].size());
       }
       else
       {
@@ -2874,7 +2708,7 @@ BitcoinNode::AdvertiseFirstChunk (const Block &newBlock)
         value = false;
         blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
 					  
-        for (auto &c : m_receivedChunks[blockHash])
+        for (auto &c : m_receivedChunks[blockKey])
         {
           value = c;
           availableChunks.PushBack(value, d.GetAllocator());
@@ -2887,19 +2721,15 @@ BitcoinNode::AdvertiseFirstChunk (const Block &newBlock)
     d.AddMember("blocks", array, d.GetAllocator());      
   }	
 
-  // Stringify the DOM
-  rapidjson::StringBuffer packetInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-  d.Accept(writer);
+  // Encode the DOM
+  std::string packetInfo;
+  m_codec->EncodeFrame(d, packetInfo);
   
   for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
   {
     if ( *i != newBlock.GetReceivedFromIpv4 () )
     {
-      const uint8_t delimiter[] = "#";
-
-      m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-      m_peersSockets[*i]->Send (delimiter, 1, 0);
+      SendFrame (m_peersSockets[*i], packetInfo);
 	  
       if (m_protocolType == STANDARD_PROTOCOL)
       {
@@ -2931,22 +2761,80 @@ BitcoinNode::AdvertiseFirstChunk (const Block &newBlock)
 
 
 void
-BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, rapidjson::Document &d, Ptr<Socket> outgoingSocket, std::string delimeter)
+BitcoinNode::SendFramedMessage (Ptr<Socket> outgoingSocket, const rapidjson::Value &d)
 {
   NS_LOG_FUNCTION (this);
-  
-  rapidjson::StringBuffer buffer;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-				
+
+  std::string frame;
+  m_codec->EncodeFrame(d, frame);
+  SendFrame (outgoingSocket, frame);
+}
+
+
+void
+BitcoinNode::SendFrame (Ptr<Socket> outgoingSocket, const std::string &frame)
+{
+  outgoingSocket->Send (reinterpret_cast<const uint8_t*>(frame.data()), frame.size(), 0);
+}
+
+
+Ptr<Packet>
+BitcoinNode::CreateSharedFrame (enum Messages responseMessage, rapidjson::Document &d)
+{
+  NS_LOG_FUNCTION (this);
+
+  std::string frame;
+
+  d["message"].SetInt(responseMessage);
+  m_codec->EncodeFrame(d, frame);
+  NS_LOG_INFO ("Node " << GetNode ()->GetId () << " encoded a shared " << getMessageName(responseMessage)
+               << " message of " << frame.size() << " bytes: " << RenderMessage(d));
+
+  return Create<Packet> (reinterpret_cast<const uint8_t*>(frame.data()), frame.size());
+}
+
+
+void
+BitcoinNode::SendSharedFrame (enum Messages responseMessage, Ptr<Packet> frame, Ptr<Socket> outgoingSocket)
+{
+  NS_LOG_FUNCTION (this);
+  NS_LOG_INFO ("Node " << GetNode ()->GetId () << " sent a shared " << getMessageName(responseMessage) << " message");
+
+  /**
+   * The copy shares the payload with the original packet (copy on write),
+   * it only protects the shared frame from the tags added by the socket.
+   */
+  outgoingSocket->Send (frame->Copy ());
+}
+
+
+void
+BitcoinNode::ChargeCpuTime (double seconds)
+{
+  double now = Simulator::Now ().GetSeconds ();
+  m_cpuBusyUntil = std::max (m_cpuBusyUntil, now) + seconds;
+}
+
+
+double
+BitcoinNode::GetCpuDelay (void) const
+{
+  return std::max (0.0, m_cpuBusyUntil - Simulator::Now ().GetSeconds ());
+}
+
+
+void
+BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, rapidjson::Document &d, Ptr<Socket> outgoingSocket)
+{
+  NS_LOG_FUNCTION (this);
+
   d["message"].SetInt(responseMessage);
-  d.Accept(writer);
   NS_LOG_INFO ("Node " << GetNode ()->GetId () << " got a "
                << getMessageName(receivedMessage) << " message"
                << " and sent a " << getMessageName(responseMessage)
-               << " message: " << buffer.GetString());
+               << " message: " << RenderMessage(d));
 
-  outgoingSocket->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-  outgoingSocket->Send (reinterpret_cast<const uint8_t*>(delimeter.c_str()), delimeter.length(), 0);
+  SendFramedMessage (outgoingSocket, d);
 
   switch (d["message"].GetInt()) 
   {
@@ -3043,18 +2931,12 @@ void
 BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, rapidjson::Document &d, Address &outgoingAddress)
 {
   NS_LOG_FUNCTION (this);
-  
-  const uint8_t delimiter[] = "#";
 
-  rapidjson::StringBuffer buffer;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-				
   d["message"].SetInt(responseMessage);
-  d.Accept(writer);
   NS_LOG_INFO ("Node " << GetNode ()->GetId () << " got a " 
                << getMessageName(receivedMessage) << " message" 
                << " and sent a " << getMessageName(responseMessage) 
-               << " message: " << buffer.GetString());
+               << " message: " << RenderMessage(d));
 			
   Ipv4Address outgoingIpv4Address = InetSocketAddress::ConvertFrom(outgoingAddress).GetIpv4 ();
   std::map<Ipv4Address, Ptr<Socket>>::iterator it = m_peersSockets.find(outgoingIpv4Address);
@@ -3065,8 +2947,7 @@ BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseM
     m_peersSockets[outgoingIpv4Address]->Connect (InetSocketAddress (outgoingIpv4Address, m_bitcoinPort));
   }
   
-  m_peersSockets[outgoingIpv4Address]->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-  m_peersSockets[outgoingIpv4Address]->Send (delimiter, 1, 0);	
+  SendFramedMessage (m_peersSockets[outgoingIpv4Address], d);
 
   switch (d["message"].GetInt()) 
   {
@@ -3163,19 +3044,14 @@ BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseM
 {
   NS_LOG_FUNCTION (this);
   
-  const uint8_t delimiter[] = "#";
   rapidjson::Document d;
-  
-  rapidjson::StringBuffer buffer;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 
   d.Parse(packet.c_str());  
   d["message"].SetInt(responseMessage);
-  d.Accept(writer);
   NS_LOG_INFO ("Node " << GetNode ()->GetId () << " got a " 
                << getMessageName(receivedMessage) << " message" 
                << " and sent a " << getMessageName(responseMessage) 
-               << " message: " << buffer.GetString());
+               << " message: " << RenderMessage(d));
 			
   Ipv4Address outgoingIpv4Address = InetSocketAddress::ConvertFrom(outgoingAddress).GetIpv4 ();
   std::map<Ipv4Address, Ptr<Socket>>::iterator it = m_peersSockets.find(outgoingIpv4Address);
@@ -3186,8 +3062,7 @@ BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseM
     m_peersSockets[outgoingIpv4Address]->Connect (InetSocketAddress (outgoingIpv4Address, m_bitcoinPort));
   }
   
-  m_peersSockets[outgoingIpv4Address]->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-  m_peersSockets[outgoingIpv4Address]->Send (delimiter, 1, 0);	
+  SendFramedMessage (m_peersSockets[outgoingIpv4Address], d);
 
   
   switch (d["message"].GetInt()) 
@@ -3417,16 +3292,10 @@ BitcoinNode::PrintOnlyHeadersReceived()
 
 
 void
-BitcoinNode::InvTimeoutExpired(std::string blockHash)
+BitcoinNode::InvTimeoutExpired(BlockKey blockHash)
 {
   NS_LOG_FUNCTION (this);
 
-  std::string   invDelimiter = "/";
-  size_t        invPos = blockHash.find(invDelimiter);
-
-  int height = atoi(blockHash.substr(0, invPos).c_str());
-  int minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
-  
   NS_LOG_INFO ("Node " << GetNode ()->GetId () << ": At time "  << Simulator::Now ().GetSeconds ()
                 << " the timeout for block " << blockHash << " expired");
   
@@ -3440,7 +3309,7 @@ BitcoinNode::InvTimeoutExpired(std::string blockHash)
   //PrintQueueInv();
   //PrintInvTimeouts();
   
-  if (!m_queueInv[blockHash].empty() && !m_blockchain.HasBlock(height, minerId) && !m_blockchain.IsOrphan(height, minerId) && !ReceivedButNotValidated(blockHash))
+  if (!m_queueInv[blockHash].empty() && !m_blockchain.HasBlock(blockHash) && !m_blockchain.IsOrphan(blockHash) && !ReceivedButNotValidated(blockHash))
   {
     rapidjson::Document   d; 
     EventId               timeout;
@@ -3454,7 +3323,8 @@ BitcoinNode::InvTimeoutExpired(std::string blockHash)
     value.SetString("block");
     d.AddMember("type", value, d.GetAllocator());
 	
-    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
+    std::string hash = blockHash.ToString();
+    value.SetString(hash.c_str(), hash.size(), d.GetAllocator());
     array.PushBack(value, d.GetAllocator());
     d.AddMember("blocks", array, d.GetAllocator());
 
@@ -3482,23 +3352,8 @@ BitcoinNode::ChunkTimeoutExpired(std::string chunk)
 {
   NS_LOG_FUNCTION (this);
 
-  std::string            invDelimiter = "/";
-  std::string            chunkHashHelp = chunk.substr(0);
-  std::ostringstream     help;
-  std::string            blockHash;
-  size_t                 invPos = chunkHashHelp.find(invDelimiter);
-  
-  int height = atoi(chunkHashHelp.substr(0, invPos).c_str());
-				  
-  chunkHashHelp.erase(0, invPos + invDelimiter.length());
-  invPos = chunkHashHelp.find(invDelimiter);
-  int minerId = atoi(chunkHashHelp.substr(0, invPos).c_str());
-				  
-  chunkHashHelp.erase(0, invPos + invDelimiter.length());
-  int chunkId = atoi(chunkHashHelp.substr(0).c_str());
-  
-  help << height << "/" << minerId;
-  blockHash = help.str();
+  int                    chunkId;
+  BlockKey               blockHash = BlockKey::FromChunkString(chunk, chunkId);
   
   NS_LOG_WARN ("Node " << GetNode ()->GetId () << ": At time "  << Simulator::Now ().GetSeconds ()
                 << " the timeout for chunk " << chunk << " expired");
@@ -3519,7 +3374,7 @@ BitcoinNode::ChunkTimeoutExpired(std::string chunk)
 
 
 bool 
-BitcoinNode::ReceivedButNotValidated (std::string blockHash)
+BitcoinNode::ReceivedButNotValidated (const BlockKey &blockHash)
 {
   NS_LOG_FUNCTION (this);
   
@@ -3531,7 +3386,7 @@ BitcoinNode::ReceivedButNotValidated (std::string blockHash)
 
 
 void 
-BitcoinNode::RemoveReceivedButNotValidated (std::string blockHash)
+BitcoinNode::RemoveReceivedButNotValidated (const BlockKey &blockHash)
 {
   NS_LOG_FUNCTION (this);
   
@@ -3548,7 +3403,7 @@ BitcoinNode::RemoveReceivedButNotValidated (std::string blockHash)
 
 
 bool 
-BitcoinNode::OnlyHeadersReceived (std::string blockHash)
+BitcoinNode::OnlyHeadersReceived (const BlockKey &blockHash)
 {
   NS_LOG_FUNCTION (this);
   
@@ -3560,7 +3415,7 @@ BitcoinNode::OnlyHeadersReceived (std::string blockHash)
 
 
 bool 
-BitcoinNode::HasChunk (std::string blockHash, int chunk)
+BitcoinNode::HasChunk (const BlockKey &blockHash, int chunk)
 {
   NS_LOG_FUNCTION (this);
 
@@ -12,6 +12,8 @@
 #include "ns3/traced-callback.h"
 #include "ns3/address.h"
 #include "bitcoin.h"
+#include "message-codec.h"
+#include "stream-framer.h"
 #include "ns3/boolean.h"
 #include "../../rapidjson/document.h"
 #include "../../rapidjson/writer.h"
@@ -100,12 +102,12 @@ protected:
 
    /**
    * processing of parsed packet received in handle read
-   * @param parsedPacket string containing message from packet
+   * @param parsedPacket view of the encoded message, valid only during the call
    * @param packet packet containing message
    * @param from senders address
    * @param newBlockReceiveTime simulation time of msg receive
    */
-  void ProcessParsedPacket (std::string parsedPacket, Ptr<Packet> packet, Address from, double newBlockReceiveTime);
+  void ProcessParsedPacket (const MessageView &parsedPacket, Ptr<Packet> packet, Address from, double newBlockReceiveTime);
 
   /**
    * \brief Handle a document received by the application with unknown type number
@@ -225,11 +227,10 @@ protected:
    * \param receivedMessage the type of the received message
    * \param responseMessage the type of the response message
    * \param d the rapidjson document containing the info of the outgoing message
-   * \param delimeter delimeter used between messages
    * \param outgoingSocket the socket of the peer
    */
   virtual void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, rapidjson::Document &d,
-          Ptr<Socket> outgoingSocket, std::string delimeter="#");
+          Ptr<Socket> outgoingSocket);
   
   /**
    * \brief Sends a message to a peer
@@ -249,6 +250,47 @@ protected:
    */
   void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, std::string packet, Address &outgoingAddress);
 
+  /**
+   * \brief Encodes the message with the codec of the node and sends it to a peer as one frame
+   * \param outgoingSocket the socket of the peer
+   * \param d the rapidjson document containing the info of the outgoing message
+   */
+  void SendFramedMessage (Ptr<Socket> outgoingSocket, const rapidjson::Value &d);
+
+  /**
+   * \brief Sends an already encoded frame to a peer
+   * \param outgoingSocket the socket of the peer
+   * \param frame the frame created by MessageCodec::EncodeFrame
+   */
+  void SendFrame (Ptr<Socket> outgoingSocket, const std::string &frame);
+
+  /**
+   * \brief Encodes the message only once into a reference counted frame, which can be sent to many peers
+   * \param responseMessage the type of the message
+   * \param d the rapidjson document containing the info of the outgoing message
+   * \return the frame to be passed to SendSharedFrame
+   */
+  Ptr<Packet> CreateSharedFrame (enum Messages responseMessage, rapidjson::Document &d);
+
+  /**
+   * \brief Sends the frame created by CreateSharedFrame to a peer without encoding it again
+   * \param responseMessage the type of the message, used only for logging
+   * \param frame the shared frame
+   * \param outgoingSocket the socket of the peer
+   */
+  void SendSharedFrame (enum Messages responseMessage, Ptr<Packet> frame, Ptr<Socket> outgoingSocket);
+
+  /**
+   * \brief Occupies the CPU of the node by an operation (e.g. VRF verification), the operations are processed one by one
+   * \param seconds the CPU time of the operation
+   */
+  void ChargeCpuTime (double seconds);
+
+  /**
+   * \return the time (s) until the CPU finishes the charged operations, messages advertised now are delayed by it
+   */
+  double GetCpuDelay (void) const;
+
   /**
    * \brief Print m_queueInv to stdout
    */
@@ -288,7 +330,7 @@ protected:
    * \brief Called when a timeout for a block expires
    * \param blockHash the block hash for which the timeout expired
    */
-  void InvTimeoutExpired (std::string blockHash);
+  void InvTimeoutExpired (BlockKey blockHash);
   
   /**
    * \brief Called when a timeout for a chunk expires
@@ -301,27 +343,27 @@ protected:
    * \param blockHash the block hash 
    * \return true if the block has been received but not validated yet, false otherwise
    */
-  bool ReceivedButNotValidated (std::string blockHash);
+  bool ReceivedButNotValidated (const BlockKey &blockHash);
   
   /**
    * \brief Removes a block from m_receivedNotValidated
    * \param blockHash the block hash 
    */
-  void RemoveReceivedButNotValidated (std::string blockHash);
+  void RemoveReceivedButNotValidated (const BlockKey &blockHash);
 
   /**
    * \brief Checks if the node has received only the headers of a particular block (if it is included in m_onlyHeadersReceived)
    * \param blockHash the block hash 
    * \return true if only the block headers have been received, false otherwise
    */
-  bool OnlyHeadersReceived (std::string blockHash);
+  bool OnlyHeadersReceived (const BlockKey &blockHash);
   
   /**
    * \brief Checks if the node has received a particular chunk of a specific block
    * \param blockHash the block hash 
    * \param blockHash the chunk id
    */
-  bool HasChunk (std::string blockHash, int chunk);
+  bool HasChunk (const BlockKey &blockHash, int chunk);
 
   /**
    * \brief Removes the fist element from m_sendBlockTimes, when a block is sent
@@ -364,6 +406,10 @@ protected:
   bool            m_blockTorrent;                     //!< True if the blockTorrent mechanism is used, False otherwise
   uint32_t        m_chunkSize;                        //!< The size of the chunk in Bytes, when blockTorrent is used
   bool            m_spv;                              //!< Simplified Payment Verification. Used only in conjuction with blockTorrent
+  uint32_t        m_maxOrphans;                       //!< The maximum number of orphan blocks, 0 for unlimited
+  Time            m_maxOrphanAge;                     //!< The maximum time an orphan block is kept, 0 for unlimited
+  bool            m_pruneFinalized;                   //!< True if the blocks below the finalized checkpoints are pruned
+  double          m_cpuBusyUntil;                     //!< The time (s) when the CPU finishes the charged operations
 
   enum Cryptocurrency       m_cryptocurrency;
   
@@ -371,15 +417,16 @@ protected:
   std::map<Ipv4Address, double>                       m_peersDownloadSpeeds;            //!< The peersDownloadSpeeds of channels
   std::map<Ipv4Address, double>                       m_peersUploadSpeeds;              //!< The peersUploadSpeeds of channels
   std::map<Ipv4Address, Ptr<Socket>>                  m_peersSockets;                   //!< The sockets of peers
-  std::map<std::string, std::vector<Address>>         m_queueInv;                       //!< map holding the addresses of nodes which sent an INV for a particular block
-  std::map<std::string, std::vector<Address>>         m_queueChunkPeers;                //!< map holding the addresses of nodes from which we are waiting for a CHUNK, key = block_hash
-  std::map<std::string, std::vector<int>>             m_queueChunks;                    //!< map holding the chunks of the blocks which we have not requested yet, key = block_hash
-  std::map<std::string, std::vector<int>>             m_receivedChunks;                 //!< map holding the chunks of the blocks which we are currently downloading, key = block_hash
-  std::map<std::string, EventId>                      m_invTimeouts;                    //!< map holding the event timeouts of inv messages
-  std::map<std::string, EventId>                      m_chunkTimeouts;                  //!< map holding the event timeouts of chunk messages
-  std::map<Address, std::string>                      m_bufferedData;                   //!< map holding the buffered data from previous handleRead events
-  std::map<std::string, Block>                        m_receivedNotValidated;           //!< vector holding the received but not yet validated blocks
-  std::map<std::string, Block>                        m_onlyHeadersReceived;            //!< vector holding the blocks that we know but not received
+  BlockKeyMap<std::vector<Address>>                   m_queueInv;                       //!< map holding the addresses of nodes which sent an INV for a particular block
+  BlockKeyMap<std::vector<Address>>                   m_queueChunkPeers;                //!< map holding the addresses of nodes from which we are waiting for a CHUNK, key = block_hash
+  BlockKeyMap<std::vector<int>>                       m_queueChunks;                    //!< map holding the chunks of the blocks which we have not requested yet, key = block_hash
+  BlockKeyMap<std::vector<int>>                       m_receivedChunks;                 //!< map holding the chunks of the blocks which we are currently downloading, key = block_hash
+  BlockKeyMap<EventId>                                m_invTimeouts;                    //!< map holding the event timeouts of inv messages
+  std::map<std::string, EventId>                      m_chunkTimeouts;                  //!< map holding the event timeouts of chunk messages, key = chunk hash
+  std::map<Address, StreamFramer>                     m_streamFramers;                  //!< map holding the framers of the data received from the peers
+  const MessageCodec                                  *m_codec;                         //!< codec used to encode/decode the messages on the wire
+  BlockKeyMap<Block>                                  m_receivedNotValidated;           //!< vector holding the received but not yet validated blocks
+  BlockKeyMap<Block>                                  m_onlyHeadersReceived;            //!< vector holding the blocks that we know but not received
   nodeStatistics                                     *m_nodeStats;                      //!< struct holding the node stats
   std::vector<double>                                 m_sendBlockTimes;                 //!< contains the times of the next sendBlock events
   std::vector<double>                                 m_sendCompressedBlockTimes;       //!< contains the times of the next sendBlock events
@@ -215,12 +215,7 @@ BitcoinSelfishMiner::MineBlock (void)
   int minerId = GetNode ()->GetId ();
   int parentBlockMinerId = m_attackerTopBlock.GetMinerId();
   double currentTime = Simulator::Now ().GetSeconds ();
-  std::ostringstream stringStream;  
-  std::string blockHash;
-
-  
-  stringStream << height << "/" << minerId;
-  blockHash = stringStream.str();
+  std::string blockHash = BlockKey(height, minerId).ToString();
 
 
 /*   //For attacks
@@ -428,11 +423,7 @@ BitcoinSelfishMiner::ReceiveBlock(const Block &newBlock)
   NS_LOG_INFO ("BitcoinSelfishMiner ReceiveBlock: At time " << Simulator::Now ().GetSeconds ()
                 << "s bitcoin node " << GetNode ()->GetId () << " received " << newBlock);
 
-  std::ostringstream   stringStream;  
-  std::string          blockHash = stringStream.str();
-				
-  stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
-  blockHash = stringStream.str();
+  BlockKey             blockHash = newBlock.GetBlockKey();
   
   if (m_blockchain.HasBlock(newBlock) || m_blockchain.IsOrphan(newBlock) || ReceivedButNotValidated(blockHash))
   {
@@ -596,11 +587,7 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
   		  
         for(auto it = blocks.begin(); it != blocks.end(); it++)
         {
-          std::ostringstream   stringStream;  
-          std::string          blockHash = stringStream.str();
-				
-          stringStream << it->GetBlockHeight() << "/" << it->GetMinerId();
-          blockHash = stringStream.str();
+          std::string          blockHash = it->GetBlockHash();
           value.SetString(blockHash.c_str(), blockHash.size(), inv.GetAllocator());
           array.PushBack(value, inv.GetAllocator());
         }
@@ -696,11 +683,7 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
 		  
         for(auto it = blocks.begin(); it != blocks.end(); it++)
         {
-          std::ostringstream   stringStream;  
-          std::string          blockHash = stringStream.str();
-				
-          stringStream << it->GetBlockHeight() << "/" << it->GetMinerId();
-          blockHash = stringStream.str();
+          std::string          blockHash = it->GetBlockHash();
           value.SetString(blockHash.c_str(), blockHash.size(), inv.GetAllocator());
           invArray.PushBack(value, inv.GetAllocator());
         }
@@ -863,20 +846,20 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
   rapidjson::StringBuffer blockInfo;
   rapidjson::Writer<rapidjson::StringBuffer> blockWriter(blockInfo);
   block.Accept(blockWriter);
+
+  std::string invFrame;
+  m_codec->EncodeFrame(inv, invFrame);
   
   int count = 0;
   
   for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i, ++count)
   {
-    
-    const uint8_t delimiter[] = "#";
 
     switch(m_blockBroadcastType)				  
     {
       case STANDARD:
       {
-        m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
-        m_peersSockets[*i]->Send (delimiter, 1, 0);
+        SendFrame (m_peersSockets[*i], invFrame);
 		
         if (m_protocolType == STANDARD_PROTOCOL && !m_blockTorrent)
           m_nodeStats->invSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
@@ -995,8 +978,7 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
         }
         else
         {	    
-          m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
-          m_peersSockets[*i]->Send (delimiter, 1, 0);
+          SendFrame (m_peersSockets[*i], invFrame);
 	  
           if (m_protocolType == STANDARD_PROTOCOL && !m_blockTorrent)
             m_nodeStats->invSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
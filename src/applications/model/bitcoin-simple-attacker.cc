@@ -276,19 +276,15 @@ BitcoinSimpleAttacker::MineBlock (void)
 				  
   m_blockchain.AddBlock(newBlock);
   
-  // Stringify the DOM
-  rapidjson::StringBuffer packetInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-  d.Accept(writer);
+  // Encode the DOM
+  std::string packetInfo;
+  m_codec->EncodeFrame(d, packetInfo);
   
   if (m_advertiseBlocks == 1)
   {
     for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
     {
-	  const uint8_t delimiter[] = "#";
-
-      m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-	  m_peersSockets[*i]->Send (delimiter, 1, 0);
+      SendFrame (m_peersSockets[*i], packetInfo);
 	
 /* 	  //Send large packet
 	  int k;
@@ -311,7 +307,7 @@ BitcoinSimpleAttacker::MineBlock (void)
 
   NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
                << "s bitcoin simple attacker " << GetNode ()->GetId () 
-               << " sent a packet " << packetInfo.GetString() 
+               << " sent a packet " << RenderMessage(d) 
 	           << " " << m_minerAverageBlockSize);
 	
   if (m_attackFinished == false)	
@@ -32,17 +32,9 @@ BitcoinChunk::BitcoinChunk()
   BitcoinChunk(0, 0, 0, 0, 0, 0, 0, Ipv4Address("0.0.0.0"));
 }
 
-BitcoinChunk::BitcoinChunk (const BitcoinChunk &chunkSource)
+BitcoinChunk::BitcoinChunk (const BitcoinChunk &chunkSource) : Block (chunkSource)
 {  
-  m_blockHeight = chunkSource.m_blockHeight;
-  m_minerId = chunkSource.m_minerId;
   m_chunkId = chunkSource.m_chunkId;
-  m_parentBlockMinerId = chunkSource.m_parentBlockMinerId;
-  m_blockSizeBytes = chunkSource.m_blockSizeBytes;
-  m_timeCreated = chunkSource.m_timeCreated;
-  m_timeReceived = chunkSource.m_timeReceived;
-  m_receivedFromIpv4 = chunkSource.m_receivedFromIpv4;
-
 }
 
 BitcoinChunk::~BitcoinChunk (void)
@@ -64,14 +56,8 @@ BitcoinChunk::SetChunkId (int chunkId)
 BitcoinChunk& 
 BitcoinChunk::operator= (const BitcoinChunk &chunkSource)
 {  
-  m_blockHeight = chunkSource.m_blockHeight;
-  m_minerId = chunkSource.m_minerId;
+  Block::operator= (chunkSource);
   m_chunkId = chunkSource.m_chunkId;
-  m_parentBlockMinerId = chunkSource.m_parentBlockMinerId;
-  m_blockSizeBytes = chunkSource.m_blockSizeBytes;
-  m_timeCreated = chunkSource.m_timeCreated;
-  m_timeReceived = chunkSource.m_timeReceived;
-  m_receivedFromIpv4 = chunkSource.m_receivedFromIpv4;
 
   return *this;
 }
@@ -15,6 +15,148 @@
 
 namespace ns3 {
 
+/**
+ *
+ * Class BlockKey functions
+ *
+ */
+
+std::string
+BlockKey::ToString (void) const
+{
+    char buffer[24];
+    int length = snprintf(buffer, sizeof buffer, "%d/%d", GetHeight(), GetMinerId());
+    return std::string(buffer, length);
+}
+
+std::string
+BlockKey::ToChunkString (int chunkId) const
+{
+    char buffer[36];
+    int length = snprintf(buffer, sizeof buffer, "%d/%d/%d", GetHeight(), GetMinerId(), chunkId);
+    return std::string(buffer, length);
+}
+
+BlockKey
+BlockKey::FromString (const char *hash)
+{
+    char *end;
+    int height = strtol(hash, &end, 10);
+    int minerId = *end == '/' ? strtol(end + 1, &end, 10) : 0;
+    return BlockKey(height, minerId);
+}
+
+BlockKey
+BlockKey::FromString (const std::string &hash)
+{
+    return FromString(hash.c_str());
+}
+
+BlockKey
+BlockKey::FromChunkString (const std::string &chunkHash, int &chunkId)
+{
+    char *end;
+    int height = strtol(chunkHash.c_str(), &end, 10);
+    int minerId = *end == '/' ? strtol(end + 1, &end, 10) : 0;
+    chunkId = *end == '/' ? strtol(end + 1, &end, 10) : 0;
+    return BlockKey(height, minerId);
+}
+
+std::ostream& operator<< (std::ostream &out, const BlockKey &key)
+{
+    out << key.GetHeight() << "/" << key.GetMinerId();
+    return out;
+}
+
+
+/**
+ *
+ * Struct BlockBody functions
+ *
+ */
+
+BlockBody::BlockBody (void)
+{
+    blockId = 0;
+    blockHeight = 0;
+    minerId = 0;
+    parentBlockMinerId = 0;
+    blockSizeBytes = 0;
+    timeCreated = 0;
+    blockProposalIteration = 0;
+    interned = false;
+
+    memset(vrfSeed, 0, sizeof vrfSeed);
+    memset(participantPublicKey, 0, sizeof participantPublicKey);
+    memset(vrfOutput, 0, sizeof vrfOutput);
+}
+
+bool
+BlockBody::IsSameBlock (const BlockBody &body, bool compareBlockId) const
+{
+    return (!compareBlockId || blockId == body.blockId)
+           && blockHeight == body.blockHeight
+           && minerId == body.minerId
+           && parentBlockMinerId == body.parentBlockMinerId
+           && blockSizeBytes == body.blockSizeBytes
+           && timeCreated == body.timeCreated
+           && blockProposalIteration == body.blockProposalIteration
+           && memcmp(vrfSeed, body.vrfSeed, sizeof vrfSeed) == 0
+           && memcmp(participantPublicKey, body.participantPublicKey, sizeof participantPublicKey) == 0
+           && memcmp(vrfOutput, body.vrfOutput, sizeof vrfOutput) == 0;
+}
+
+
+/**
+ *
+ * Class BlockRegistry functions
+ *
+ */
+
+BlockKeyMap<std::weak_ptr<BlockBody>> BlockRegistry::m_bodies;
+size_t BlockRegistry::m_nextSweepSize = 1024;
+
+std::shared_ptr<BlockBody>
+BlockRegistry::Intern (const std::shared_ptr<BlockBody> &body, bool compareBlockId)
+{
+    if (body->interned)
+        return body;
+
+    // the sweep runs when the registry doubles, so it costs O(1) per interned body
+    if (m_bodies.size() >= m_nextSweepSize)
+        SweepExpired();
+
+    std::weak_ptr<BlockBody> &entry = m_bodies[BlockKey(body->blockHeight, body->minerId)];
+    std::shared_ptr<BlockBody> internedBody = entry.lock();
+
+    if (internedBody == nullptr)
+    {
+        body->interned = true;
+        entry = body;
+        return body;
+    }
+
+    if (internedBody->IsSameBlock(*body, compareBlockId))
+        return internedBody;
+
+    return body;
+}
+
+void
+BlockRegistry::SweepExpired (void)
+{
+    for (auto it = m_bodies.begin(); it != m_bodies.end(); )
+    {
+        if (it->second.expired())
+            it = m_bodies.erase(it);
+        else
+            it++;
+    }
+
+    m_nextSweepSize = std::max<size_t>(1024, 2 * m_bodies.size());
+}
+
+
 /**
  *
  * Class Block functions
@@ -28,122 +170,126 @@ Block::Block(int blockHeight, int minerId, int parentBlockMinerId, int blockSize
     std::mt19937 gen(rd()); // seed the generator
     std::uniform_int_distribution<> distribution(0, INT_MAX); // universal distribution for all INT numbers
 
-    m_blockId = distribution(gen);
-    m_blockHeight = blockHeight;
-    m_minerId = minerId;
-    m_parentBlockMinerId = parentBlockMinerId;
-    m_blockSizeBytes = blockSizeBytes;
-    m_timeCreated = timeCreated;
+    m_body = std::make_shared<BlockBody>();
+    m_body->blockId = distribution(gen);
+    m_body->blockHeight = blockHeight;
+    m_body->minerId = minerId;
+    m_body->parentBlockMinerId = parentBlockMinerId;
+    m_body->blockSizeBytes = blockSizeBytes;
+    m_body->timeCreated = timeCreated;
     m_timeReceived = timeReceived;
     m_receivedFromIpv4 = receivedFromIpv4;
-
-    memset(m_participantPublicKey,0, sizeof m_participantPublicKey);
-    memset(m_vrfOutput,0, sizeof m_vrfOutput);
 }
 
-Block::Block()
+Block::Block() : Block(0, 0, 0, 0, 0, 0, Ipv4Address("0.0.0.0"))
 {
-    Block(0, 0, 0, 0, 0, 0, Ipv4Address("0.0.0.0"));
 }
 
 Block::Block (const Block &blockSource)
 {
-    m_blockId = blockSource.m_blockId;
-    m_blockHeight = blockSource.m_blockHeight;
-    m_minerId = blockSource.m_minerId;
-    m_parentBlockMinerId = blockSource.m_parentBlockMinerId;
-    m_blockSizeBytes = blockSource.m_blockSizeBytes;
-    m_timeCreated = blockSource.m_timeCreated;
+    m_body = blockSource.m_body;
     m_timeReceived = blockSource.m_timeReceived;
     m_receivedFromIpv4 = blockSource.m_receivedFromIpv4;
-    m_blockProposalIteration = blockSource.m_blockProposalIteration;
     m_casperState = blockSource.m_casperState;
-
-    memset(m_participantPublicKey, 0, sizeof m_participantPublicKey);
-    memcpy(m_participantPublicKey, blockSource.m_participantPublicKey, sizeof m_participantPublicKey);
-    memset(m_vrfOutput, 0, sizeof m_vrfOutput);
-    memcpy(m_vrfOutput, blockSource.m_vrfOutput, sizeof m_vrfOutput);
-    memset(m_vrfSeed, 0, sizeof m_vrfSeed);
-    memcpy(m_vrfSeed, blockSource.m_vrfSeed, sizeof m_vrfSeed);
 }
 
 Block::~Block (void)
 {
 }
 
+BlockBody&
+Block::GetMutableBody (void)
+{
+    if (m_body->interned || m_body.use_count() > 1)
+    {
+        m_body = std::make_shared<BlockBody>(*m_body);
+        m_body->interned = false;
+    }
+    return *m_body;
+}
+
+void
+Block::Intern (bool compareBlockId)
+{
+    m_body = BlockRegistry::Intern(m_body, compareBlockId);
+}
+
 int
 Block::GetBlockId() const {
-    return m_blockId;
+    return m_body->blockId;
 }
 
 void
 Block::SetBlockId(int blockId) {
-    m_blockId = blockId;
+    GetMutableBody().blockId = blockId;
 }
 
 std::string
 Block::GetBlockHash(void) const {
-    std::ostringstream stringStream;
-    stringStream << GetBlockHeight () << "/" << GetMinerId ();
-    return stringStream.str();
+    return GetBlockKey().ToString();
+}
+
+BlockKey
+Block::GetBlockKey(void) const {
+    return BlockKey(m_body->blockHeight, m_body->minerId);
 }
 
 int
 Block::GetBlockHeight (void) const
 {
-    return m_blockHeight;
+    return m_body->blockHeight;
 }
 
 void
 Block::SetBlockHeight (int blockHeight)
 {
-    m_blockHeight = blockHeight;
+    GetMutableBody().blockHeight = blockHeight;
 }
 
 int
 Block::GetMinerId (void) const
 {
-    return m_minerId;
+    return m_body->minerId;
 }
 
 void
 Block::SetMinerId (int minerId)
 {
-    m_minerId = minerId;
+    GetMutableBody().minerId = minerId;
 }
 
 int
 Block::GetParentBlockMinerId (void) const
 {
-    return m_parentBlockMinerId;
+    return m_body->parentBlockMinerId;
 }
 
 void
 Block::SetParentBlockMinerId (int parentBlockMinerId)
 {
-    m_parentBlockMinerId = parentBlockMinerId;
+    GetMutableBody().parentBlockMinerId = parentBlockMinerId;
 }
 
 int
 Block::GetBlockSizeBytes (void) const
 {
-    return m_blockSizeBytes;
+    return m_body->blockSizeBytes;
 }
 
 void
 Block::SetBlockSizeBytes (int blockSizeBytes)
 {
-    m_blockSizeBytes = blockSizeBytes;
+    GetMutableBody().blockSizeBytes = blockSizeBytes;
 }
 
 int
 Block::GetBlockProposalIteration() const {
-    return m_blockProposalIteration;
+    return m_body->blockProposalIteration;
 }
 
 void
 Block::SetBlockProposalIteration(int blockProposalIteration) {
-    m_blockProposalIteration = blockProposalIteration;
+    GetMutableBody().blockProposalIteration = blockProposalIteration;
 }
 
 //unsigned int
@@ -158,49 +304,41 @@ Block::SetBlockProposalIteration(int blockProposalIteration) {
 
 unsigned char*
 Block::GetVrfSeed() const {
-    return (unsigned char*) m_vrfSeed;
+    return m_body->vrfSeed;
 }
 
 void
 Block::SetVrfSeed(unsigned char *vrfSeed) {
-    memset(m_vrfSeed, 0, sizeof m_vrfSeed);
-    memcpy(m_vrfSeed, vrfSeed, sizeof m_vrfSeed);
+    BlockBody &body = GetMutableBody();
+    memcpy(body.vrfSeed, vrfSeed, sizeof body.vrfSeed);
 }
 
 unsigned char*
 Block::GetParticipantPublicKey() const {
-    return (unsigned char*) m_participantPublicKey;
+    return m_body->participantPublicKey;
 }
 
 void
 Block::SetParticipantPublicKey(unsigned char *publicKey) {
-    memset(m_participantPublicKey, 0, sizeof m_participantPublicKey);
-    memcpy(m_participantPublicKey, publicKey, sizeof m_participantPublicKey);
-//    std::cout << "SET VRF PK:" << std::endl;
-//    for(int i=0; i<(sizeof m_participantPublicKey); ++i)
-//        std::cout << std::hex << (int)m_participantPublicKey[i];
-//    std::cout << std::endl << std::dec;
+    BlockBody &body = GetMutableBody();
+    memcpy(body.participantPublicKey, publicKey, sizeof body.participantPublicKey);
 }
 
 unsigned char*
 Block::GetVrfOutput() const {
-    return (unsigned char*) m_vrfOutput;
+    return m_body->vrfOutput;
 }
 
 void
 Block::SetVrfOutput(unsigned char *vrfOutput) {
-    memset(m_vrfOutput, 0, sizeof m_vrfOutput);
-    memcpy(m_vrfOutput, vrfOutput, sizeof m_vrfOutput);
-//    std::cout << "SET VRF OUTP:" << std::endl;
-//    for(int i=0; i<(sizeof m_vrfOutput); ++i)
-//        std::cout << std::hex << (int)m_vrfOutput[i];
-//    std::cout << std::endl << std::dec;
+    BlockBody &body = GetMutableBody();
+    memcpy(body.vrfOutput, vrfOutput, sizeof body.vrfOutput);
 }
 
 double
 Block::GetTimeCreated (void) const
 {
-    return m_timeCreated;
+    return m_body->timeCreated;
 }
 
 double
@@ -288,7 +426,7 @@ rapidjson::Document Block::ToJSON() {
     memset(zeroSeed, 0, 32);
     int cmp = memcmp(zeroSeed, GetVrfSeed(), 32);
     if(cmp != 0) {
-        value.SetString((const char*) m_vrfSeed, 32, block.GetAllocator());
+        value.SetString((const char*) GetVrfSeed(), 32, block.GetAllocator());
         block.AddMember("vrfSeed", value, block.GetAllocator());
     }
 
@@ -296,7 +434,7 @@ rapidjson::Document Block::ToJSON() {
     memset(zeroPK, 0, 64);
     cmp = memcmp(zeroPK, GetParticipantPublicKey(), 32);
     if(cmp != 0) {
-        value.SetString((const char*) m_participantPublicKey, 32, block.GetAllocator());
+        value.SetString((const char*) GetParticipantPublicKey(), 32, block.GetAllocator());
         block.AddMember("participantPublicKey", value, block.GetAllocator());
     }
 
@@ -308,7 +446,7 @@ rapidjson::Document Block::ToJSON() {
 //        const char* C1 = strOutput.c_str();
 //        char* S1 = reinterpret_cast<char*>(m_vrfOutput);
 //        const char* C1 = reinterpret_cast<const char*>(m_vrfOutput);
-        value.SetString((const char*) m_vrfOutput, 64, block.GetAllocator());
+        value.SetString((const char*) GetVrfOutput(), 64, block.GetAllocator());
         block.AddMember("vrfOutput", value, block.GetAllocator());
     }
 
@@ -363,6 +501,7 @@ Block Block::FromJSON(rapidjson::Document *document, Ipv4Address receivedFrom) {
     if((*document).HasMember("casperState"))
         block.SetCasperState((CasperState)(*document)["casperState"].GetUint());
 
+    block.Intern();
     return block;
 }
 
@@ -394,18 +533,177 @@ Block::IsChild(const Block &block, enum Cryptocurrency currency) const
 Block&
 Block::operator= (const Block &blockSource)
 {
-    m_blockHeight = blockSource.m_blockHeight;
-    m_minerId = blockSource.m_minerId;
-    m_parentBlockMinerId = blockSource.m_parentBlockMinerId;
-    m_blockSizeBytes = blockSource.m_blockSizeBytes;
-    m_timeCreated = blockSource.m_timeCreated;
+    m_body = blockSource.m_body;
     m_timeReceived = blockSource.m_timeReceived;
     m_receivedFromIpv4 = blockSource.m_receivedFromIpv4;
+    m_casperState = blockSource.m_casperState;
 
     return *this;
 }
 
 
+/**
+ *
+ * Class BlockArena functions
+ *
+ */
+
+BlockArena::BlockArena (void) : m_size (0)
+{
+}
+
+Block*
+BlockArena::Allocate (const Block &block)
+{
+    if (m_chunks.empty() || m_chunks.back().size() == m_chunks.back().capacity())
+    {
+        /* Moving the chunks keeps their buffers, so the blocks never move */
+        m_chunks.push_back(std::vector<Block>());
+        m_chunks.back().reserve(m_chunkSize);
+        m_chunksLive.push_back(0);
+        m_chunksByAddress[m_chunks.back().data()] = m_chunks.size() - 1;
+    }
+
+    m_chunks.back().push_back(block);
+    m_chunksLive.back()++;
+    m_size++;
+    return &m_chunks.back().back();
+}
+
+void
+BlockArena::Free (Block *block)
+{
+    std::map<const Block*, int>::iterator chunk_it = m_chunksByAddress.upper_bound(block);
+
+    /* The block stays in its chunk until the chunk is released, its body can be released (and expired) now */
+    block->m_body.reset();
+
+    chunk_it--;
+    int chunk = chunk_it->second;
+
+    m_chunksLive[chunk]--;
+    m_size--;
+
+    if (m_chunksLive[chunk] == 0 && chunk != static_cast<int>(m_chunks.size()) - 1)
+    {
+        /* All the blocks of the chunk were freed, release its memory */
+        std::vector<Block>().swap(m_chunks[chunk]);
+        m_chunksByAddress.erase(chunk_it);
+    }
+}
+
+int
+BlockArena::GetSize (void) const
+{
+    return m_size;
+}
+
+
+/**
+ *
+ * Struct CasperVote functions
+ *
+ */
+
+CasperVote
+CasperVote::FromJSON (const rapidjson::Document *vote, const char *voterIdKey)
+{
+    CasperVote casperVote;
+
+    casperVote.source = BlockKey::FromString((*vote)["s"].GetString());
+    casperVote.target = BlockKey::FromString((*vote)["t"].GetString());
+    casperVote.sourceHeight = (*vote)["hs"].GetInt();
+    casperVote.targetHeight = (*vote)["ht"].GetInt();
+    casperVote.epoch = (*vote)["epoch"].GetInt();
+    casperVote.voterId = (*vote)[voterIdKey].GetInt();
+    casperVote.stake = vote->HasMember("stake") ? (int)(*vote)["stake"].GetUint() : 1;
+
+    return casperVote;
+}
+
+
+/**
+ *
+ * Class CasperVoteTally functions
+ *
+ */
+
+CasperVoteTally::CasperVoteTally (void) : m_bestLinkWeight (0), m_totalWeight (0), m_justified (false)
+{
+}
+
+bool
+CasperVoteTally::AddVote (const CasperVote &vote)
+{
+    if (!m_votes.insert({vote.voterId, vote}).second)
+        return false;
+
+    std::pair<BlockKey, BlockKey> link = std::make_pair(vote.source, vote.target);
+    int weight = (m_linkWeights[link] += vote.stake);
+
+    m_totalWeight += vote.stake;
+
+    /* The highest weight, on tie the link with the lowest "height/minerId" hash strings */
+    if (m_votes.size() == 1 || weight > m_bestLinkWeight || (weight == m_bestLinkWeight && IsLowerLink(link, m_bestLink)))
+    {
+        m_bestLink = link;
+        m_bestLinkWeight = weight;
+    }
+
+    return true;
+}
+
+bool
+CasperVoteTally::IsLowerLink (const std::pair<BlockKey, BlockKey> &link1, const std::pair<BlockKey, BlockKey> &link2)
+{
+    /* The strings order differently than the keys, e.g. "10/1" < "9/1" */
+    return std::make_pair(link1.first.ToString(), link1.second.ToString())
+           < std::make_pair(link2.first.ToString(), link2.second.ToString());
+}
+
+bool
+CasperVoteTally::HasVoted (int voterId) const
+{
+    return m_votes.find(voterId) != m_votes.end();
+}
+
+int
+CasperVoteTally::GetNoVotes (void) const
+{
+    return m_votes.size();
+}
+
+int
+CasperVoteTally::GetTotalWeight (void) const
+{
+    return m_totalWeight;
+}
+
+const std::pair<BlockKey, BlockKey>&
+CasperVoteTally::GetBestLink (void) const
+{
+    return m_bestLink;
+}
+
+int
+CasperVoteTally::GetBestLinkWeight (void) const
+{
+    return m_bestLinkWeight;
+}
+
+void
+CasperVoteTally::SetJustified (void)
+{
+    m_justified = true;
+}
+
+bool
+CasperVoteTally::IsJustified (void) const
+{
+    return m_justified;
+}
+
+
 /**
  *
  * Class Blockchain functions
@@ -421,6 +719,15 @@ Blockchain::Blockchain(void)
     m_totalJustifiedCheckpoints = 0;
     m_totalNonJustifiedCheckpoints = 0;
     m_totalFinalizedCheckpoints = 0;
+    m_maxOrphans = 0;
+    m_maxOrphanAge = 0;
+    m_noEvictedOrphans = 0;
+    m_pruning = false;
+    m_prunedHeight = 0;
+    m_blocksInForks = 0;
+    m_longestFork = 0;
+    m_forkSizes.resize(1, 0);
+    m_lastFinalizedHeight = 0;
     Block genesisBlock(0, -1, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
     genesisBlock.SetBlockId(0);
     genesisBlock.SetCasperState(FINALIZED_CHKP);
@@ -444,6 +751,31 @@ Blockchain::GetNoOrphans (void) const
     return m_orphans.size();
 }
 
+int
+Blockchain::GetNoEvictedOrphans (void) const
+{
+    return m_noEvictedOrphans;
+}
+
+void
+Blockchain::SetOrphanLimits (int maxOrphans, double maxOrphanAge)
+{
+    m_maxOrphans = maxOrphans;
+    m_maxOrphanAge = maxOrphanAge;
+}
+
+void
+Blockchain::SetPruning (bool pruning)
+{
+    m_pruning = pruning;
+}
+
+int
+Blockchain::GetPrunedHeight (void) const
+{
+    return m_prunedHeight;
+}
+
 int
 Blockchain::GetTotalBlocks (void) const
 {
@@ -490,73 +822,38 @@ Blockchain::GetBlockchainHeight (void) const
 bool
 Blockchain::HasBlock (const Block &newBlock) const
 {
-
-    if (newBlock.GetBlockHeight() > GetCurrentTopBlock()->GetBlockHeight())
-    {
-        /* The new block has a new blockHeight, so we haven't received it previously. */
-
-        return false;
-    }
-    else
-    {
-        /*  The new block doesn't have a new blockHeight, so we have to check it is new or if we have already received it. */
-
-        for (auto const &block: m_blocks[newBlock.GetBlockHeight()])
-        {
-            if (block == newBlock)
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+    return HasBlock(newBlock.GetBlockKey());
 }
 
 bool
 Blockchain::HasBlock (int height, int minerId) const
 {
+    return HasBlock(BlockKey(height, minerId));
+}
 
-    if (height > GetCurrentTopBlock()->GetBlockHeight())
-    {
-        /* The new block has a new blockHeight, so we haven't received it previously. */
-
-        return false;
-    }
-    else
-    {
-        /*  The new block doesn't have a new blockHeight, so we have to check it is new or if we have already received it. */
+bool
+Blockchain::HasBlock (const BlockKey &key) const
+{
+    /* Only the main chain is known below the pruned height */
+    if (!key.IsNull() && key.GetHeight() < m_prunedHeight)
+        return m_prunedMainChain[key.GetHeight()] == key;
 
-        for (auto const &block: m_blocks[height])
-        {
-            if (block.GetBlockHeight() == height && block.GetMinerId() == minerId)
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+    return FindIndexEntry(key) != nullptr;
 }
 
 
 Block
 Blockchain::ReturnBlock(int height, int minerId)
 {
-    std::vector<Block>::iterator  block_it;
+    BlockKey                      key(height, minerId);
+    const Block                   *block = GetBlockPointer(key);
 
-    if (height <= GetBlockchainHeight() && height >= 0)
-    {
-        for (block_it = m_blocks[height].begin();  block_it < m_blocks[height].end(); block_it++)
-        {
-            if (block_it->GetBlockHeight() == height && block_it->GetMinerId() == minerId)
-                return *block_it;
-        }
-    }
+    if (block != nullptr)
+        return *block;
 
-    for (block_it = m_orphans.begin();  block_it < m_orphans.end(); block_it++)
-    {
-        if (block_it->GetBlockHeight() == height && block_it->GetMinerId() == minerId)
-            return *block_it;
-    }
+    auto orphan_it = m_orphans.find(key);
+    if (orphan_it != m_orphans.end())
+        return orphan_it->second.block;
 
     return Block(-1, -1, -1, -1, -1, -1, Ipv4Address("0.0.0.0"));
 }
@@ -565,62 +862,63 @@ Blockchain::ReturnBlock(int height, int minerId)
 bool
 Blockchain::IsOrphan (const Block &newBlock) const
 {
-    for (auto const &block: m_orphans)
-    {
-        if (block == newBlock)
-        {
-            return true;
-        }
-    }
-    return false;
+    return IsOrphan(newBlock.GetBlockKey());
 }
 
 
 bool
 Blockchain::IsOrphan (int height, int minerId) const
 {
-    for (auto const &block: m_orphans)
-    {
-        if (block.GetBlockHeight() == height && block.GetMinerId() == minerId)
-        {
-            return true;
-        }
-    }
-    return false;
+    return IsOrphan(BlockKey(height, minerId));
+}
+
+bool
+Blockchain::IsOrphan (const BlockKey &key) const
+{
+    return m_orphans.find(key) != m_orphans.end();
 }
 
 
 const Block*
 Blockchain::GetBlockPointer (const Block &newBlock) const
 {
-    if(m_blocks.size() <= newBlock.GetBlockHeight())
+    return GetBlockPointer(newBlock.GetBlockKey());
+}
+
+const Block*
+Blockchain::GetBlockPointer (const BlockKey &key) const
+{
+    const BlockIndexEntry *entry = FindIndexEntry(key);
+
+    if (entry == nullptr)
         return nullptr;
 
-    for (auto const &block: m_blocks[newBlock.GetBlockHeight()])
-    {
-        if (block == newBlock)
-        {
-            return &block;
-        }
-    }
-    return nullptr;
+    return entry->block;
 }
 
 
 Block*
 Blockchain::GetBlockPointerNonConst (const Block &newBlock)
 {
-    if(m_blocks.size() <= newBlock.GetBlockHeight())
-        return nullptr;
+    return const_cast<Block*>(GetBlockPointer(newBlock.GetBlockKey()));
+}
 
-    std::vector<Block>::iterator it;
-    it = find (m_blocks[newBlock.GetBlockHeight()].begin(), m_blocks[newBlock.GetBlockHeight()].end(), newBlock);
+Block*
+Blockchain::GetBlockPointerNonConst (const BlockKey &key)
+{
+    return const_cast<Block*>(GetBlockPointer(key));
+}
+
+
+const Blockchain::BlockIndexEntry*
+Blockchain::FindIndexEntry (const BlockKey &key) const
+{
+    BlockKeyMap<BlockIndexEntry>::const_iterator it = m_blockIndex.find(key);
 
-    if(it == m_blocks[newBlock.GetBlockHeight()].end()){
+    if (it == m_blockIndex.end() || it->second.block == nullptr)
         return nullptr;
-    }else{
-        return &(*it);
-    }
+
+    return &it->second;
 }
 
 
@@ -628,18 +926,15 @@ const std::vector<const Block *>
 Blockchain::GetChildrenPointers (const Block &block)
 {
     std::vector<const Block *> children;
-    std::vector<Block>::iterator  block_it;
-    int childrenHeight = block.GetBlockHeight() + 1;
+    BlockKeyMap<BlockIndexEntry>::const_iterator it = m_blockIndex.find(block.GetBlockKey());
 
-    if (childrenHeight > GetBlockchainHeight())
+    if (it == m_blockIndex.end())
         return children;
 
-    for (block_it = m_blocks[childrenHeight].begin();  block_it < m_blocks[childrenHeight].end(); block_it++)
+    children.reserve(it->second.children.size());
+    for (auto const &childKey : it->second.children)
     {
-        if (block.IsParent(*block_it))
-        {
-            children.push_back(&(*block_it));
-        }
+        children.push_back(GetBlockPointer(childKey));
     }
     return children;
 }
@@ -649,15 +944,14 @@ const std::vector<const Block *>
 Blockchain::GetOrphanChildrenPointers (const Block &newBlock)
 {
     std::vector<const Block *> children;
-    std::vector<Block>::iterator  block_it;
+    auto parent_it = m_orphansByParent.find(newBlock.GetBlockKey());
+
+    if (parent_it == m_orphansByParent.end())
+        return children;
+
+    for (auto const &key: parent_it->second)
+        children.push_back(&m_orphans.find(key)->second.block);
 
-    for (block_it = m_orphans.begin();  block_it < m_orphans.end(); block_it++)
-    {
-        if (newBlock.IsParent(*block_it))
-        {
-            children.push_back(&(*block_it));
-        }
-    }
     return children;
 }
 
@@ -665,75 +959,147 @@ Blockchain::GetOrphanChildrenPointers (const Block &newBlock)
 const std::vector<const Block *>
 Blockchain::GetAncestorsPointers (const Block &block, int lowestHeight)
 {
-    std::vector<const Block *> children;
-    std::vector<Block>::iterator  block_it;
-    const Block *lastBlock = &block;
-
-    for(int childrenHeight = block.GetBlockHeight() - 1; childrenHeight >= lowestHeight; childrenHeight--) {
-        if(m_blocks.size() > childrenHeight) {
-            for (block_it = m_blocks[childrenHeight].begin(); block_it != m_blocks[childrenHeight].end(); block_it++) {
-                if ((*block_it).IsParent(*lastBlock)) {
-                    children.push_back(&(*block_it));
-                    lastBlock = &(*block_it);
-                }
-            }
-        }
-    }
+    std::vector<const Block *> ancestors;
 
-    return children;
+    for (AncestorIterator it = IterateAncestors(block, lowestHeight); it.IsValid(); it.Next())
+        ancestors.push_back(it.Get());
+
+    return ancestors;
 }
 
 std::vector<Block *>
 Blockchain::GetAncestorsPointersNonConst(const Block &block, int lowestHeight) {
-    std::vector<Block *> children;
-    std::vector<Block>::iterator  block_it;
-    Block *lastBlock = GetBlockPointerNonConst(block);
-
-    for(int childrenHeight = block.GetBlockHeight() - 1; childrenHeight >= lowestHeight; childrenHeight--) {
-        if(m_blocks.size() > childrenHeight) {
-            for (block_it = m_blocks[childrenHeight].begin(); block_it != m_blocks[childrenHeight].end(); block_it++) {
-                if ((*block_it).IsParent(*lastBlock)) {
-                    children.push_back(&(*block_it));
-                    lastBlock = &(*block_it);
-                }
-            }
-        }
+    std::vector<Block *> ancestors;
+
+    for (AncestorIterator it = IterateAncestors(block, lowestHeight); it.IsValid(); it.Next())
+        ancestors.push_back(GetBlockPointerNonConst(it.GetKey()));
+
+    return ancestors;
+}
+
+Blockchain::AncestorIterator
+Blockchain::IterateAncestors (const Block &block, int lowestHeight) const
+{
+    return AncestorIterator(this, BlockKey(block.GetBlockHeight() - 1, block.GetParentBlockMinerId()), lowestHeight);
+}
+
+BlockKey
+Blockchain::GetAncestorKey (const BlockKey &key, int height) const
+{
+    if (height < 0 || height > key.GetHeight())
+        return BlockKey();
+
+    if (height < m_prunedHeight)
+    {
+        /* Only the main chain is known below the pruned height */
+        if (GetAncestorKey(key, m_prunedHeight) != m_prunedRoot)
+            return BlockKey();
+        return m_prunedMainChain[height];
     }
 
-    return children;
+    BlockKey                ancestor = key;
+    const BlockIndexEntry   *entry = FindIndexEntry(ancestor);
+
+    while (entry != nullptr && ancestor.GetHeight() > height)
+    {
+        int heightSkip = GetSkipHeight(ancestor.GetHeight());
+        int heightSkipPrev = GetSkipHeight(ancestor.GetHeight() - 1);
+
+        /* Take the skip pointer unless it overshoots, or the skip pointer of the parent gets closer */
+        if (!entry->skip.IsNull()
+            && (heightSkip == height || (heightSkip > height && !(heightSkipPrev < heightSkip - 2 && heightSkipPrev >= height))))
+            ancestor = entry->skip;
+        else
+            ancestor = entry->parent;
+
+        entry = FindIndexEntry(ancestor);
+    }
+
+    return entry != nullptr ? ancestor : BlockKey();
+}
+
+int
+Blockchain::GetSkipHeight (int height)
+{
+    if (height < 2)
+        return 0;
+
+    /* height & (height - 1) turns off the lowest set bit */
+    if (height & 1)
+    {
+        int previous = (height - 1) & (height - 2);
+        return (previous & (previous - 1)) + 1;
+    }
+    return height & (height - 1);
 }
 
 bool
 Blockchain::IsAncestor(const Block *block, const Block *possibleAncestor)
 {
-    std::vector<const Block*> ancestors = GetAncestorsPointers(*block, possibleAncestor->GetBlockHeight());
-    for (auto ancestor : ancestors) {
-        if (*ancestor == *possibleAncestor) {
-            return true;
-        }
-    }
-    return false;
+    int ancestorHeight = possibleAncestor->GetBlockHeight();
+
+    if (ancestorHeight >= block->GetBlockHeight())
+        return false;
+
+    BlockKey parentKey(block->GetBlockHeight() - 1, block->GetParentBlockMinerId());
+    return GetAncestorKey(parentKey, ancestorHeight) == possibleAncestor->GetBlockKey();
+}
+
+
+Blockchain::AncestorIterator::AncestorIterator (const Blockchain *blockchain, const BlockKey &key, int lowestHeight)
+    : m_blockchain (blockchain), m_key (key), m_lowestHeight (lowestHeight)
+{
+    Check();
+}
+
+bool
+Blockchain::AncestorIterator::IsValid (void) const
+{
+    return !m_key.IsNull();
+}
+
+void
+Blockchain::AncestorIterator::Next (void)
+{
+    m_key = m_blockchain->FindIndexEntry(m_key)->parent;
+    Check();
 }
 
+const BlockKey&
+Blockchain::AncestorIterator::GetKey (void) const
+{
+    return m_key;
+}
+
+const Block*
+Blockchain::AncestorIterator::Get (void) const
+{
+    return m_blockchain->GetBlockPointer(m_key);
+}
+
+void
+Blockchain::AncestorIterator::Check (void)
+{
+    if (m_key.GetHeight() < m_lowestHeight || m_blockchain->FindIndexEntry(m_key) == nullptr)
+        m_key = BlockKey();
+}
 
 const std::vector<const Block *>
 Blockchain::GetNotFinalizedCheckpoints(const Block &lastFinalizedCheckpoint)
 {
     std::vector<const Block*> newCheckpoints;
-    std::vector<Block>::iterator  block_it;
 
     // at first, insert pointer to the last finalized checkpoint
     const Block *finalized = GetBlockPointer(lastFinalizedCheckpoint);
+    if(finalized == nullptr)
+        NS_FATAL_ERROR("The last finalized checkpoint " << lastFinalizedCheckpoint.GetBlockKey() << " is not in the blockchain");
     newCheckpoints.push_back(finalized);
 
-    for(int childrenHeight = finalized->GetBlockHeight() + 1; childrenHeight <= GetBlockchainHeight(); childrenHeight++) {
-        for (block_it = m_blocks[childrenHeight].begin(); block_it < m_blocks[childrenHeight].end(); block_it++) {
-            // we are looking only for not justified and justified checkpoints.. last finalized is already in vector
-            if(((*block_it).GetCasperState() == CHECKPOINT
-               || (*block_it).GetCasperState() == JUSTIFIED_CHKP)
-               && IsAncestor(&(*block_it), finalized)){
-                newCheckpoints.push_back(&(*block_it));
-            }
+    // live checkpoints are the not justified and justified checkpoints.. last finalized is already in vector
+    for(auto height_it = m_liveCheckpoints.upper_bound(finalized->GetBlockHeight()); height_it != m_liveCheckpoints.end(); height_it++) {
+        for (auto checkpoint : height_it->second) {
+            if(IsAncestor(checkpoint, finalized))
+                newCheckpoints.push_back(checkpoint);
         }
     }
 
@@ -745,37 +1111,48 @@ Blockchain::GetNotFinalizedCheckpoints(const Block &lastFinalizedCheckpoint)
 const Block*
 Blockchain::GetParent (const Block &block)
 {
-    std::vector<Block>::iterator  block_it;
-    int parentHeight = block.GetBlockHeight() - 1;
-
-    if (parentHeight > GetBlockchainHeight() || parentHeight < 0)
-        return nullptr;
-
-    for (block_it = m_blocks[parentHeight].begin();  block_it < m_blocks[parentHeight].end(); block_it++)  {
-        if (block.IsChild(*block_it))
-        {
-            return &(*block_it);
-        }
-    }
-
-    return nullptr;
+    return GetBlockPointer(BlockKey(block.GetBlockHeight() - 1, block.GetParentBlockMinerId()));
 }
 
 
 const Block*
 Blockchain::GetCurrentTopBlock (void) const
 {
-    return &m_blocks[m_blocks.size() - 1][0];
+    return m_blocks.back()[0];
+}
+
+
+std::vector<Block*>&
+Blockchain::GetRow (int height)
+{
+    return m_blocks[height - m_prunedHeight];
 }
 
 
 void
 Blockchain::AddBlock (const Block& newBlock)
 {
+    if (newBlock.GetBlockHeight() < m_prunedHeight)
+    {
+        /* The block is a fork of the pruned finalized prefix, so it's only counted */
+        m_noStaleBlocks++;
+        m_totalBlocks++;
+        UpdateForkStats(0, false, ++m_prunedRowSizes[newBlock.GetBlockHeight()]);
+        UpdateCountOfBlocks(&newBlock, newBlock.GetCasperState(), true);
+        return;
+    }
+
+    /* A block with the same key is already indexed, a copy would only be orphaned in the arena */
+    auto index_it = m_blockIndex.find(newBlock.GetBlockKey());
+    if (index_it != m_blockIndex.end() && index_it->second.block != nullptr)
+        return;
+
+    Block *block = m_blockArena.Allocate(newBlock);
+    block->Intern();
 
     if (m_blocks.size() == 0)
     {
-        std::vector<Block> newHeight(1, newBlock);
+        std::vector<Block*> newHeight(1, block);
         m_blocks.push_back(newHeight);
     }
     else if (newBlock.GetBlockHeight() > GetCurrentTopBlock()->GetBlockHeight())
@@ -788,54 +1165,122 @@ Blockchain::AddBlock (const Block& newBlock)
 
         for(int i = 0; i < dummyRows; i++)
         {
-            std::vector<Block> newHeight;
+            std::vector<Block*> newHeight;
             m_blocks.push_back(newHeight);
         }
 
-        std::vector<Block> newHeight(1, newBlock);
+        std::vector<Block*> newHeight(1, block);
         m_blocks.push_back(newHeight);
     }
     else
     {
         /* The new block doesn't have a new blockHeight, so we have to add it in an existing row */
 
-        if (m_blocks[newBlock.GetBlockHeight()].size() > 0)
+        if (GetRow(newBlock.GetBlockHeight()).size() > 0)
             m_noStaleBlocks++;
 
-        m_blocks[newBlock.GetBlockHeight()].push_back(newBlock);
+        GetRow(newBlock.GetBlockHeight()).push_back(block);
+    }
+
+    /* Index the block and link it with its parent, the parent may be added later */
+    BlockIndexEntry &entry = m_blockIndex[newBlock.GetBlockKey()];
+    BlockKey parentKey(newBlock.GetBlockHeight() - 1, newBlock.GetParentBlockMinerId());
+
+    entry.block = block;
+    entry.parent = parentKey;
+    if (!parentKey.IsNull() && parentKey.GetHeight() < m_prunedHeight)
+    {
+        /* The parent was pruned, so the block is a fork next to the lowest kept checkpoint */
+        entry.forkDepth = UpdateForkStats(0, false, GetRow(newBlock.GetBlockHeight()).size());
+        entry.skip = GetAncestorKey(parentKey, GetSkipHeight(newBlock.GetBlockHeight()));
+    }
+    else if (!parentKey.IsNull())
+    {
+        BlockIndexEntry &parentEntry = m_blockIndex[parentKey];
+
+        /* The first child continues the branch of its parent, the other ones start forks */
+        entry.forkDepth = UpdateForkStats(parentEntry.forkDepth, parentEntry.children.empty(),
+                                          GetRow(newBlock.GetBlockHeight()).size());
+        parentEntry.children.push_back(newBlock.GetBlockKey());
+        entry.skip = GetAncestorKey(parentKey, GetSkipHeight(newBlock.GetBlockHeight()));
     }
 
     m_totalBlocks++;
-    UpdateCountOfBlocks(&newBlock, newBlock.GetCasperState(), true);
+    UpdateCountOfBlocks(block, newBlock.GetCasperState(), true);
 }
 
 
 void
 Blockchain::AddOrphan (const Block& newBlock)
 {
-    m_orphans.push_back(newBlock);
+    BlockKey key = newBlock.GetBlockKey();
+
+    if (IsOrphan(key))
+        return;
+
+    EvictOrphans();
+
+    auto orphan_it = m_orphans.emplace(key, OrphanEntry(newBlock, Simulator::Now().GetSeconds())).first;
+    orphan_it->second.order = m_orphansOrder.insert(m_orphansOrder.end(), key);
+    m_orphansByParent[BlockKey(newBlock.GetBlockHeight() - 1, newBlock.GetParentBlockMinerId())].push_back(key);
 }
 
 
 void
 Blockchain::RemoveOrphan (const Block& newBlock)
 {
-    std::vector<Block>::iterator  block_it;
+    auto orphan_it = m_orphans.find(newBlock.GetBlockKey());
+
+    if (orphan_it != m_orphans.end())
+        EraseOrphan(orphan_it);
+}
 
-    for (block_it = m_orphans.begin();  block_it < m_orphans.end(); block_it++)
+
+void
+Blockchain::EraseOrphan (BlockKeyMap<OrphanEntry>::iterator orphan_it)
+{
+    const Block &orphan = orphan_it->second.block;
+    auto parent_it = m_orphansByParent.find(BlockKey(orphan.GetBlockHeight() - 1, orphan.GetParentBlockMinerId()));
+
+    if (parent_it != m_orphansByParent.end())
     {
-        if (newBlock == *block_it)
-            break;
+        std::vector<BlockKey> &siblings = parent_it->second;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), orphan_it->first));
+        if (siblings.empty())
+            m_orphansByParent.erase(parent_it);
     }
 
-    if (block_it == m_orphans.end())
+    m_orphansOrder.erase(orphan_it->second.order);
+    m_orphans.erase(orphan_it);
+}
+
+
+void
+Blockchain::EvictOrphans (void)
+{
+    if (m_maxOrphanAge > 0)
     {
-        // name not in vector
-        return;
+        double oldestAllowed = Simulator::Now().GetSeconds() - m_maxOrphanAge;
+
+        while (!m_orphansOrder.empty())
+        {
+            auto orphan_it = m_orphans.find(m_orphansOrder.front());
+            if (orphan_it->second.timeAdded >= oldestAllowed)
+                break;
+
+            EraseOrphan(orphan_it);
+            m_noEvictedOrphans++;
+        }
     }
-    else
+
+    if (m_maxOrphans > 0)
     {
-        m_orphans.erase(block_it);
+        while (static_cast<int>(m_orphans.size()) >= m_maxOrphans)
+        {
+            auto orphan_it = m_orphans.find(m_orphansOrder.front());
+            EraseOrphan(orphan_it);
+            m_noEvictedOrphans++;
+        }
     }
 }
 
@@ -843,13 +1288,11 @@ Blockchain::RemoveOrphan (const Block& newBlock)
 void
 Blockchain::PrintOrphans (void)
 {
-    std::vector<Block>::iterator  block_it;
-
     std::cout << "The orphans are:\n";
 
-    for (block_it = m_orphans.begin();  block_it < m_orphans.end(); block_it++)
+    for (auto const &key: m_orphansOrder)
     {
-        std::cout << *block_it << "\n";
+        std::cout << m_orphans.find(key)->second.block << "\n";
     }
 
     std::cout << "\n";
@@ -858,29 +1301,29 @@ Blockchain::PrintOrphans (void)
 
 void Blockchain::PrintCheckpoints(void) {
 
-    std::vector< std::vector<Block>>::iterator blockHeight_it;
-    std::vector<Block>::iterator  block_it;
+    std::deque< std::vector<Block*>>::iterator blockHeight_it;
+    std::vector<Block*>::iterator  block_it;
 
     int i;
     bool printedHeight = false;
 
     std::cout << "The checkpoints are:\n";
 
-    for (blockHeight_it = m_blocks.begin(), i = 0; blockHeight_it < m_blocks.end(); blockHeight_it++, i++)
+    for (blockHeight_it = m_blocks.begin(), i = m_prunedHeight; blockHeight_it < m_blocks.end(); blockHeight_it++, i++)
     {
         printedHeight = false;
         for (block_it = blockHeight_it->begin();  block_it < blockHeight_it->end(); block_it++)
         {
-            if(   block_it->GetCasperState() == CHECKPOINT
-               || block_it->GetCasperState() == JUSTIFIED_CHKP
-               || block_it->GetCasperState() == FINALIZED_CHKP) {
+            if(   (*block_it)->GetCasperState() == CHECKPOINT
+               || (*block_it)->GetCasperState() == JUSTIFIED_CHKP
+               || (*block_it)->GetCasperState() == FINALIZED_CHKP) {
 
                 if(!printedHeight) {
                     std::cout << "  BLOCK HEIGHT " << i << ":\n";
                     printedHeight = true;
                 }
 
-                std::cout << *block_it << "\n";
+                std::cout << **block_it << "\n";
             }
         }
     }
@@ -890,115 +1333,121 @@ void Blockchain::PrintCheckpoints(void) {
 
 
 int
-Blockchain::GetBlocksInForks (void)
+Blockchain::GetBlocksInForks (void) const
 {
-    std::vector< std::vector<Block>>::iterator blockHeight_it;
-    int count = 0;
+    return m_blocksInForks;
+}
 
-    for (blockHeight_it = m_blocks.begin(); blockHeight_it < m_blocks.end(); blockHeight_it++)
-    {
-        if (blockHeight_it->size() > 1)
-            count += blockHeight_it->size();
-    }
 
-    return count;
+int
+Blockchain::GetLongestForkSize (void) const
+{
+    return m_longestFork;
 }
 
 
 int
-Blockchain::GetLongestForkSize (void)
+Blockchain::GetNoForks (void) const
 {
-    std::vector< std::vector<Block>>::iterator   blockHeight_it;
-    std::vector<Block>::iterator                 block_it;
-    std::map<int, int>                           forkedBlocksParentId;
-    std::vector<int>                             newForks;
-    std::vector<int>                             toEraseFromForkedBlocksParentId;
-    int maxSize = 0;
+    return m_forkSizes.size() > 1 ? m_forkSizes[1] : 0;
+}
 
-    for (blockHeight_it = m_blocks.begin(); blockHeight_it < m_blocks.end(); blockHeight_it++)
-    {
 
-        if (blockHeight_it->size() > 1 && forkedBlocksParentId.size() == 0)
-        {
-            for (block_it = blockHeight_it->begin();  block_it < blockHeight_it->end(); block_it++)
-            {
-                forkedBlocksParentId[block_it->GetMinerId()] = 1;
-            }
-        }
-        else if (blockHeight_it->size() > 1)
-        {
-            for (block_it = blockHeight_it->begin();  block_it < blockHeight_it->end(); block_it++)
-            {
-                std::map<int, int>::iterator mapIndex = forkedBlocksParentId.find(block_it->GetParentBlockMinerId());
-
-                if(mapIndex != forkedBlocksParentId.end())
-                {
-                    forkedBlocksParentId[block_it->GetMinerId()] = mapIndex->second + 1;
-                    if(block_it->GetMinerId() != mapIndex->first)
-                        forkedBlocksParentId.erase(mapIndex);
-                    newForks.push_back(block_it->GetMinerId());
-                }
-                else
-                {
-                    forkedBlocksParentId[block_it->GetMinerId()] = 1;
-                }
-            }
+const std::vector<int>&
+Blockchain::GetForkSizeHistogram (void) const
+{
+    return m_forkSizes;
+}
 
-            for (auto &block : forkedBlocksParentId)
-            {
-                if (std::find(newForks.begin(), newForks.end(), block.first) == newForks.end() )
-                {
-                    if(block.second > maxSize) {
-                        maxSize = block.second;
-                    }
-                    toEraseFromForkedBlocksParentId.push_back(block.first);
-                }
-            }
 
-            for(auto block : toEraseFromForkedBlocksParentId){
-                forkedBlocksParentId.erase(block);
-            }
-        }
-        else if (blockHeight_it->size() == 1 && forkedBlocksParentId.size() > 0)
-        {
+double
+Blockchain::GetStaleRate (void) const
+{
+    return m_totalBlocks > 0 ? static_cast<double>(m_noStaleBlocks) / m_totalBlocks : 0;
+}
 
-            for (auto &block : forkedBlocksParentId)
-            {
-                if(block.second > maxSize)
-                    maxSize = block.second;
-            }
 
-            forkedBlocksParentId.clear();
-        }
+int
+Blockchain::UpdateForkStats (int parentForkDepth, bool firstChild, int rowSize)
+{
+    int forkDepth = 0;
+
+    if (rowSize == 2)
+        m_blocksInForks += 2;
+    else if (rowSize > 2)
+        m_blocksInForks++;
+
+    if (!firstChild)
+        forkDepth = 1;
+    else if (parentForkDepth > 0)
+    {
+        forkDepth = parentForkDepth + 1;
+        m_forkSizes[parentForkDepth]--;
     }
 
-    for (auto &block : forkedBlocksParentId)
+    if (forkDepth > 0)
     {
-        if(block.second > maxSize)
-            maxSize = block.second;
+        if (static_cast<int>(m_forkSizes.size()) <= forkDepth)
+            m_forkSizes.resize(forkDepth + 1, 0);
+        m_forkSizes[forkDepth]++;
+
+        if (forkDepth > m_longestFork)
+            m_longestFork = forkDepth;
     }
 
-    return maxSize;
+    return forkDepth;
 }
 
-const Block*
-Blockchain::CasperUpdateBlockchain(std::string source, std::string target, const Block *lastFinalizedCheckpoint,
-                                   int maxBlocksInEpoch, std::string* missingBlock) {
-    // searching checkpoints in blockchain
-    std::string   delimiter = "/";
-    size_t        sourcePos = source.find(delimiter);
-    size_t        targetPos = target.find(delimiter);
+void
+Blockchain::PruneBelow (const Block *checkpoint)
+{
+    int height = checkpoint->GetBlockHeight();
 
-    int sourceHeight = atoi(source.substr(0, sourcePos).c_str());
-    int sourceMinerId = atoi(source.substr(sourcePos+1, source.size()).c_str());
-    int targetHeight = atoi(target.substr(0, targetPos).c_str());
-    int targetMinerId = atoi(target.substr(targetPos+1, target.size()).c_str());
+    /* Main chain keys of the pruned rows, from the checkpoint down */
+    m_prunedMainChain.resize(height);
+    m_prunedRowSizes.resize(height);
+    for (AncestorIterator it = IterateAncestors(*checkpoint, m_prunedHeight); it.IsValid(); it.Next())
+        m_prunedMainChain[it.GetKey().GetHeight()] = it.GetKey();
 
-    Block sourceTemplate(sourceHeight, sourceMinerId, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
-    Block targetTemplate(targetHeight, targetMinerId, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
+    while (m_prunedHeight < height)
+    {
+        std::vector<Block*> &row = m_blocks.front();
 
-    Block* sourceBlock = GetBlockPointerNonConst (sourceTemplate);
-    Block* targetBlock = GetBlockPointerNonConst (targetTemplate);
+        m_prunedRowSizes[m_prunedHeight] = row.size();
+
+        for (auto block : row)
+        {
+            ErasePrunedParent(block);
+            m_blockIndex.erase(block->GetBlockKey());
+            m_blockArena.Free(block);
+        }
+
+        m_blocks.pop_front();
+        m_prunedHeight++;
+    }
+
+    for (auto block : m_blocks.front())
+        ErasePrunedParent(block);
+
+    m_prunedRoot = checkpoint->GetBlockKey();
+}
+
+void
+Blockchain::ErasePrunedParent (const Block *block)
+{
+    BlockKey parentKey(block->GetBlockHeight() - 1, block->GetParentBlockMinerId());
+    BlockKeyMap<BlockIndexEntry>::iterator parent_it = m_blockIndex.find(parentKey);
+
+    if (parent_it != m_blockIndex.end() && parent_it->second.block == nullptr)
+        m_blockIndex.erase(parent_it);
+}
+
+const Block*
+Blockchain::CasperUpdateBlockchain(const BlockKey &source, const BlockKey &target, const Block *lastFinalizedCheckpoint,
+                                   int maxBlocksInEpoch, BlockKey* missingBlock) {
+    // searching checkpoints in blockchain
+    Block* sourceBlock = GetBlockPointerNonConst (source);
+    Block* targetBlock = GetBlockPointerNonConst (target);
 
     if(sourceBlock == nullptr){
         std::cerr << "SOURCE " << source << " is NULLPTR" << std::endl;
@@ -1019,72 +1468,52 @@ Blockchain::CasperUpdateBlockchain(std::string source, std::string target, const
 
     // committee was not able to find new justified checkpoint
     if(targetBlock->GetCasperState() == FINALIZED_CHKP) {
-        *missingBlock = "";
+        *missingBlock = BlockKey();
         return nullptr;
     }
 
     UpdateCountOfBlocks(targetBlock, JUSTIFIED_CHKP);
     targetBlock->SetCasperState(JUSTIFIED_CHKP);
 
-    *missingBlock = "";
-    return CasperUpdateFinalized(lastFinalizedCheckpoint, maxBlocksInEpoch);
+    // record the link, it can finalize its source once the source gets justified
+    std::vector<BlockKey> &targets = m_supermajorityLinks[source];
+    if(std::find(targets.begin(), targets.end(), target) == targets.end())
+        targets.push_back(target);
+
+    *missingBlock = BlockKey();
+    return CasperUpdateFinalized(lastFinalizedCheckpoint, sourceBlock, targetBlock, maxBlocksInEpoch);
 }
 
 const Block*
-Blockchain::CasperUpdateFinalized(const Block *lastFinalizedCheckpoint, int maxBlocksInEpoch) {
-    // find new not finalized yet checkpoints
-    std::vector<const Block*> newCheckpoints = GetNotFinalizedCheckpoints(*lastFinalizedCheckpoint);
-
-    std::vector<const Block*> shouldBeFinalized;
-    for(int i = 0; i < newCheckpoints.size(); i++){
-        const Block* checkpointA = newCheckpoints.at(i);
-        if(checkpointA->GetCasperState() != JUSTIFIED_CHKP)
-            continue;
-        for(int j = i+1; j < newCheckpoints.size(); j++){
-            const Block* checkpointB = newCheckpoints.at(j);
-            if(checkpointB->GetCasperState() != JUSTIFIED_CHKP)
-                continue;
-
-            // get order of checkpoints
-            const Block* higher = checkpointA;
-            const Block* lower = checkpointB;
-            if(checkpointA->GetBlockHeight() < checkpointB->GetBlockHeight()) {
-                higher = checkpointB;
-                lower = checkpointA;
+Blockchain::CasperUpdateFinalized(const Block *lastFinalizedCheckpoint, const Block *source, const Block *target,
+                                  int maxBlocksInEpoch) {
+    // only the new link and the links from the newly justified target can finalize something
+    const Block* newlyFinalized = nullptr;
+    if(IsFinalizingLink(source, target, maxBlocksInEpoch))
+        newlyFinalized = source;
+
+    auto links_it = m_supermajorityLinks.find(target->GetBlockKey());
+    if(links_it != m_supermajorityLinks.end()) {
+        for(auto &childKey : links_it->second) {
+            const Block* child = GetBlockPointer(childKey);
+            if(child != nullptr && IsFinalizingLink(target, child, maxBlocksInEpoch)
+               && (newlyFinalized == nullptr || target->GetBlockHeight() > newlyFinalized->GetBlockHeight())) {
+                newlyFinalized = target;
             }
-
-            // check if height difference between checkpoints is equal to m_maxBlocksInEpoch
-            if((higher->GetBlockHeight() - lower->GetBlockHeight()) != maxBlocksInEpoch)
-                continue;
-
-            // check if lower checkpoint is ancestor of higher checkpoint
-            if(IsAncestor(higher, lower))
-                shouldBeFinalized.push_back(lower);
         }
     }
 
-    if(shouldBeFinalized.size() == 0)
+    if(newlyFinalized == nullptr || newlyFinalized->GetBlockHeight() <= lastFinalizedCheckpoint->GetBlockHeight())
         return nullptr;
 
-    // get highest from shouldBeFinalized checkpoints
-    // (always should be only one, but maybe some node forget to update state)
-    const Block* newlyFinalized = shouldBeFinalized.at(0);
-    int height = newlyFinalized->GetBlockHeight();
-    for(auto checkpoint : shouldBeFinalized){
-        if(checkpoint->GetBlockHeight() > height){
-            newlyFinalized = checkpoint;
-            height = checkpoint->GetBlockHeight();
-        }
-    }
-
     // update state of checkpoint and blocks
     Block* newlyFinalizedNonConst = GetBlockPointerNonConst (*newlyFinalized);
     UpdateCountOfBlocks(newlyFinalizedNonConst, FINALIZED_CHKP);
     newlyFinalizedNonConst->SetCasperState(FINALIZED_CHKP);
 
 
-    std::vector<Block*> ancestors = GetAncestorsPointersNonConst(*newlyFinalized, lastFinalizedCheckpoint->GetBlockHeight());
-    for(auto block : ancestors){
+    for(AncestorIterator it = IterateAncestors(*newlyFinalized, lastFinalizedCheckpoint->GetBlockHeight()); it.IsValid(); it.Next()){
+        Block *block = GetBlockPointerNonConst(it.GetKey());
         if(block->GetCasperState() == STD_BLOCK) {
             UpdateCountOfBlocks(block, FINALIZED);
             block->SetCasperState(FINALIZED);
@@ -1095,59 +1524,122 @@ Blockchain::CasperUpdateFinalized(const Block *lastFinalizedCheckpoint, int maxB
         }
     }
 
+    PruneLiveCheckpoints(newlyFinalized);
+
+    // links from the finalized checkpoint and below it can't finalize anything anymore
+    for(auto links_it = m_supermajorityLinks.begin(); links_it != m_supermajorityLinks.end(); ) {
+        if(links_it->first.GetHeight() <= newlyFinalized->GetBlockHeight())
+            links_it = m_supermajorityLinks.erase(links_it);
+        else
+            links_it++;
+    }
+
+    // the previous finalized checkpoint is kept, the blocks below it can't change anymore
+    const Block *previousFinalized = GetBlockPointer(*lastFinalizedCheckpoint);
+    if(m_pruning && previousFinalized != nullptr && previousFinalized->GetBlockHeight() > m_prunedHeight)
+        PruneBelow(previousFinalized);
+
     return newlyFinalized;
 }
 
+bool
+Blockchain::IsFinalizingLink(const Block *source, const Block *target, int maxBlocksInEpoch)
+{
+    if(source->GetCasperState() != JUSTIFIED_CHKP || target->GetCasperState() != JUSTIFIED_CHKP)
+        return false;
+
+    // check if height difference between checkpoints is equal to m_maxBlocksInEpoch
+    if((target->GetBlockHeight() - source->GetBlockHeight()) != maxBlocksInEpoch)
+        return false;
+
+    // check if source checkpoint is ancestor of target checkpoint
+    return IsAncestor(target, source);
+}
+
 void
-Blockchain::GasperUpdateEpochBoundaryCheckpoints(const Block *lastFinalizedCheckpoint, int maxBlocksInEpoch)
+Blockchain::PruneLiveCheckpoints(const Block *finalized)
 {
-    // at first, insert pointer to the last finalized checkpoint
-    const Block *finalized = GetBlockPointer(*lastFinalizedCheckpoint);
-
-    std::vector<Block>::iterator  block_it;
-    for(int childrenHeight = finalized->GetBlockHeight() + 1; childrenHeight <= GetBlockchainHeight(); childrenHeight++) {
-        for (block_it = m_blocks[childrenHeight].begin(); block_it < m_blocks[childrenHeight].end(); block_it++) {
-            // we are not looking for checkpoints
-            if(((*block_it).GetCasperState() == CHECKPOINT
-                || (*block_it).GetCasperState() == JUSTIFIED_CHKP))
-            {
-                continue;
-            }
+    m_lastFinalizedHeight = finalized->GetBlockHeight();
+
+    // checkpoints at the height of the finalized checkpoint and below it can't be its descendants
+    m_liveCheckpoints.erase(m_liveCheckpoints.begin(), m_liveCheckpoints.upper_bound(m_lastFinalizedHeight));
+
+    // checkpoints in the conflicting branches won't be finalized anymore
+    for(auto height_it = m_liveCheckpoints.begin(); height_it != m_liveCheckpoints.end(); ) {
+        std::vector<const Block*> &checkpoints = height_it->second;
+
+        checkpoints.erase(std::remove_if(checkpoints.begin(), checkpoints.end(),
+                                         [this, finalized](const Block *checkpoint) { return !IsAncestor(checkpoint, finalized); }),
+                          checkpoints.end());
+
+        if(checkpoints.empty())
+            height_it = m_liveCheckpoints.erase(height_it);
+        else
+            height_it++;
+    }
+}
+
+void
+Blockchain::GasperUpdateEpochBoundaryCheckpoint(const Block *newBlock, const Block *lastFinalizedCheckpoint, int maxBlocksInEpoch)
+{
+    // only the parent of the new block got a new child, so only its state can change
+    Block *parent = GetBlockPointerNonConst(BlockKey(newBlock->GetBlockHeight() - 1, newBlock->GetParentBlockMinerId()));
+    if(parent == nullptr || parent->GetBlockHeight() <= lastFinalizedCheckpoint->GetBlockHeight())
+        return;
+
+    // we are not looking for checkpoints
+    if(parent->GetCasperState() == CHECKPOINT || parent->GetCasperState() == JUSTIFIED_CHKP)
+        return;
 
-            // we are looking for successors of finalized block
-           if(IsAncestor(&(*block_it), finalized))
-           {
-               const std::vector<const Block *> children = GetChildrenPointers(*block_it);
-               if(children.size() < 2)
-                   continue;
-
-               bool childInOtherEpoch = false;
-               int parentEpoch = block_it->GetBlockProposalIteration() / maxBlocksInEpoch;
-               for (auto child : children){
-                   if((child->GetCasperState() == CHECKPOINT
-                       || child->GetCasperState() == JUSTIFIED_CHKP))
-                   {
-                       continue;    // child is already a checkpoint
-                   }
-
-                   // check if child is in other epoch than parent
-                   if(parentEpoch != (child->GetBlockProposalIteration() / maxBlocksInEpoch)) {
-                       childInOtherEpoch = true;
-                       break;
-                   }
-               }
-
-               // if block have at least one not checkpoint child in other epoch, than set this block state to checkpoint
-               if(childInOtherEpoch)
-                   UpdateCountOfBlocks(&(*block_it), CHECKPOINT);
-                   block_it->SetCasperState(CHECKPOINT);
-           }
+    // we are looking for successors of finalized block
+    if(!IsAncestor(parent, lastFinalizedCheckpoint))
+        return;
+
+    const std::vector<const Block *> children = GetChildrenPointers(*parent);
+    if(children.size() < 2)
+        return;
+
+    bool childInOtherEpoch = false;
+    int parentEpoch = parent->GetBlockProposalIteration() / maxBlocksInEpoch;
+    for (auto child : children){
+        if((child->GetCasperState() == CHECKPOINT
+            || child->GetCasperState() == JUSTIFIED_CHKP))
+        {
+            continue;    // child is already a checkpoint
+        }
+
+        // check if child is in other epoch than parent
+        if(parentEpoch != (child->GetBlockProposalIteration() / maxBlocksInEpoch)) {
+            childInOtherEpoch = true;
+            break;
         }
     }
+
+    // if block have at least one not checkpoint child in other epoch, than set this block state to checkpoint
+    if(childInOtherEpoch) {
+        UpdateCountOfBlocks(parent, CHECKPOINT);
+        parent->SetCasperState(CHECKPOINT);
+    }
 }
 
 void
 Blockchain::UpdateCountOfBlocks(const Block *block, CasperState newState, bool add) {
+    bool wasLive = !add && (block->GetCasperState() == CHECKPOINT || block->GetCasperState() == JUSTIFIED_CHKP);
+    bool isLive = newState == CHECKPOINT || newState == JUSTIFIED_CHKP;
+
+    if(wasLive && !isLive) {
+        auto height_it = m_liveCheckpoints.find(block->GetBlockHeight());
+        if(height_it != m_liveCheckpoints.end()) {
+            std::vector<const Block*> &checkpoints = height_it->second;
+            checkpoints.erase(std::remove(checkpoints.begin(), checkpoints.end(), block), checkpoints.end());
+            if(checkpoints.empty())
+                m_liveCheckpoints.erase(height_it);
+        }
+    }
+    else if(!wasLive && isLive && block->GetBlockHeight() > m_lastFinalizedHeight) {
+        m_liveCheckpoints[block->GetBlockHeight()].push_back(block);
+    }
+
     if(!add) {
         switch (block->GetCasperState()) {
             case STD_BLOCK:
@@ -1222,16 +1714,16 @@ std::ostream& operator<< (std::ostream &out, const Block &block)
 std::ostream& operator<< (std::ostream &out, Blockchain &blockchain)
 {
 
-    std::vector< std::vector<Block>>::iterator blockHeight_it;
-    std::vector<Block>::iterator  block_it;
+    std::deque< std::vector<Block*>>::iterator blockHeight_it;
+    std::vector<Block*>::iterator  block_it;
     int i;
 
-    for (blockHeight_it = blockchain.m_blocks.begin(), i = 0; blockHeight_it < blockchain.m_blocks.end(); blockHeight_it++, i++)
+    for (blockHeight_it = blockchain.m_blocks.begin(), i = blockchain.m_prunedHeight; blockHeight_it < blockchain.m_blocks.end(); blockHeight_it++, i++)
     {
         out << "  BLOCK HEIGHT " << i << ":\n";
         for (block_it = blockHeight_it->begin();  block_it < blockHeight_it->end(); block_it++)
         {
-            out << *block_it << "\n";
+            out << **block_it << "\n";
         }
     }
 
@@ -7,6 +7,12 @@
 
 #include <vector>
 #include <map>
+#include <deque>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <string>
+#include <stdint.h>
 #include "ns3/address.h"
 #include <algorithm>
 #include "../../../rapidjson/document.h"
@@ -201,6 +207,132 @@ const char* getBitcoinRegion(enum BitcoinRegion m);
 const char* getMessageName(enum Messages m);
 enum BitcoinRegion getBitcoinEnum(uint32_t n);
 
+/**
+ * Identity of the block (height and miner id) packed into one 64 bit integer. It replaces
+ * the "height/minerId" strings in the containers, the strings are used only in the messages.
+ * Default constructed key (height -1) refers to no block.
+ */
+class BlockKey
+{
+public:
+    BlockKey (void) : m_key (~static_cast<uint64_t>(0)) {}
+    BlockKey (int height, int minerId)
+        : m_key ((static_cast<uint64_t>(static_cast<uint32_t>(height)) << 32) | static_cast<uint32_t>(minerId)) {}
+
+    int GetHeight (void) const { return static_cast<int32_t>(m_key >> 32); }
+    int GetMinerId (void) const { return static_cast<int32_t>(m_key & 0xffffffff); }
+    uint64_t GetValue (void) const { return m_key; }
+    bool IsNull (void) const { return GetHeight() < 0; }
+
+    /**
+     * @return block hash in message format "height/minerId"
+     */
+    std::string ToString (void) const;
+
+    /**
+     * @return chunk hash in message format "height/minerId/chunkId"
+     */
+    std::string ToChunkString (int chunkId) const;
+
+    /**
+     * parses block hash "height/minerId" (chunk hash is accepted too, the chunk id is ignored)
+     */
+    static BlockKey FromString (const char *hash);
+    static BlockKey FromString (const std::string &hash);
+
+    /**
+     * parses chunk hash "height/minerId/chunkId"
+     * @param chunkHash the chunk hash
+     * @param chunkId set to the parsed chunk id
+     */
+    static BlockKey FromChunkString (const std::string &chunkHash, int &chunkId);
+
+    bool operator== (const BlockKey &key) const { return m_key == key.m_key; }
+    bool operator!= (const BlockKey &key) const { return m_key != key.m_key; }
+    bool operator< (const BlockKey &key) const { return m_key < key.m_key; }
+
+private:
+    uint64_t m_key;
+};
+
+std::ostream& operator<< (std::ostream &out, const BlockKey &key);
+
+struct BlockKeyHash
+{
+    size_t operator() (const BlockKey &key) const
+    {
+        // 64 bit finalizer of MurmurHash3, mixes height and miner id into all bits
+        uint64_t x = key.GetValue();
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return static_cast<size_t>(x);
+    }
+};
+
+/**
+ * Hash map keyed by the block key.
+ */
+template <typename T>
+using BlockKeyMap = std::unordered_map<BlockKey, T, BlockKeyHash>;
+
+
+/**
+ * The content of a block which is the same in all the nodes. The copies of a block share one body
+ * and Block copies it before a change when it is shared (copy on write).
+ */
+struct BlockBody
+{
+    BlockBody (void);
+
+    /**
+     * Checks if the body holds the same block as the other body
+     * @param compareBlockId false to ignore the block ids
+     */
+    bool IsSameBlock (const BlockBody &body, bool compareBlockId = true) const;
+
+    int           blockId;                          // The id of the block - random number - used for evaluating lowest VRF proposal in Algorand
+    int           blockHeight;                      // The height of the block
+    int           minerId;                          // The id of the miner which mined this block
+    int           parentBlockMinerId;               // The id of the miner which mined the parent of this block
+    int           blockSizeBytes;                   // The size of the block in bytes
+    double        timeCreated;                      // The time the block was created
+    int           blockProposalIteration;           // The Algorand block proposal iteration number | Also this value is used in Gasper as slot number
+    unsigned char vrfSeed[32];                      // VRF seed created by committee leader in Algorand for generating committee in current round
+    unsigned char participantPublicKey[32];         // public participation key
+    unsigned char vrfOutput[64];                    // output of VRF evaluated in block proposal phase
+    bool          interned;                         // true if the body is in the BlockRegistry, so it must not be changed
+};
+
+
+/**
+ * Process-wide registry of the block bodies, so a block received by all the simulated nodes is kept in the
+ * memory only once. The nodes keep only their own data (time received, sender, casper state) in Block.
+ * The registry doesn't own the bodies, a body is released when no node holds the block anymore and its
+ * expired entry is swept by a later Intern. The registry is not synchronized, it must only be used
+ * from the simulator thread.
+ */
+class BlockRegistry
+{
+public:
+    /**
+     * Gets the interned body of the same block. When there is none, the body becomes the interned one.
+     * @param compareBlockId false if the block id of the body is not meaningful (it's not sent in the bitcoin protocols)
+     * @return the interned body, the body itself if a different block with the same key is interned
+     */
+    static std::shared_ptr<BlockBody> Intern (const std::shared_ptr<BlockBody> &body, bool compareBlockId = true);
+
+private:
+    /**
+     * Removes the entries of the released bodies
+     */
+    static void SweepExpired (void);
+
+    static BlockKeyMap<std::weak_ptr<BlockBody>> m_bodies;     // interned bodies by block key
+    static size_t m_nextSweepSize;                             // the size of m_bodies which triggers the next sweep
+};
+
+
 class Block
 {
 public:
@@ -211,10 +343,13 @@ public:
     Block (const Block &blockSource);  // Copy constructor
     virtual ~Block (void);
 
+    friend class BlockArena;
+
     int GetBlockId (void) const;
     void SetBlockId (int blockId);
 
     std::string GetBlockHash(void) const;
+    BlockKey GetBlockKey(void) const;
 
     int GetBlockHeight (void) const;
     void SetBlockHeight (int blockHeight);
@@ -299,32 +434,161 @@ public:
 
     Block& operator= (const Block &blockSource); //Assignment Constructor
 
+    /**
+     * Shares the body of the block with the same block of the other nodes (see BlockRegistry).
+     * @param compareBlockId false if the block id is not meaningful (it's not sent in the bitcoin protocols)
+     */
+    void Intern (bool compareBlockId = true);
+
     friend bool operator== (const Block &block1, const Block &block2);
     friend std::ostream& operator<< (std::ostream &out, const Block &block);
 
 protected:
-    int           m_blockId;                    // The id of the block - random number - used for evaluating lowest VRF proposal in Algorand
-    int           m_blockHeight;                // The height of the block
-    int           m_minerId;                    // The id of the miner which mined this block
-    int           m_parentBlockMinerId;         // The id of the miner which mined the parent of this block
-    int           m_blockSizeBytes;             // The size of the block in bytes
-    double        m_timeCreated;                // The time the block was created
+    /**
+     * Gets the body for a change, the shared body is copied at first.
+     */
+    BlockBody& GetMutableBody (void);
+
+    std::shared_ptr<BlockBody> m_body;          // The content of the block, shared with the copies of the block
     double        m_timeReceived;               // The time the block was received from the node
     Ipv4Address   m_receivedFromIpv4;           // The Ipv4 of the node which sent the block to the receiving node
 
     enum CasperState m_casperState = STD_BLOCK;     // State of casper blocks
+};
+
+
+/**
+ * Storage of the blocks with stable addresses. The blocks are allocated in chunks of m_chunkSize blocks,
+ * a chunk never grows past its capacity, so a pointer to a block stays valid until the block is freed.
+ * A freed block releases its body at once, the memory of a chunk is released when all its blocks
+ * are freed (the chunk being filled is never released).
+ */
+class BlockArena
+{
+public:
+    BlockArena (void);
+    BlockArena (const BlockArena&) = delete;
+    BlockArena& operator= (const BlockArena&) = delete;
 
-    int           m_blockProposalIteration = 0;     // The Algorand block proposal iteration number - used for evaluating our pseudo VRF | Also this value is used in Gasper as slot number
-//    unsigned int  m_vrfSeed = 0;                // VRF seed created by committee leader in Algorand for generating committee in current round
-    unsigned char m_vrfSeed[32];                // VRF seed created by committee leader in Algorand for generating committee in current round
-    unsigned char m_participantPublicKey[32];         // public participation key
-    unsigned char m_vrfOutput[64];         // public participation key
+    /**
+     * Stores the copy of the block.
+     * @return pointer to the stored block
+     */
+    Block* Allocate (const Block &block);
+
+    /**
+     * Frees the block and releases its body, the pointer must not be used anymore.
+     */
+    void Free (Block *block);
+
+    int GetSize (void) const;
+
+private:
+    static const int                m_chunkSize = 1024;     // number of blocks in one chunk
+
+    std::vector<std::vector<Block>> m_chunks;               // chunks of the blocks, each reserved to m_chunkSize
+    std::vector<int>                m_chunksLive;           // number of not freed blocks in each chunk
+    std::map<const Block*, int>     m_chunksByAddress;      // index of the chunks by the address of their first block
+    int                             m_size;                 // total number of not freed blocks in the arena
+};
+
+
+/**
+ * Casper FFG vote of a voter in an epoch (supermajority link vote source -> target).
+ */
+struct CasperVote
+{
+    BlockKey    source;
+    BlockKey    target;
+    int         sourceHeight;
+    int         targetHeight;
+    int         epoch;
+    int         voterId;
+    int         stake;          // weight of the vote, 1 if the vote doesn't carry a stake
+
+    /**
+     * Extracts the vote from the rapidjson document of the vote message.
+     * @param voterIdKey name of the member with the voter id
+     */
+    static CasperVote FromJSON (const rapidjson::Document *vote, const char *voterIdKey);
+};
+
+
+/**
+ * Running tally of the Casper FFG votes of one epoch, updated when a vote is received,
+ * so the best link is known at any time without going through the votes again.
+ */
+class CasperVoteTally
+{
+public:
+    CasperVoteTally (void);
+
+    /**
+     * Counts the vote.
+     * @return false if the voter has already voted in the epoch (the vote is not counted)
+     */
+    bool AddVote (const CasperVote &vote);
+
+    bool HasVoted (int voterId) const;
+    int GetNoVotes (void) const;
+    int GetTotalWeight (void) const;
+
+    /**
+     * Gets the link with the highest weight, on tie the one with the lowest hash strings (source, target),
+     * the same link as the scan over the votes of the epoch chose. Should be called only if GetNoVotes() > 0.
+     */
+    const std::pair<BlockKey, BlockKey>& GetBestLink (void) const;
+    int GetBestLinkWeight (void) const;
+
+    /**
+     * Marks the best link as justified, so it's not processed again at the epoch boundary.
+     */
+    void SetJustified (void);
+    bool IsJustified (void) const;
+
+private:
+    /**
+     * Compares the links by the hash strings of their blocks (source, target), the order of the ties of the votes
+     * counted in the map keyed by the hash strings.
+     */
+    static bool IsLowerLink (const std::pair<BlockKey, BlockKey> &link1, const std::pair<BlockKey, BlockKey> &link2);
+
+    std::unordered_map<int, CasperVote>            m_votes;             // votes by voter id
+    std::map<std::pair<BlockKey, BlockKey>, int>   m_linkWeights;       // weights of the links (source, target), the order doesn't decide ties
+    std::pair<BlockKey, BlockKey>                  m_bestLink;          // link with the highest weight
+    int                                            m_bestLinkWeight;    // weight of m_bestLink
+    int                                            m_totalWeight;       // weight of all the votes
+    bool                                           m_justified;         // true if the best link was already justified
 };
 
 
 class Blockchain
     {
     public:
+        /**
+         * Walk over the ancestors of a block in the blockchain, from its parent down to the lowest height.
+         * It follows the parent links of the block index, so it doesn't allocate, e.g.
+         * for (Blockchain::AncestorIterator it = blockchain.IterateAncestors(block); it.IsValid(); it.Next())
+         */
+        class AncestorIterator
+        {
+        public:
+            AncestorIterator (const Blockchain *blockchain, const BlockKey &key, int lowestHeight);
+
+            bool IsValid (void) const;
+            void Next (void);
+
+            const BlockKey& GetKey (void) const;
+            const Block* Get (void) const;
+
+        private:
+            void Check (void);
+
+            const Blockchain    *m_blockchain;      // the walked blockchain
+            BlockKey            m_key;              // key of the current ancestor, null key at the end of the walk
+            int                 m_lowestHeight;     // the walk ends below this height
+        };
+
         Blockchain(void);
         virtual ~Blockchain (void);
 
@@ -332,6 +596,30 @@ class Blockchain
 
         int GetNoOrphans (void) const;
 
+        /**
+         * Gets the number of orphans which were evicted from the orphan pool because of its limits.
+         */
+        int GetNoEvictedOrphans (void) const;
+
+        /**
+         * Sets the limits of the orphan pool. When a limit is reached, the oldest orphans are evicted.
+         * @param maxOrphans maximum number of orphans in the pool, 0 for unlimited
+         * @param maxOrphanAge maximum time in seconds an orphan stays in the pool, 0 for unlimited
+         */
+        void SetOrphanLimits (int maxOrphans, double maxOrphanAge);
+
+        /**
+         * Enables pruning of the finalized prefix of the blockchain (Casper/Gasper). When a checkpoint is finalized,
+         * the blocks below the previous finalized checkpoint are removed and only the main chain keys and the statistics
+         * of them are kept. The previous finalized checkpoint is kept, so the pointers to the last finalized epoch stay valid.
+         */
+        void SetPruning (bool pruning);
+
+        /**
+         * Gets the height of the lowest block which is kept in the blockchain, the lower blocks were pruned.
+         */
+        int GetPrunedHeight (void) const;
+
         int GetTotalBlocks (void) const;
         int GetTotalFinalizedBlocks (void) const;
         int GetTotalCheckpoints (void) const;
@@ -342,14 +630,17 @@ class Blockchain
         int GetBlockchainHeight (void) const;
 
         /**
-         * Check if the block has been included in the blockchain.
+         * Check if the block has been included in the blockchain. The pruned blocks of the main chain
+         * are still reported (only their keys are kept), the pruned forks are not.
          */
         bool HasBlock (const Block &newBlock) const;
         bool HasBlock (int height, int minerId) const;
+        bool HasBlock (const BlockKey &key) const;
 
         /**
          * Return the block with the specified height and minerId.
-         * Should be called after HasBlock() to make sure that the block exists.
+         * Should be called after HasBlock() to make sure that the block exists, a pruned block is returned
+         * with the height -1 like a missing one.
          * Returns the orphan blocks too.
          */
         Block ReturnBlock(int height, int minerId);
@@ -359,11 +650,13 @@ class Blockchain
          */
         bool IsOrphan (const Block &newBlock) const;
         bool IsOrphan (int height, int minerId) const;
+        bool IsOrphan (const BlockKey &key) const;
 
         /**
          * Gets a pointer to the block.
          */
         const Block* GetBlockPointer (const Block &newBlock) const;
+        const Block* GetBlockPointer (const BlockKey &key) const;
 
         /**
          * Gets the children of a block that are not orphans.
@@ -380,6 +673,18 @@ class Blockchain
          */
         const std::vector<const Block *> GetAncestorsPointers (const Block &block, int lowestHeight=0);
 
+        /**
+         * Gets the walk over the ancestors of the block in the blockchain, without building the vector of them.
+         * The block itself doesn't have to be in the blockchain.
+         */
+        AncestorIterator IterateAncestors (const Block &block, int lowestHeight=0) const;
+
+        /**
+         * Gets the key of the ancestor of the block at the given height in O(log depth).
+         * @return key of the ancestor, null key if the block or the ancestor is not in the blockchain
+         */
+        BlockKey GetAncestorKey (const BlockKey &key, int height) const;
+
         /**
          * checks if block 'possibleAncestor' is ancestor of block 'block
          * @param block pointer on block which ancestors we are going to check
@@ -389,7 +694,8 @@ class Blockchain
         bool IsAncestor(const Block *block, const Block *possibleAncestor);
 
         /**
-         * returns vector of pointers to blocks which are marked as checkpoints in Casper Protocol which are children of last finalized checkpoint
+         * returns vector of pointers to blocks which are marked as checkpoints in Casper Protocol which are children of last finalized checkpoint,
+         * the checkpoints are taken from the index of the live checkpoints, so the blockchain is not scanned
          * @param lastFinalizedCheckpoint last finalized block
          * @return vector of pointers to blocks which are marked as checkpoints in Casper Protocol
          */
@@ -406,7 +712,7 @@ class Blockchain
         const Block* GetCurrentTopBlock (void) const;
 
         /**
-         * Adds a new block in the blockchain.
+         * Adds a new block in the blockchain, a block with an already added key is ignored.
          */
         void AddBlock (const Block& newBlock);
 
@@ -426,33 +732,51 @@ class Blockchain
         void PrintOrphans (void);
 
         /**
-         * Gets the total number of blocks in forks.
+         * Gets the total number of blocks in forks (blocks at the heights with more than one block).
          */
-        int GetBlocksInForks (void);
+        int GetBlocksInForks (void) const;
 
         /**
-         * Gets the longest fork size
+         * Gets the longest fork size. The first received child of a block continues the branch of its parent,
+         * every other child starts a fork, which is continued by the first received children of its blocks.
          */
-        int GetLongestForkSize (void);
+        int GetLongestForkSize (void) const;
+
+        /**
+         * Gets the total number of forks.
+         */
+        int GetNoForks (void) const;
+
+        /**
+         * Gets the histogram of the fork sizes, the value at index i is the number of forks of size i.
+         */
+        const std::vector<int>& GetForkSizeHistogram (void) const;
+
+        /**
+         * Gets the ratio of the stale blocks to all the blocks added so far.
+         */
+        double GetStaleRate (void) const;
 
         /**
          * updates blocks in blockchain by Casper rules (checkpoint -> justified, justified -> finalized, ...)
-         * @param source hash of source checkpoint
-         * @param target hash of target checkpoint
+         * @param source key of source checkpoint
+         * @param target key of target checkpoint
          * @param lastFinalizedCheckpoint pointer to last finalized checkpoint
          * @param maxBlocksInEpoch count of blocks in one Casper epoch
-         * @param missingBlock sets to missing block hash when source/target block are not in blockchain, otherwise ""
+         * @param missingBlock sets to missing block key when source/target block are not in blockchain, otherwise null key
          * @return pointer to newly finalized finalized, nullptr if no checkpoint was finalized
          */
-        const Block* CasperUpdateBlockchain(std::string source, std::string target,
-                                            const Block *lastFinalizedCheckpoint, int maxBlocksInEpoch, std::string* missingBlock);
+        const Block* CasperUpdateBlockchain(const BlockKey &source, const BlockKey &target,
+                                            const Block *lastFinalizedCheckpoint, int maxBlocksInEpoch, BlockKey* missingBlock);
 
         /**
-         * updating blockchain (from last finalized checkpoint) using Gasper LEBB rule
+         * updating blockchain using Gasper LEBB rule after the block was inserted, only the parent of the block can become
+         * a new epoch boundary checkpoint (if it has a not checkpoint child in other epoch)
+         * @param newBlock pointer to the newly inserted block
          * @param lastFinalizedCheckpoint pointer to last finalized checkpoint
          * @param maxBlocksInEpoch count of blocks in one Casper epoch
          */
-        void GasperUpdateEpochBoundaryCheckpoints(const Block *lastFinalizedCheckpoint, int maxBlocksInEpoch);
+        void GasperUpdateEpochBoundaryCheckpoint(const Block *newBlock, const Block *lastFinalizedCheckpoint, int maxBlocksInEpoch);
 
         void PrintCheckpoints(void);
         friend std::ostream& operator<< (std::ostream &out, Blockchain &blockchain);
@@ -460,7 +784,86 @@ class Blockchain
     private:
 
         /**
-         * updates total count of block/checkpoint, justified/finalized, based on new state of the block and its previous state
+         * The block in m_blockArena and its links to the parent and children blocks.
+         * Entry without block is a placeholder of a block which is not in the blockchain (yet),
+         * it only collects the children which were added before it.
+         */
+        struct BlockIndexEntry
+        {
+            BlockIndexEntry (void) : block (nullptr), forkDepth (0) {}
+
+            Block                   *block;         // the block in m_blockArena, nullptr for placeholder
+            BlockKey                parent;         // key of the parent block (the parent doesn't have to be in the blockchain)
+            BlockKey                skip;           // key of the ancestor at GetSkipHeight(height), null if it was not in the blockchain
+            int                     forkDepth;      // position of the block in its fork, 0 if the block is not in a fork
+            std::vector<BlockKey>   children;       // keys of the children blocks in the blockchain, in order of adding
+        };
+
+        /**
+         * Orphan block stored in the orphan pool.
+         */
+        struct OrphanEntry
+        {
+            OrphanEntry (const Block &orphan, double added) : block (orphan), timeAdded (added) {}
+
+            Block                           block;          // the orphan block
+            double                          timeAdded;      // simulation time in seconds the orphan was added to the pool
+            std::list<BlockKey>::iterator   order;          // position of the orphan in m_orphansOrder
+        };
+
+        /**
+         * Removes the orphan from the orphan pool and from its indexes.
+         */
+        void EraseOrphan (BlockKeyMap<OrphanEntry>::iterator orphan_it);
+
+        /**
+         * Evicts the orphans which are too old and then the oldest orphans, until there is room for a new one.
+         */
+        void EvictOrphans (void);
+
+        /**
+         * Gets the index entry of the block.
+         * @return pointer to the entry, nullptr if the block is not in the blockchain
+         */
+        const BlockIndexEntry* FindIndexEntry (const BlockKey &key) const;
+
+        /**
+         * Gets the height of the skip pointer of a block at the given height. The skip pointers let
+         * GetAncestorKey jump to any ancestor in O(log depth) steps (same scheme as bitcoin core).
+         */
+        static int GetSkipHeight (int height);
+
+        /**
+         * Gets the row of the blocks at the height (the height must not be pruned).
+         */
+        std::vector<Block*>& GetRow (int height);
+
+        /**
+         * Removes the blocks below the checkpoint, only their main chain keys and statistics are kept.
+         * The pointers to the removed blocks become invalid, so the holders of block pointers have to drop
+         * the blocks below the finalized checkpoints when it advances (live checkpoints, Gasper fork choice).
+         * @param checkpoint finalized checkpoint which becomes the lowest kept block of the main chain
+         */
+        void PruneBelow (const Block *checkpoint);
+
+        /**
+         * Removes the index entry of the missing parent of the block, if the parent is below the pruned height.
+         * @param block block whose parent can't be added anymore
+         */
+        void ErasePrunedParent (const Block *block);
+
+        /**
+         * Updates the fork statistics with the block which was added to the blockchain.
+         * @param parentForkDepth fork depth of the parent of the block
+         * @param firstChild true if the block is the first child of its parent in the blockchain
+         * @param rowSize number of blocks at the height of the block, including the block
+         * @return the fork depth of the block
+         */
+        int UpdateForkStats (int parentForkDepth, bool firstChild, int rowSize);
+
+        /**
+         * updates total count of block/checkpoint, justified/finalized, based on new state of the block and its previous state,
+         * also keeps the index of the live checkpoints up to date
          * @param block block in the blockchain, which will be updated
          * @param newState state into which will be block updated (not in this method)
          * @param add true if its newly added block, false if its change of old block
@@ -471,6 +874,7 @@ class Blockchain
          * Gets a pointer to the block.
          */
         Block* GetBlockPointerNonConst (const Block &newBlock);
+        Block* GetBlockPointerNonConst (const BlockKey &key);
 
         /**
          * Gets pointers to all blocks which are ancestors of the block (orphans or not).
@@ -478,13 +882,29 @@ class Blockchain
         std::vector<Block *> GetAncestorsPointersNonConst (const Block &block, int lowestHeight=0);
 
         /**
-         * update finalized checkpoints (JUSTIFIED + JUSTIFIED => FINALIZED + JUSTIFIED)
+         * update finalized checkpoints after the supermajority link source -> target was justified
+         * (JUSTIFIED + link to the JUSTIFIED direct child => FINALIZED + JUSTIFIED),
          * also updates state of blocks which are ancestors of newly finalized checkpoint
          * @param lastFinalizedCheckpoint pointer to last finalized checkpoint
+         * @param source source checkpoint of the new link
+         * @param target target checkpoint of the new link
          * @param maxBlocksInEpoch count of blocks in one Casper epoch
          * @return pointer to newly finalized finalized, nullptr if no checkpoint was finalized
          */
-        const Block* CasperUpdateFinalized(const Block *lastFinalizedCheckpoint, int maxBlocksInEpoch);
+        const Block* CasperUpdateFinalized(const Block *lastFinalizedCheckpoint, const Block *source, const Block *target,
+                                           int maxBlocksInEpoch);
+
+        /**
+         * checks if the supermajority link source -> target finalizes the source
+         * (both checkpoints are justified and the target is the direct child checkpoint of the source)
+         */
+        bool IsFinalizingLink(const Block *source, const Block *target, int maxBlocksInEpoch);
+
+        /**
+         * Removes the live checkpoints which can't descend from the newly finalized checkpoint anymore
+         * @param finalized newly finalized checkpoint
+         */
+        void PruneLiveCheckpoints(const Block *finalized);
 
         int                                m_noStaleBlocks;     //total number of stale blocks
         int                                m_totalBlocks;       //total number of blocks including the genesis block
@@ -493,8 +913,26 @@ class Blockchain
         int                                m_totalNonJustifiedCheckpoints;    //total number of non justified checkpoint
         int                                m_totalFinalizedCheckpoints;       //total number of finalized checkpoint including the genesis block
         int                                m_totalJustifiedCheckpoints;       //total number of justified checkpoint including the genesis block
-        std::vector<std::vector<Block>>    m_blocks;            //2d vector containing all the blocks of the blockchain. (row->blockHeight, col->sibling blocks)
-        std::vector<Block>                 m_orphans;           //vector containing the orphans
+        BlockArena                         m_blockArena;        //storage of the blocks of the blockchain, the addresses of the blocks are stable
+        std::deque<std::vector<Block*>>    m_blocks;            //2d container of pointers to all the not pruned blocks of the blockchain. (row->blockHeight - m_prunedHeight, col->sibling blocks)
+        bool                               m_pruning;           //true if the finalized prefix is pruned
+        int                                m_prunedHeight;      //height of the first row in m_blocks, the lower rows were pruned
+        BlockKey                           m_prunedRoot;        //the lowest kept block of the main chain (finalized checkpoint at m_prunedHeight)
+        std::vector<BlockKey>              m_prunedMainChain;   //keys of the main chain blocks of the pruned rows (index->blockHeight)
+        std::vector<int>                   m_prunedRowSizes;    //number of blocks of the pruned rows (index->blockHeight)
+        int                                m_blocksInForks;     //total number of blocks at the heights with more than one block
+        int                                m_longestFork;       //size of the longest fork
+        std::vector<int>                   m_forkSizes;         //histogram of the fork sizes (index->fork size)
+        BlockKeyMap<OrphanEntry>           m_orphans;           //orphans by block key
+        BlockKeyMap<std::vector<BlockKey>> m_orphansByParent;   //keys of the orphans by the key of their missing parent, in order of adding
+        std::list<BlockKey>                m_orphansOrder;      //keys of the orphans in order of adding (oldest first)
+        int                                m_maxOrphans;        //maximum number of orphans, 0 for unlimited
+        double                             m_maxOrphanAge;      //maximum age of an orphan in seconds, 0 for unlimited
+        int                                m_noEvictedOrphans;  //total number of evicted orphans
+        BlockKeyMap<BlockIndexEntry>       m_blockIndex;        //index of the blocks by block key, with parent/children links
+        std::map<int, std::vector<const Block*>> m_liveCheckpoints; //not finalized checkpoints (CHECKPOINT, JUSTIFIED_CHKP) above the last finalized checkpoint (key->blockHeight)
+        int                                m_lastFinalizedHeight; //height of the last finalized checkpoint
+        BlockKeyMap<std::vector<BlockKey>> m_supermajorityLinks; //targets of the justified supermajority links by the key of their source (only above the last finalized checkpoint)
 
 
     };
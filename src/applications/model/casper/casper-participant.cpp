@@ -13,7 +13,7 @@
 #include "../../rapidjson/writer.h"
 #include "../../rapidjson/stringbuffer.h"
 #include "ns3/socket.h"
-#include "../../libsodium/include/sodium.h"
+#include "ns3/vrf-backend.h"
 #include <iomanip>
 #include <sys/time.h>
 #include <bits/stdc++.h>
@@ -109,7 +109,13 @@ CasperParticipant::GetTypeId(void) {
                            "Set participant to be a failed state",
                            BooleanValue (false),
                            MakeBooleanAccessor (&CasperParticipant::m_isFailed),
-                           MakeBooleanChecker ());
+                           MakeBooleanChecker ())
+            .AddAttribute ("TotalVoteWeight",
+                           "The total weight of the votes in an epoch (number of voters), a link with more than 2/3 of it is justified "
+                           "as soon as the vote arrives. 0 for justifying only by the tally at the epoch boundary",
+                           UintegerValue (0),
+                           MakeUintegerAccessor (&CasperParticipant::m_totalVoteWeight),
+                           MakeUintegerChecker<uint32_t> ());
     return tid;
 }
 
@@ -119,6 +125,7 @@ CasperParticipant::CasperParticipant() : BitcoinMiner(),
 
     m_currentEpoch = 0;
     m_maxBlocksInEpoch = 50;
+    m_totalVoteWeight = 0;
     m_lastFinalized = std::make_pair(0, -1);    // last finalized is genesis block
 
     m_fixedVoteSize = 256; // size of vote in Bytes
@@ -126,7 +133,7 @@ CasperParticipant::CasperParticipant() : BitcoinMiner(),
     // generation of voters secret and public keys
     memset(m_sk, 0, sizeof m_sk);
     memset(m_pk, 0, sizeof m_pk);
-    crypto_vrf_keypair(m_pk, m_sk);
+    VrfBackend::Keypair(m_pk, m_sk);
 }
 
 CasperParticipant::~CasperParticipant(void) {
@@ -227,7 +234,7 @@ void CasperParticipant::HandleCustomRead(rapidjson::Document *document, double r
 }
 
 void
-CasperParticipant::SendRequestForMissingBlock(std::string missingBlockHash, Address *doNotSendTo) {
+CasperParticipant::SendRequestForMissingBlock(const BlockKey &missingBlock, Address *doNotSendTo) {
     rapidjson::Document document;
     rapidjson::Value value;
     document.SetObject();
@@ -235,6 +242,7 @@ CasperParticipant::SendRequestForMissingBlock(std::string missingBlockHash, Addr
     value = CASPER_VOTE;
     document.AddMember("message", value, document.GetAllocator());
 
+    std::string missingBlockHash = missingBlock.ToString();
     value.SetString(missingBlockHash.c_str(), missingBlockHash.size(), document.GetAllocator());
     document.AddMember("hash", value, document.GetAllocator());
 
@@ -255,17 +263,17 @@ CasperParticipant::ProcessReceivedMissingBlock(rapidjson::Document *message, Add
     const Block* ownedBlock = m_blockchain.GetBlockPointer(block);
     if (ownedBlock == nullptr){
         // we don't have it
-        std::string blockHash = block.GetBlockHash();
+        BlockKey blockKey = block.GetBlockKey();
         NS_LOG_INFO(GetNode()->GetId() << " - Received Missing block: " << block);
 
         // add block to blockchain
         m_blockchain.AddBlock(block);
 
         // this is for handling segmentation fault errors caused by removing item while iterating vector
-        std::vector<std::pair<std::string,std::string>> forUpdate;
+        std::vector<std::pair<BlockKey,BlockKey>> forUpdate;
 
         for(auto link : m_unprocessedSupermajorityLinks){
-            if(link.first == blockHash || link.second == blockHash){
+            if(link.first == blockKey || link.second == blockKey){
                 forUpdate.push_back(link);
             }
         }
@@ -273,7 +281,7 @@ CasperParticipant::ProcessReceivedMissingBlock(rapidjson::Document *message, Add
         // remove items which we are going to process in next loop
         m_unprocessedSupermajorityLinks.erase(
                 std::remove_if(m_unprocessedSupermajorityLinks.begin(), m_unprocessedSupermajorityLinks.end(),
-                               [blockHash](std::pair<std::string, std::string> p){return (p.first == blockHash || p.second == blockHash);}),
+                               [blockKey](std::pair<BlockKey, BlockKey> p){return (p.first == blockKey || p.second == blockKey);}),
                 m_unprocessedSupermajorityLinks.end());
 
         // updating with completed links
@@ -284,27 +292,25 @@ CasperParticipant::ProcessReceivedMissingBlock(rapidjson::Document *message, Add
 
 
         // check if someone else wants the block
+        Ptr<Packet> frame;
         for(auto req : m_requestsForBlocks){
-            if(req.first == blockHash && req.second != receivedFrom){
-                // send to peer who requested it too
-                // create json string buffer
-                rapidjson::StringBuffer jsonBuffer;
-                rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-                message->Accept(writer);
-                std::string msg = jsonBuffer.GetString();
+            if(req.first == blockKey && req.second != receivedFrom){
+                // send to peer who requested it too, the block is encoded only for the first one
+                if(!frame)
+                    frame = CreateSharedFrame(MISSING_BLOCK, *message);
 
                 double sendTime = block.GetBlockSizeBytes() / m_uploadSpeed;
                 m_nodeStats->blockSentBytes += block.GetBlockSizeBytes();
 
                 Ipv4Address addr = InetSocketAddress::ConvertFrom(req.second).GetIpv4 ();
-                Simulator::Schedule (Seconds(sendTime), &CasperParticipant::SendMessage, this, NO_MESSAGE, MISSING_BLOCK, msg, m_peersSockets[addr]);
+                Simulator::Schedule (Seconds(sendTime), &CasperParticipant::SendSharedFrame, this, MISSING_BLOCK, frame, m_peersSockets[addr]);
             }
         }
 
         // remove processed requests from vector
         m_requestsForBlocks.erase(
                 std::remove_if(m_requestsForBlocks.begin(), m_requestsForBlocks.end(),
-                               [blockHash](std::pair<std::string, Address> p){return p.first == blockHash;}),
+                               [blockKey](std::pair<BlockKey, Address> p){return p.first == blockKey;}),
                 m_requestsForBlocks.end());
     }else{
         NS_LOG_INFO(GetNode()->GetId() << " - Already have Missing block: " << block);
@@ -314,20 +320,14 @@ CasperParticipant::ProcessReceivedMissingBlock(rapidjson::Document *message, Add
 
 void
 CasperParticipant::ProcessReceivedRequestForMissingBlock(rapidjson::Document *message, Address receivedFrom) {
-    std::string blockHash = (*message)["hash"].GetString();
+    BlockKey blockKey = BlockKey::FromString((*message)["hash"].GetString());
 
     for(auto req : m_requestsForBlocks){
-        if(req.first == blockHash && req.second == receivedFrom)
+        if(req.first == blockKey && req.second == receivedFrom)
             return; // already get this request
     }
 
-    std::string   delimiter = "/";
-    size_t        pos = blockHash.find(delimiter);
-
-    int height = atoi(blockHash.substr(0, pos).c_str());
-    int minerId = atoi(blockHash.substr(pos+1, blockHash.size()).c_str());
-    Block blockTemplate(height, minerId, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
-    const Block* blockPtr = m_blockchain.GetBlockPointer(blockTemplate);
+    const Block* blockPtr = m_blockchain.GetBlockPointer(blockKey);
 
     if(blockPtr != nullptr){
         // Convert block to rapidjson document and broadcast the block
@@ -336,19 +336,15 @@ CasperParticipant::ProcessReceivedRequestForMissingBlock(rapidjson::Document *me
         rapidjson::Value value;
         document["type"] = BLOCK;
 
-        // create json string buffer
-        rapidjson::StringBuffer jsonBuffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-        document.Accept(writer);
-        std::string msg = jsonBuffer.GetString();
+        Ptr<Packet> frame = CreateSharedFrame(MISSING_BLOCK, document);
 
         double sendTime = block.GetBlockSizeBytes() / m_uploadSpeed;
         m_nodeStats->blockSentBytes += block.GetBlockSizeBytes();
         Ipv4Address addr = InetSocketAddress::ConvertFrom(receivedFrom).GetIpv4 ();
-        Simulator::Schedule (Seconds(sendTime), &CasperParticipant::SendMessage, this, NO_MESSAGE, MISSING_BLOCK, msg, m_peersSockets[addr]);
+        Simulator::Schedule (Seconds(sendTime), &CasperParticipant::SendSharedFrame, this, MISSING_BLOCK, frame, m_peersSockets[addr]);
     }else{
-        m_requestsForBlocks.push_back(std::make_pair(blockHash, receivedFrom));
-        SendRequestForMissingBlock(blockHash, &receivedFrom);
+        m_requestsForBlocks.push_back(std::make_pair(blockKey, receivedFrom));
+        SendRequestForMissingBlock(blockKey, &receivedFrom);
     }
 }
 
@@ -358,11 +354,8 @@ void CasperParticipant::AdvertiseVote(enum Messages messageType, rapidjson::Docu
     int count = 0;
     double sendTime;
 
-    // create json string buffer
-    rapidjson::StringBuffer jsonBuffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-    d.Accept(writer);
-    std::string msg = jsonBuffer.GetString();
+    // encode the message only once, all peers share the same frame
+    Ptr<Packet> frame = CreateSharedFrame(messageType, d);
 
     // sending to each peer in node list
     for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
@@ -390,19 +383,12 @@ void CasperParticipant::AdvertiseVote(enum Messages messageType, rapidjson::Docu
             }
         }
         count++;
-        Simulator::Schedule (Seconds(sendTime), &CasperParticipant::SendMessage, this, NO_MESSAGE, messageType, msg, m_peersSockets[*i]);
+        Simulator::Schedule (Seconds(sendTime), &CasperParticipant::SendSharedFrame, this, messageType, frame, m_peersSockets[*i]);
     }
 
     NS_LOG_INFO(GetNode()->GetId() << " - advertised msg to " << count << " nodes.");
 }
 
-void
-CasperParticipant::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, std::string d, Ptr<Socket> outgoingSocket){
-    rapidjson::Document msg;
-    msg.Parse(d.c_str());
-    BitcoinNode::SendMessage(receivedMessage, responseMessage, msg, outgoingSocket);
-}
-
 void
 CasperParticipant::InformAboutState() {
     if(GetNode()->GetId() == 1){
@@ -448,57 +434,52 @@ CasperParticipant::InsertBlockToBlockchain(Block &newBlock) {
 void
 CasperParticipant::TallyingAndBlockchainUpdate() {
     // skipping zeroth epoch (there is only genesis)
-    if(m_currentEpoch == 0 || m_votes.size() < m_currentEpoch)
+    if(m_currentEpoch == 0 || (int) m_voteTallies.size() < m_currentEpoch)
         return;
 
-    int totalVotes = m_votes.at(m_currentEpoch - 1).size();
-    if(totalVotes == 0)
+    CasperVoteTally &tally = m_voteTallies.at(m_currentEpoch - 1);
+    int totalVotes = tally.GetNoVotes();
+    if(totalVotes == 0 || tally.IsJustified())
         return;
 
-    // key is (source hash, target hash), value is count of votes
-    std::map<std::pair<std::string, std::string>, int> voteCounter;
-    for(auto vote : m_votes.at(m_currentEpoch - 1)){
-        rapidjson::Document d;
-        d.Parse(vote.second.c_str());
-
-        std::pair<std::string, std::string> sourceTarget = std::make_pair(d["s"].GetString(), d["t"].GetString());
-
-        std::map<std::pair<std::string, std::string>, int>::iterator item = voteCounter.find(sourceTarget);
-        if (item == voteCounter.end()) {
-            voteCounter.insert({ sourceTarget, 1 });
-        }else{
-            item->second = item->second + 1;
-        }
-    }
-
-    // find the one with most votes
-    std::pair<std::string, std::string> bestVote = voteCounter.begin()->first;
-    int maxVotes = voteCounter.begin()->second;
-    for(auto vote : voteCounter){
-        if(vote.second > maxVotes){
-            maxVotes = vote.second;
-            bestVote = vote.first;
-        }
-    }
+    // the link with most votes is kept by the running tally
+    std::pair<BlockKey, BlockKey> bestVote = tally.GetBestLink();
+    int maxVotes = tally.GetBestLinkWeight();
 
     // if quorum reached update blockchain (checkpoints, if finality reached even blocks)
     if(maxVotes >  (2 * (totalVotes / 3))){
         NS_LOG_INFO(GetNode()->GetId() << " - EPOCH n." << m_currentEpoch << " quorum for s: " << bestVote.first << ", t: " << bestVote.second << " VOTES " << maxVotes << " out of total " << totalVotes);
+        tally.SetJustified();
         UpdateBlockchain(bestVote.first, bestVote.second);
     }
 }
 
 void
-CasperParticipant::UpdateBlockchain(std::string source, std::string target) {
+CasperParticipant::CheckSupermajority(int epoch) {
+    if(m_totalVoteWeight == 0)
+        return;
+
+    CasperVoteTally &tally = m_voteTallies.at(epoch - 1);
+    if(tally.IsJustified() || tally.GetBestLinkWeight() <= (int) (2 * (m_totalVoteWeight / 3)))
+        return;
+
+    std::pair<BlockKey, BlockKey> bestVote = tally.GetBestLink();
+    NS_LOG_INFO(GetNode()->GetId() << " - EPOCH n." << epoch << " supermajority for s: " << bestVote.first << ", t: " << bestVote.second << " VOTES " << tally.GetBestLinkWeight() << " out of " << m_totalVoteWeight);
+    tally.SetJustified();
+    UpdateBlockchain(bestVote.first, bestVote.second);
+}
+
+void
+CasperParticipant::UpdateBlockchain(const BlockKey &source, const BlockKey &target) {
     Block lastFinalizedCheckpoint(m_lastFinalized.first, m_lastFinalized.second, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
-    std::string missingBlock = "";
+    BlockKey missingBlock;
     const Block * newlyFinalized = m_blockchain.CasperUpdateBlockchain(source, target,
                                                                        &lastFinalizedCheckpoint, m_maxBlocksInEpoch, &missingBlock);
 
     // update information about last finalized checkpoint
     if(newlyFinalized != nullptr){
         m_lastFinalized = std::make_pair(newlyFinalized->GetBlockHeight(), newlyFinalized->GetMinerId());
-    }else if(missingBlock != ""){
+    }else if(!missingBlock.IsNull()){
         // block is missing in blockchain, so we request peers for it
         m_unprocessedSupermajorityLinks.push_back(std::make_pair(source, target));
         SendRequestForMissingBlock(missingBlock);
@@ -575,7 +556,6 @@ CasperParticipant::FindBestLink() {
 
         // target should be lowest checkpoint in chain of highest epoch
         const Block* target = highest;
-        std::vector<const Block*> highestAncestors = m_blockchain.GetAncestorsPointers(*highest, m_lastFinalized.first);
         bool found = false;
         for(int height = 0; height <= highestRelativeHeight; height++){
             if(possibleTargets.size() >= (height + 1)) {
@@ -594,7 +574,6 @@ CasperParticipant::FindBestLink() {
 
         // choosing source - highest justified checkpoint in targets chain
         const Block* source = newCheckpoints.at(0);
-        std::vector<const Block*> targetsAncestors = m_blockchain.GetAncestorsPointers(*target, m_lastFinalized.first);
         for(int height = possibleSources.size() - 1; height >= 0; height--){
             if(possibleSources.at(height).size() != 0) {
                 const Block* possibleSource = possibleSources.at(height).at(0);
@@ -663,30 +642,19 @@ CasperParticipant::Vote() {
 
 bool
 CasperParticipant::SaveVoteToBuffer(rapidjson::Document *vote) {
-    int epoch = (*vote)["epoch"].GetInt();
-    int voterId = (*vote)["pId"].GetInt();
-
-    // resize vector of votes if needed
-    if(m_votes.size() < epoch)
-        m_votes.resize(epoch);
-
-    // search for vote from the voter in the epoch
-    if (m_votes.at(epoch-1).find(voterId) == m_votes.at(epoch-1).end() ) {
-        // not found
-        // create json string buffer
-        rapidjson::StringBuffer jsonBuffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-        vote->Accept(writer);
-
-        // insert vote (serialized json) to vote buffer
-        m_votes.at(epoch-1).insert({ voterId, jsonBuffer.GetString() });
-        return true;
-    } else {
-        // found
+    CasperVote casperVote = CasperVote::FromJSON(vote, "pId");
+
+    // resize vector of tallies if needed
+    if((int) m_voteTallies.size() < casperVote.epoch)
+        m_voteTallies.resize(casperVote.epoch);
+
+    // count the vote if the voter has not voted in the epoch yet
+    if(!m_voteTallies.at(casperVote.epoch - 1).AddVote(casperVote))
         return false;
-    }
-}
 
+    CheckSupermajority(casperVote.epoch);
+    return true;
+}
 
 void CasperParticipant::ProcessReceivedCasperVote(rapidjson::Document *message, Address receivedFrom) {
     NS_LOG_FUNCTION(this);
@@ -42,15 +42,6 @@ protected:
 
     virtual void DoDispose (void);
 
-    /**
-     * \brief Sends a message to a peer
-     * \param receivedMessage the type of the received message
-     * \param responseMessage the type of the response message
-     * \param d the stringified rapidjson document containing the info of the outgoing message
-     * \param outgoingSocket the socket of the peer
-     */
-    void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, std::string d, Ptr<Socket> outgoingSocket);
-
 
     /**
      * \brief replacement of parent mining event with empty method
@@ -108,12 +99,18 @@ protected:
     void ProcessReceivedCasperVote(rapidjson::Document *message, Address receivedFrom);
 
     /**
-     * inserts vote to vote buffer if it is not already inside
+     * counts vote in the tally of its epoch if it is not already counted
      * @param vote rapidjson document containing the vote
      * @return true if vote was inserted, false if vote is already in buffer
      */
     bool SaveVoteToBuffer(rapidjson::Document *vote);
 
+    /**
+     * justifies the best link of the epoch as soon as it has more than 2/3 of the total vote weight (if it is set)
+     * @param epoch epoch of the tally
+     */
+    void CheckSupermajority(int epoch);
+
     /**
      * prints actual state on stderr
      */
@@ -121,10 +118,10 @@ protected:
 
     /**
      * send request for missing block to peers
-     * @param missingBlockHash hash of requested missing block
+     * @param missingBlock key of requested missing block
      * @param doNotSendTo pointer to address of peer to which we should not send the message, default nullptr (send to all)
      */
-    void SendRequestForMissingBlock(std::string missingBlockHash, Address *doNotSendTo = nullptr);
+    void SendRequestForMissingBlock(const BlockKey &missingBlock, Address *doNotSendTo = nullptr);
 
     /**
     * processing of received message with request for missing block
@@ -145,7 +142,7 @@ protected:
      * @param source source checkpoint of link
      * @param target target checkpoint of link
      */
-    void UpdateBlockchain(std::string source, std::string target);
+    void UpdateBlockchain(const BlockKey &source, const BlockKey &target);
 
     void GenNextBlockSize();
 
@@ -157,10 +154,11 @@ protected:
     int m_maxBlocksInEpoch;                             // maximum blocks in one epoch (Ethereum is using 50 blocks)
     int m_currentEpoch;                                 // number of actual epoch in which is participant voting
     std::pair<int, int> m_lastFinalized;                // info about last finalized checkpoint (block height and minerId)
-    std::vector<std::map<int, std::string>> m_votes;    // buffer containing votes for each epoch (map key is voter id, value is serialized vote JSON)
+    std::vector<CasperVoteTally> m_voteTallies;         // running tallies of the votes for each epoch
+    uint32_t m_totalVoteWeight;                         // total weight of the votes in an epoch for the early justification, 0 if disabled
 
-    std::vector<std::pair<std::string, Address>> m_requestsForBlocks;   // buffer containing requests for missing block (missing block has, peer who sent request)
-    std::vector<std::pair<std::string, std::string>> m_unprocessedSupermajorityLinks;   // buffer containing links which reach quorum, but one of blocks were missing (source hash, target hash)
+    std::vector<std::pair<BlockKey, Address>> m_requestsForBlocks;   // buffer containing requests for missing block (missing block key, peer who sent request)
+    std::vector<std::pair<BlockKey, BlockKey>> m_unprocessedSupermajorityLinks;   // buffer containing links which reach quorum, but one of blocks were missing (source key, target key)
 
     //debug
     double       m_timeStart;
@@ -0,0 +1,170 @@
+/**
+* Implementation of GasperForkChoice class
+*/
+
+#include "gasper-fork-choice.h"
+
+namespace ns3 {
+
+GasperForkChoice::GasperForkChoice (Blockchain &blockchain) : m_blockchain(blockchain), m_dirty(false), m_detached(false)
+{
+}
+
+void
+GasperForkChoice::OnBlock (const Block *block)
+{
+    // the store is built on the first FindHead
+    if(m_nodes.empty() || block->GetBlockHeight() <= m_nodes.front().block->GetBlockHeight())
+        return;
+
+    BlockKey parentKey(block->GetBlockHeight() - 1, block->GetParentBlockMinerId());
+    auto parent_it = m_indices.find(parentKey);
+
+    // the parent is not a descendant of the root or it is still missing (then the block is found by the rebuild)
+    if(parent_it == m_indices.end())
+        return;
+
+    AppendNode(block, parent_it->second);
+
+    // children received before the block (e.g. as missing blocks) are not in the store
+    if(!m_blockchain.GetChildrenPointers(*block).empty())
+        m_detached = true;
+}
+
+void
+GasperForkChoice::OnAttestation (int voterId, int slot, const Block *block, int stake)
+{
+    auto message_it = m_latestMessages.find(voterId);
+
+    if(message_it != m_latestMessages.end()) {
+        LatestMessage &message = message_it->second;
+
+        // only the latest attest of the voter is counted
+        if(slot <= message.slot)
+            return;
+
+        if(message.node != -1) {
+            m_deltas[message.node] -= message.stake;
+            m_dirty = true;
+        }
+    }
+
+    LatestMessage &message = m_latestMessages[voterId];
+    message.slot = slot;
+    message.key = block->GetBlockKey();
+    message.stake = stake;
+
+    auto index_it = m_indices.find(message.key);
+    message.node = index_it != m_indices.end() ? index_it->second : -1;
+
+    if(message.node != -1) {
+        m_deltas[message.node] += stake;
+        m_dirty = true;
+    }
+}
+
+const Block*
+GasperForkChoice::FindHead (const Block *justified)
+{
+    auto index_it = m_indices.find(justified->GetBlockKey());
+
+    if(index_it == m_indices.end())
+        Rebuild(justified);
+    else if(m_detached)
+        Rebuild(m_nodes.front().block);
+
+    ApplyDeltas();
+
+    return m_nodes[m_nodes[m_indices[justified->GetBlockKey()]].bestDescendant].block;
+}
+
+void
+GasperForkChoice::Prune (const Block *finalized)
+{
+    Rebuild(finalized);
+}
+
+int
+GasperForkChoice::GetSize (void) const
+{
+    return m_nodes.size();
+}
+
+void
+GasperForkChoice::Rebuild (const Block *root)
+{
+    m_nodes.clear();
+    m_indices.clear();
+    m_deltas.clear();
+
+    // breadth first, so every parent is placed before its children
+    AppendNode(root, -1);
+    for(int i = 0; i < (int) m_nodes.size(); i++) {
+        for(auto child : m_blockchain.GetChildrenPointers(*m_nodes[i].block))
+            AppendNode(child, i);
+    }
+
+    // count the latest attests again
+    for(auto &voter : m_latestMessages) {
+        LatestMessage &message = voter.second;
+        auto index_it = m_indices.find(message.key);
+
+        message.node = index_it != m_indices.end() ? index_it->second : -1;
+        if(message.node != -1)
+            m_deltas[message.node] += message.stake;
+    }
+
+    m_dirty = true;
+    m_detached = false;
+}
+
+void
+GasperForkChoice::AppendNode (const Block *block, int parent)
+{
+    ProtoNode node;
+    node.block = block;
+    node.parent = parent;
+    node.weight = 0;
+    node.bestChild = -1;
+    node.bestDescendant = m_nodes.size();
+
+    m_indices[block->GetBlockKey()] = m_nodes.size();
+    m_nodes.push_back(node);
+    m_deltas.push_back(0);
+    m_dirty = true;
+}
+
+void
+GasperForkChoice::ApplyDeltas (void)
+{
+    if(!m_dirty)
+        return;
+
+    for(int i = 0; i < (int) m_nodes.size(); i++) {
+        m_nodes[i].bestChild = -1;
+        m_nodes[i].bestDescendant = i;
+    }
+
+    // children are behind their parents, so every node is final when its parent is updated
+    for(int i = m_nodes.size() - 1; i >= 0; i--) {
+        ProtoNode &node = m_nodes[i];
+        node.weight += m_deltas[i];
+
+        if(node.parent != -1) {
+            ProtoNode &parent = m_nodes[node.parent];
+            m_deltas[node.parent] += m_deltas[i];
+
+            // on tie the first received child (lower index) wins
+            if(parent.bestChild == -1 || node.weight >= m_nodes[parent.bestChild].weight) {
+                parent.bestChild = i;
+                parent.bestDescendant = node.bestDescendant;
+            }
+        }
+
+        m_deltas[i] = 0;
+    }
+
+    m_dirty = false;
+}
+
+} // ns3 namespace
@@ -0,0 +1,105 @@
+/**
+ * GasperForkChoice class declarations
+ */
+
+#ifndef SIMPOS_GASPER_FORK_CHOICE_H
+#define SIMPOS_GASPER_FORK_CHOICE_H
+
+#include "ns3/blockchain.h"
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Fork choice store of the Hybrid LMD GHOST rule in the style of proto-array. The blocks above the root
+ * (last finalized checkpoint) are kept in a flat array in which every parent is placed before its children,
+ * so the subtree weights and the best descendants are updated by one backward pass over the array.
+ * Only the latest attest of every voter is counted, a newer attest moves the stake of the voter by a delta,
+ * which is applied lazily when the head is requested.
+ */
+class GasperForkChoice
+{
+public:
+    explicit GasperForkChoice (Blockchain &blockchain);
+
+    /**
+     * adds the block which was inserted to the blockchain
+     * @param block pointer to the block in the blockchain
+     */
+    void OnBlock (const Block *block);
+
+    /**
+     * counts the attest if it is the latest one of the voter
+     * @param voterId id of the voter
+     * @param slot slot (block proposal iteration) of the attest
+     * @param block pointer to the attested block in the blockchain
+     * @param stake stake of the voter
+     */
+    void OnAttestation (int voterId, int slot, const Block *block, int stake);
+
+    /**
+     * finds the head by the Hybrid LMD GHOST rule: walking from the justified checkpoint to the child
+     * with the highest subtree weight (the first received one on tie)
+     * @param justified highest justified checkpoint
+     * @return pointer to the head block
+     */
+    const Block* FindHead (const Block *justified);
+
+    /**
+     * removes the blocks which are not descendants of the finalized checkpoint
+     * @param finalized newly finalized checkpoint, becomes the new root
+     */
+    void Prune (const Block *finalized);
+
+    /**
+     * Gets the number of blocks in the store
+     */
+    int GetSize (void) const;
+
+private:
+    struct ProtoNode
+    {
+        const Block    *block;
+        int             parent;             // index of the parent, -1 for the root
+        int64_t         weight;             // stake of the latest attests for the block and its descendants
+        int             bestChild;          // index of the child with the highest weight, -1 for a leaf
+        int             bestDescendant;     // index of the leaf reached by following the best children
+    };
+
+    struct LatestMessage
+    {
+        int             slot;
+        BlockKey        key;
+        int             node;               // index of the attested block, -1 if it is not in the store
+        int             stake;
+    };
+
+    /**
+     * rebuilds the store from the subtree of the root in the blockchain, the latest attests are counted again
+     */
+    void Rebuild (const Block *root);
+
+    /**
+     * appends the block to the array, its parent has to be in the array already
+     */
+    void AppendNode (const Block *block, int parent);
+
+    /**
+     * applies the pending deltas to the weights and updates the best children and descendants
+     */
+    void ApplyDeltas (void);
+
+    Blockchain                               &m_blockchain;
+    std::vector<ProtoNode>                    m_nodes;              // blocks above the root, parents before children
+    BlockKeyMap<int>                          m_indices;            // index of the node by block key
+    std::vector<int64_t>                      m_deltas;             // pending weight changes (index->node)
+    std::unordered_map<int, LatestMessage>    m_latestMessages;     // latest attest by voter id
+    bool                                      m_dirty;              // true if the weights or the tree changed since the last ApplyDeltas
+    bool                                      m_detached;           // true if a block was inserted before its parent, the store has to be rebuilt
+};
+
+} // ns3 namespace
+
+#endif //SIMPOS_GASPER_FORK_CHOICE_H
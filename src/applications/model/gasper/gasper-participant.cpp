@@ -12,6 +12,11 @@
 #include "ns3/socket.h"
 #include "ns3/uinteger.h"
 #include "ns3/simulator.h"
+#include "ns3/vrf-verify-cache.h"
+#include "ns3/vrf-backend.h"
+#include "ns3/batch-vrf-prover.h"
+#include "ns3/vrf-key-pool.h"
+#include "ns3/stake-sortition.h"
 #include <algorithm>
 #include <utility>
 #include "../../libsodium/include/sodium.h"
@@ -71,11 +76,27 @@ GasperParticipant::GetTypeId(void) {
                            BooleanValue (false),
                            MakeBooleanAccessor (&GasperParticipant::m_isFailed),
                            MakeBooleanChecker ())
+            .AddAttribute ("TotalVoteWeight",
+                           "The total stake of the votes in an epoch, a link with more than 2/3 of it is justified "
+                           "as soon as the vote arrives. 0 for justifying only by the tally at the epoch boundary",
+                           UintegerValue (0),
+                           MakeUintegerAccessor (&GasperParticipant::m_totalVoteWeight),
+                           MakeUintegerChecker<uint32_t> ())
+            .AddAttribute ("SortitionCommitteeSize",
+                           "Expected weight of the attest committee selected by the stake weighted sortition (0 for the VRF threshold)",
+                           UintegerValue (0),
+                           MakeUintegerAccessor (&GasperParticipant::m_sortitionCommitteeSize),
+                           MakeUintegerChecker<uint32_t> ())
+            .AddAttribute ("SortitionTotalStake",
+                           "Total stake of all participants for the stake weighted sortition",
+                           UintegerValue (0),
+                           MakeUintegerAccessor (&GasperParticipant::m_sortitionTotalStake),
+                           MakeUintegerChecker<uint64_t> ())
                             ;
     return tid;
 }
 
-GasperParticipant::GasperParticipant() : GasperNode(),
+GasperParticipant::GasperParticipant() : GasperNode(), m_forkChoice(m_blockchain),
                                m_timeStart(0), m_timeFinish(0) {
     NS_LOG_FUNCTION(this);
     std::random_device rd;
@@ -86,7 +107,8 @@ GasperParticipant::GasperParticipant() : GasperNode(),
     memset(m_pk, 0, sizeof m_pk);
     memset(m_vrfProof, 0, sizeof m_vrfProof);
     memset(m_vrfOut, 0, sizeof m_vrfOut);
-    crypto_vrf_keypair(m_pk, m_sk);
+    if (!VrfKeyPool::GetInstance().IsEnabled())
+        VrfBackend::Keypair(m_pk, m_sk);
 
     if (m_fixedBlockSize > 0)
         m_nextBlockSize = m_fixedBlockSize;
@@ -102,12 +124,16 @@ GasperParticipant::GasperParticipant() : GasperNode(),
 
     m_chosenToCommitteeTimes = 0;
     m_averageStakeSize = 0;
+    m_sortitionCommitteeSize = 0;
+    m_sortitionTotalStake = 0;
+    m_sortition = nullptr;
 
     m_iterationBP = 0;
     m_iterationAttest = 0;
 
     m_currentEpoch = 1;
     m_maxBlocksInEpoch = 64;
+    m_totalVoteWeight = 0;
     m_lastFinalized = std::make_pair(0, -1);    // last finalized is genesis block
 }
 
@@ -138,6 +164,13 @@ void GasperParticipant::StartApplication() {
     NS_LOG_FUNCTION(this);
     GasperNode::StartApplication ();
 
+    // participant i takes the key i of the pool, the node id is not known in the constructor
+    if (VrfKeyPool::GetInstance().IsEnabled())
+        VrfKeyPool::GetInstance().GetKeypair(GetNode()->GetId(), m_pk, m_sk);
+
+    if (m_sortitionCommitteeSize > 0)
+        m_sortition = StakeSortition::Get(m_sortitionCommitteeSize, m_sortitionTotalStake);
+
     m_nodeStats->isFailed = m_isFailed;
     m_nodeStats->miner = 1;
     m_nodeStats->voteSentBytes = 0;
@@ -205,6 +238,7 @@ void GasperParticipant::StartApplication() {
 
     // scheduling gasper events
     m_nextBlockProposalEvent = Simulator::Schedule (Seconds(m_intervalAttest), &GasperParticipant::BlockProposalPhase, this);
+    BatchVrfProver::GetInstance().Expect(Simulator::Now() + Seconds(m_intervalAttest), m_sk);
     NS_LOG_INFO("Node " << GetNode()->GetId() << ": scheduled block proposal");
 }
 
@@ -235,6 +269,10 @@ void GasperParticipant::StopApplication() {
         std::cout << "chosen to attest committee (times) = " << m_chosenToCommitteeTimes << std::endl;
         std::cout << "avg BP committee size = " << m_nodeStats->meanBPCommitteeSize << std::endl;
         std::cout << "failed = " << (m_isFailed ? "true" : "false") << std::endl;
+        std::cout << "duplicate BP/attest messages = " << m_seenMessages.GetDuplicateRate(BLOCK_PROPOSAL)
+                  << " / " << m_seenMessages.GetDuplicateRate(ATTEST) << std::endl;
+        std::cout << "VRF verify cache hits/misses (process) = " << VrfVerifyCache::GetInstance().GetNoHits()
+                  << " / " << VrfVerifyCache::GetInstance().GetNoMisses() << std::endl;
 
         std::cout << m_blockchain << std::endl;
     }
@@ -250,8 +288,8 @@ int GasperParticipant::GetAvgCommitteeSize(bool blockProposal) {
     int count = 0;
 
     if(!blockProposal) {
-        for (auto attests: m_votes) {
-            total += attests.size();
+        for (auto &tally: m_voteTallies) {
+            total += tally.GetNoVotes();
             count++;
         }
     }else{
@@ -293,6 +331,17 @@ void GasperParticipant::GenNextStakeSize() {
     }
 }
 
+bool GasperParticipant::IsAttestChosen(const unsigned char *vrfOut, rapidjson::Document *message) {
+    if (!m_sortition)
+        return memcmp(vrfOut, m_vrfThreshold, 64) <= 0;
+
+    // the weight of the attest has to match the sub-users selected from the stake of the voter
+    if (!message->HasMember("balance"))
+        return false;
+    uint32_t votes = (*message)["stake"].GetUint();
+    return votes > 0 && m_sortition->Select(vrfOut, (*message)["balance"].GetUint()) == votes;
+}
+
 void GasperParticipant::HandleCustomRead(rapidjson::Document *document, double receivedTime, Address receivedFrom) {
     NS_LOG_FUNCTION(this);
 
@@ -320,7 +369,7 @@ void GasperParticipant::HandleCustomRead(rapidjson::Document *document, double r
 }
 
 void
-GasperParticipant::SendRequestForMissingBlock(std::string missingBlockHash, Address *doNotSendTo) {
+GasperParticipant::SendRequestForMissingBlock(const BlockKey &missingBlock, Address *doNotSendTo) {
     rapidjson::Document document;
     rapidjson::Value value;
     document.SetObject();
@@ -328,6 +377,7 @@ GasperParticipant::SendRequestForMissingBlock(std::string missingBlockHash, Addr
     value = CASPER_VOTE;
     document.AddMember("message", value, document.GetAllocator());
 
+    std::string missingBlockHash = missingBlock.ToString();
     value.SetString(missingBlockHash.c_str(), missingBlockHash.size(), document.GetAllocator());
     document.AddMember("hash", value, document.GetAllocator());
 
@@ -348,17 +398,24 @@ GasperParticipant::ProcessReceivedMissingBlock(rapidjson::Document *message, Add
     const Block* ownedBlock = m_blockchain.GetBlockPointer(block);
     if (ownedBlock == nullptr){
         // we don't have it
-        std::string blockHash = block.GetBlockHash();
+        BlockKey blockKey = block.GetBlockKey();
         NS_LOG_INFO(GetNode()->GetId() << " - Received Missing block: " << block);
 
         // add block to blockchain
         m_blockchain.AddBlock(block);
+        const Block *insertedBlock = m_blockchain.GetBlockPointer(blockKey);
+        if(insertedBlock != nullptr) {
+            Block lastFinalizedCheckpoint(m_lastFinalized.first, m_lastFinalized.second, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
+
+            m_blockchain.GasperUpdateEpochBoundaryCheckpoint(insertedBlock, &lastFinalizedCheckpoint, m_maxBlocksInEpoch);
+            m_forkChoice.OnBlock(insertedBlock);
+        }
 
         // this is for handling segmentation fault errors caused by removing item while iterating vector
-        std::vector<std::pair<std::string,std::string>> forUpdate;
+        std::vector<std::pair<BlockKey,BlockKey>> forUpdate;
 
         for(auto link : m_unprocessedSupermajorityLinks){
-            if(link.first == blockHash || link.second == blockHash){
+            if(link.first == blockKey || link.second == blockKey){
                 forUpdate.push_back(link);
             }
         }
@@ -366,7 +423,7 @@ GasperParticipant::ProcessReceivedMissingBlock(rapidjson::Document *message, Add
         // remove items which we are going to process in next loop
         m_unprocessedSupermajorityLinks.erase(
                 std::remove_if(m_unprocessedSupermajorityLinks.begin(), m_unprocessedSupermajorityLinks.end(),
-                               [blockHash](std::pair<std::string, std::string> p){return (p.first == blockHash || p.second == blockHash);}),
+                               [blockKey](std::pair<BlockKey, BlockKey> p){return (p.first == blockKey || p.second == blockKey);}),
                 m_unprocessedSupermajorityLinks.end());
 
         // updating with completed links
@@ -377,27 +434,25 @@ GasperParticipant::ProcessReceivedMissingBlock(rapidjson::Document *message, Add
 
 
         // check if someone else wants the block
+        Ptr<Packet> frame;
         for(auto req : m_requestsForBlocks){
-            if(req.first == blockHash && req.second != receivedFrom){
-                // send to peer who requested it too
-                // create json string buffer
-                rapidjson::StringBuffer jsonBuffer;
-                rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-                message->Accept(writer);
-                std::string msg = jsonBuffer.GetString();
+            if(req.first == blockKey && req.second != receivedFrom){
+                // send to peer who requested it too, the block is encoded only for the first one
+                if(!frame)
+                    frame = CreateSharedFrame(MISSING_BLOCK, *message);
 
                 double sendTime = block.GetBlockSizeBytes() / m_uploadSpeed;
                 m_nodeStats->blockSentBytes += block.GetBlockSizeBytes();
 
                 Ipv4Address addr = InetSocketAddress::ConvertFrom(req.second).GetIpv4 ();
-                Simulator::Schedule (Seconds(sendTime), &GasperParticipant::SendMessage, this, NO_MESSAGE, MISSING_BLOCK, msg, m_peersSockets[addr]);
+                Simulator::Schedule (Seconds(sendTime), &GasperParticipant::SendSharedFrame, this, MISSING_BLOCK, frame, m_peersSockets[addr]);
             }
         }
 
         // remove processed requests from vector
         m_requestsForBlocks.erase(
                 std::remove_if(m_requestsForBlocks.begin(), m_requestsForBlocks.end(),
-                               [blockHash](std::pair<std::string, Address> p){return p.first == blockHash;}),
+                               [blockKey](std::pair<BlockKey, Address> p){return p.first == blockKey;}),
                 m_requestsForBlocks.end());
     }else{
         NS_LOG_INFO(GetNode()->GetId() << " - Already have Missing block: " << block);
@@ -407,20 +462,14 @@ GasperParticipant::ProcessReceivedMissingBlock(rapidjson::Document *message, Add
 
 void
 GasperParticipant::ProcessReceivedRequestForMissingBlock(rapidjson::Document *message, Address receivedFrom) {
-    std::string blockHash = (*message)["hash"].GetString();
+    BlockKey blockKey = BlockKey::FromString((*message)["hash"].GetString());
 
     for(auto req : m_requestsForBlocks){
-        if(req.first == blockHash && req.second == receivedFrom)
+        if(req.first == blockKey && req.second == receivedFrom)
             return; // already get this request
     }
 
-    std::string   delimiter = "/";
-    size_t        pos = blockHash.find(delimiter);
-
-    int height = atoi(blockHash.substr(0, pos).c_str());
-    int minerId = atoi(blockHash.substr(pos+1, blockHash.size()).c_str());
-    Block blockTemplate(height, minerId, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
-    const Block* blockPtr = m_blockchain.GetBlockPointer(blockTemplate);
+    const Block* blockPtr = m_blockchain.GetBlockPointer(blockKey);
 
     if(blockPtr != nullptr){
         // Convert block to rapidjson document and broadcast the block
@@ -429,19 +478,15 @@ GasperParticipant::ProcessReceivedRequestForMissingBlock(rapidjson::Document *me
         rapidjson::Value value;
         document["type"] = BLOCK;
 
-        // create json string buffer
-        rapidjson::StringBuffer jsonBuffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-        document.Accept(writer);
-        std::string msg = jsonBuffer.GetString();
+        Ptr<Packet> frame = CreateSharedFrame(MISSING_BLOCK, document);
 
         double sendTime = block.GetBlockSizeBytes() / m_uploadSpeed;
         m_nodeStats->blockSentBytes += block.GetBlockSizeBytes();
         Ipv4Address addr = InetSocketAddress::ConvertFrom(receivedFrom).GetIpv4 ();
-        Simulator::Schedule (Seconds(sendTime), &GasperParticipant::SendMessage, this, NO_MESSAGE, MISSING_BLOCK, msg, m_peersSockets[addr]);
+        Simulator::Schedule (Seconds(sendTime), &GasperParticipant::SendSharedFrame, this, MISSING_BLOCK, frame, m_peersSockets[addr]);
     }else{
-        m_requestsForBlocks.push_back(std::make_pair(blockHash, receivedFrom));
-        SendRequestForMissingBlock(blockHash, &receivedFrom);
+        m_requestsForBlocks.push_back(std::make_pair(blockKey, receivedFrom));
+        SendRequestForMissingBlock(blockKey, &receivedFrom);
     }
 }
 
@@ -492,11 +537,8 @@ void GasperParticipant::AdvertiseVoteOrProposal(enum Messages messageType, rapid
     int count = 0;
     double sendTime;
 
-    // create json string buffer
-    rapidjson::StringBuffer jsonBuffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-    d.Accept(writer);
-    std::string msg = jsonBuffer.GetString();
+    // encode the message only once, all peers share the same frame
+    Ptr<Packet> frame = CreateSharedFrame(messageType, d);
 
     // sending to each peer in node list
     for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
@@ -520,19 +562,12 @@ void GasperParticipant::AdvertiseVoteOrProposal(enum Messages messageType, rapid
             }
         }
         count++;
-        Simulator::Schedule (Seconds(sendTime), &GasperParticipant::SendMessage, this, NO_MESSAGE, messageType, msg, m_peersSockets[*i]);
+        Simulator::Schedule (Seconds(GetCpuDelay() + sendTime), &GasperParticipant::SendSharedFrame, this, messageType, frame, m_peersSockets[*i]);
     }
 
     NS_LOG_INFO(GetNode()->GetId() << " - advertised vote or proposal to " << count << " nodes.");
 }
 
-void
-GasperParticipant::SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, std::string d, Ptr<Socket> outgoingSocket){
-    rapidjson::Document msg;
-    msg.Parse(d.c_str());
-    BitcoinNode::SendMessage(receivedMessage, responseMessage, msg, outgoingSocket, "^#EOM#^");
-}
-
 bool
 GasperParticipant::SaveBlockToVector(std::vector<std::vector<Block>> *blockVector, int iteration, Block block) {
     NS_LOG_FUNCTION (this);
@@ -551,9 +586,9 @@ GasperParticipant::SaveBlockToVector(std::vector<std::vector<Block>> *blockVecto
 }
 
 Block*
-GasperParticipant::FindBlockInVector(std::vector<std::vector<Block>> *blockVector, int iteration, std::string blockHash) {
+GasperParticipant::FindBlockInVector(std::vector<std::vector<Block>> *blockVector, int iteration, const BlockKey &blockKey) {
     for(auto i = blockVector->at(iteration - 1).begin(); i != blockVector->at(iteration - 1).end(); i++){
-        if(i->GetBlockHash() == blockHash)
+        if(i->GetBlockKey() == blockKey)
             return &(*i);
     }
 
@@ -611,71 +646,70 @@ GasperParticipant::InsertBlockToBlockchain(Block &newBlock) {
 
             NS_LOG_INFO(GetNode()->GetId() << " - Inserted checkpoint: " << newBlock);
         }else{
-            // update blockchain using LEBB rule
-            m_blockchain.GasperUpdateEpochBoundaryCheckpoints(&lastFinalizedCheckpoint, m_maxBlocksInEpoch);
-
             // insert to blockchain in standard way
             BitcoinNode::InsertBlockToBlockchain(newBlock);
             NS_LOG_INFO(GetNode()->GetId() << " - Inserted block: " << newBlock);
         }
+
+        const Block *insertedBlock = m_blockchain.GetBlockPointer(newBlock);
+        if(insertedBlock != nullptr) {
+            // update blockchain using LEBB rule, the new block can make its parent a boundary checkpoint
+            m_blockchain.GasperUpdateEpochBoundaryCheckpoint(insertedBlock, &lastFinalizedCheckpoint, m_maxBlocksInEpoch);
+            m_forkChoice.OnBlock(insertedBlock);
+        }
     }
 }
 
 void
 GasperParticipant::TallyingAndBlockchainUpdate() {
     // skipping zeroth epoch (there is only genesis)
-    if(m_currentEpoch == 0 || m_votes.size() < m_currentEpoch)
+    if(m_currentEpoch == 0 || (int) m_voteTallies.size() < m_currentEpoch)
         return;
 
-    int totalVotes = m_votes.at(m_currentEpoch - 1).size();
-    if(totalVotes == 0)
+    CasperVoteTally &tally = m_voteTallies.at(m_currentEpoch - 1);
+    int totalVotes = tally.GetNoVotes();
+    if(totalVotes == 0 || tally.IsJustified())
         return;
 
-    // key is (source hash, target hash), value is count of votes
-    std::map<std::pair<std::string, std::string>, int> voteCounter;
-    for(auto vote : m_votes.at(m_currentEpoch - 1)){
-        rapidjson::Document d;
-        d.Parse(vote.second.c_str());
-
-        std::pair<std::string, std::string> sourceTarget = std::make_pair(d["s"].GetString(), d["t"].GetString());
-        int stake = (int)d["stake"].GetUint();
-
-        std::map<std::pair<std::string, std::string>, int>::iterator item = voteCounter.find(sourceTarget);
-        if (item == voteCounter.end()) {
-            voteCounter.insert({ sourceTarget, stake });
-        }else{
-            item->second = item->second + stake;
-        }
-    }
-
-    // find the one with most votes
-    std::pair<std::string, std::string> bestVote = voteCounter.begin()->first;
-    int maxVotes = voteCounter.begin()->second;
-    for(auto vote : voteCounter){
-        if(vote.second > maxVotes){
-            maxVotes = vote.second;
-            bestVote = vote.first;
-        }
-    }
+    // the link with most stake is kept by the running tally
+    std::pair<BlockKey, BlockKey> bestVote = tally.GetBestLink();
+    int maxVotes = tally.GetBestLinkWeight();
 
     // if quorum reached update blockchain (checkpoints, if finality reached even blocks
     if(maxVotes >  (2 * (totalVotes / 3))){
         NS_LOG_INFO(GetNode()->GetId() << " - EPOCH n." << m_currentEpoch << " quorum for s: " << bestVote.first << ", t: " << bestVote.second << " VOTES stakes " << maxVotes << " out of total stakes" << totalVotes);
+        tally.SetJustified();
         UpdateBlockchain(bestVote.first, bestVote.second);
     }
 }
 
 void
-GasperParticipant::UpdateBlockchain(std::string source, std::string target) {
+GasperParticipant::CheckSupermajority(int epoch) {
+    if(m_totalVoteWeight == 0)
+        return;
+
+    CasperVoteTally &tally = m_voteTallies.at(epoch - 1);
+    if(tally.IsJustified() || tally.GetBestLinkWeight() <= (int) (2 * (m_totalVoteWeight / 3)))
+        return;
+
+    std::pair<BlockKey, BlockKey> bestVote = tally.GetBestLink();
+    NS_LOG_INFO(GetNode()->GetId() << " - EPOCH n." << epoch << " supermajority for s: " << bestVote.first << ", t: " << bestVote.second << " VOTES stakes " << tally.GetBestLinkWeight() << " out of " << m_totalVoteWeight);
+    tally.SetJustified();
+    UpdateBlockchain(bestVote.first, bestVote.second);
+}
+
+void
+GasperParticipant::UpdateBlockchain(const BlockKey &source, const BlockKey &target) {
     Block lastFinalizedCheckpoint(m_lastFinalized.first, m_lastFinalized.second, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
-    std::string missingBlock = "";
+    BlockKey missingBlock;
     const Block * newlyFinalized = m_blockchain.CasperUpdateBlockchain(source, target,
                                                                        &lastFinalizedCheckpoint, m_maxBlocksInEpoch, &missingBlock);
 
     // update information about last finalized checkpoint
     if(newlyFinalized != nullptr){
         m_lastFinalized = std::make_pair(newlyFinalized->GetBlockHeight(), newlyFinalized->GetMinerId());
-    }else if(missingBlock != ""){
+        m_forkChoice.Prune(newlyFinalized);
+    }else if(!missingBlock.IsNull()){
         // block is missing in blockchain, so we request peers for it
         m_unprocessedSupermajorityLinks.push_back(std::make_pair(source, target));
         SendRequestForMissingBlock(missingBlock);
@@ -703,22 +737,34 @@ GasperParticipant::AttestHlmdPhase() {
     // ------ start real attest html phase ------
     int participantId = GetNode()->GetId();
 
-    crypto_vrf_prove(m_vrfProof, m_sk, (const unsigned char*) m_actualVrfSeed, sizeof m_actualVrfSeed);
-    crypto_vrf_proof_to_hash(m_vrfOut, m_vrfProof);
+    // the committee membership (threshold or sortition) may only be decided by the output of a valid proof
+    if(BatchVrfProver::GetInstance().Prove(m_vrfProof, m_sk, (const unsigned char*) m_actualVrfSeed, sizeof m_actualVrfSeed) != 0
+       || VrfBackend::ProofToHash(m_vrfOut, m_vrfProof) != 0)
+        NS_FATAL_ERROR(GetNode()->GetId() << " - Cannot compute the VRF proof of the participant");
+    ChargeCpuTime(VrfBackend::GetProveDelay());
 
-    int chosenAP = memcmp(m_vrfOut, m_vrfThreshold, sizeof m_vrfOut);
-    NS_LOG_INFO ( participantId << " - Chosen AP("<<m_iterationAttest<<"): " << chosenAP << " r: " << ((chosenAP <= 0) ? "Chosen" : "Not chosen"));
-    bool chosen = (chosenAP <= 0) ? true : false;
+    // with the sortition the stake is drawn first, the VRF output selects the votes of its sub-users
+    int votes = 0;
+    if (m_sortition) {
+        GenNextStakeSize();
+        votes = m_sortition->Select(m_vrfOut, m_nextStakeSize);
+    } else if (memcmp(m_vrfOut, m_vrfThreshold, sizeof m_vrfOut) <= 0)
+        votes = 1;
+    NS_LOG_INFO ( participantId << " - Chosen AP("<<m_iterationAttest<<"): " << votes << " r: " << ((votes > 0) ? "Chosen" : "Not chosen"));
+    bool chosen = votes > 0;
 
     // check output of VRF and if chosen then evaluate Hybrid LMD score and send attest vote
     if(chosen) {
         // evaluating hlmd block for searching "most valid" block
-        const Block* attestedBlock = EvalHLMDBlock(m_iterationAttest);
+        const Block* attestedBlock = EvalHLMDBlock();
 
         std::pair<const Block*, const Block*> link = FindBestLink(attestedBlock);
 
-        // generate next stake size
-        GenNextStakeSize();
+        if(!m_sortition) {
+            // generate next stake size, the whole stake is the weight of the attest
+            GenNextStakeSize();
+            votes = m_nextStakeSize;
+        }
 
         // Extract values from block to rapidjson document vote and broadcast the vote
         rapidjson::Document document;
@@ -752,8 +798,12 @@ GasperParticipant::AttestHlmdPhase() {
         document.AddMember("blockIteration", value, document.GetAllocator());
         value = participantId;
         document.AddMember("voterId", value, document.GetAllocator());
-        value = m_nextStakeSize;
+        value = votes;
         document.AddMember("stake", value, document.GetAllocator());
+        if(m_sortition) {
+            value = m_nextStakeSize;
+            document.AddMember("balance", value, document.GetAllocator());
+        }
 
         // common values for checking valid voter
         value.SetString((const char*) m_vrfProof, 80, document.GetAllocator());
@@ -777,16 +827,18 @@ GasperParticipant::AttestHlmdPhase() {
 
         SaveVoteToAttestBuffer(&document);
         SaveVoteToFFGBuffer(&document);
+        m_seenMessages.Insert(ATTEST, participantId, m_iterationAttest);
 
         // statistics update
         m_averageStakeSize = m_chosenToCommitteeTimes / static_cast<double>(m_chosenToCommitteeTimes + 1) *
                              m_averageStakeSize
-                             + static_cast<double>(m_nextStakeSize) / (m_chosenToCommitteeTimes + 1);
+                             + static_cast<double>(votes) / (m_chosenToCommitteeTimes + 1);
         m_chosenToCommitteeTimes++;
     }
 
     // Create new certify vote event in m_certifyVoteInterval seconds
     m_nextBlockProposalEvent = Simulator::Schedule (Seconds(m_intervalAttest), &GasperParticipant::BlockProposalPhase, this);
+    BatchVrfProver::GetInstance().Expect(Simulator::Now() + Seconds(m_intervalAttest), m_sk);
 }
 
 void
@@ -794,14 +846,18 @@ GasperParticipant::ProcessReceivedAttest(rapidjson::Document *message, Address r
     NS_LOG_FUNCTION (this);
 
     // Checking valid VRF
-    std::string blockHash = (*message)["blockHash"].GetString();
+    BlockKey blockKey = BlockKey::FromString((*message)["blockHash"].GetString());
     int blockIteration = (*message)["blockIteration"].GetInt();
     int participantId = (*message)["voterId"].GetInt();
 
     // update statistics
     m_nodeStats->voteReceivedBytes += m_fixedVoteSize;
 
-    Block *attestedBlock = FindBlockInVector(&m_receivedBlockProposals, blockIteration, blockHash);
+    // already accepted attests are dropped before VRF verification
+    if(m_seenMessages.IsDuplicate(ATTEST, participantId, blockIteration))
+        return;
+
+    Block *attestedBlock = FindBlockInVector(&m_receivedBlockProposals, blockIteration, blockKey);
     if(attestedBlock == nullptr)
         // block proposal was not found so whole attest is invalid
         return;
@@ -818,10 +874,15 @@ GasperParticipant::ProcessReceivedAttest(rapidjson::Document *message, Address r
     memcpy(actualVrfSeed, (*message)["currentSeed"].GetString(), sizeof actualVrfSeed);
 
     // generate vfrOut for proof for proof and check if it is lower than threshold
-    crypto_vrf_verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    int vrfRc = VrfVerifyCache::GetInstance().Verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    ChargeCpuTime(VrfBackend::GetVerifyDelay());
 
-    int chosenAtt = memcmp(vrfOut, m_vrfThreshold, sizeof vrfOut);
-    bool chosen = (chosenAtt <= 0) ? true : false;
+    if(vrfRc != 0){
+        NS_LOG_INFO ( "INVALID Attest - participantId: " << participantId << " block iteration/slot: " << blockIteration << " Reason: invalid VRF proof");
+        return;
+    }
+
+    bool chosen = IsAttestChosen(vrfOut, message);
 
     if(!chosen){
         NS_LOG_INFO ( "INVALID Attest - participantId: " << participantId << " block iteration/slot: " << blockIteration);
@@ -834,6 +895,7 @@ GasperParticipant::ProcessReceivedAttest(rapidjson::Document *message, Address r
 
     if(insertedA || insertedB) {
         // received new vote for the epoch
+        m_seenMessages.Insert(ATTEST, participantId, blockIteration);
 
         // advertise to other participants
         AdvertiseVoteOrProposal(ATTEST, *message, &receivedFrom);
@@ -856,13 +918,13 @@ GasperParticipant::ProcessReceivedAttest(rapidjson::Document *message, Address r
         << ", h(s): " << sHeight
         << ", h(t): " << tHeight
         << ", bIt: " << blockIteration
-        << ", b: " << blockHash
+        << ", b: " << blockKey
         << "}");
     }
 }
 
 const Block *
-GasperParticipant::EvalHLMDBlock(int iteration) {
+GasperParticipant::EvalHLMDBlock() {
     // get new checkpoints (only in chain of last finalized checkpoint)
     Block lastFinalizedCheckpoint(m_lastFinalized.first, m_lastFinalized.second, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
     std::vector<const Block*> newCheckpoints = m_blockchain.GetNotFinalizedCheckpoints(lastFinalizedCheckpoint);
@@ -881,48 +943,8 @@ GasperParticipant::EvalHLMDBlock(int iteration) {
         }
     }
 
-    const Block* B = highestJustifiedCheckpoint;
-
-    for(;;){
-        const std::vector<const Block*> children = m_blockchain.GetChildrenPointers(*B);
-        if(children.size() == 0)
-            break;
-        B = FindArgMax(&children, iteration);
-    }
-
-    return B;
-}
-
-const Block*
-GasperParticipant::FindArgMax(const std::vector<const Block *> *children, int iteration) {
-    // return only child
-    if(children->size() == 1)
-        return children->at(0);
-
-    int maxFollowers = 0;
-    const Block* B1 = children->at(0);
-    // iterate through children and find the one with most followers
-    for (auto child : (*children)){
-        int childFollowers = 0;
-        if(m_receivedAttests.size() < iteration)
-            continue;
-
-        // iterate through votes and check their ancestors
-        for (auto vote : m_receivedAttests.at(iteration-1)){
-            if((*(vote.second.first)) == (*child)
-                || m_blockchain.IsAncestor(vote.second.first, child))
-            {
-                childFollowers += vote.second.second;   // increase count of child followers by their stake
-            }
-        }
-
-        // compare count of followers
-        if(childFollowers > maxFollowers){
-            B1 = child;
-        }
-    }
-
-    return B1;
+    // walk to the children with the highest weight of the latest attests
+    return m_forkChoice.FindHead(highestJustifiedCheckpoint);
 }
 
 std::pair<const Block*, const Block*>
@@ -999,7 +1021,6 @@ GasperParticipant::FindBestLink(const Block *attestedBlock) {
 
         // target should be lowest checkpoint in chain of highest epoch
         const Block* target = highest;
-        std::vector<const Block*> highestAncestors = m_blockchain.GetAncestorsPointers(*highest, m_lastFinalized.first);
         bool found = false;
         for(int height = 0; height <= highestRelativeHeight; height++){
             if(possibleTargets.size() >= (height + 1)) {
@@ -1018,7 +1039,6 @@ GasperParticipant::FindBestLink(const Block *attestedBlock) {
 
         // choosing source - highest justified checkpoint in targets chain
         const Block* source = newCheckpoints.at(0);
-        std::vector<const Block*> targetsAncestors = m_blockchain.GetAncestorsPointers(*target, m_lastFinalized.first);
         for(int height = possibleSources.size() - 1; height >= 0; height--){
             if(possibleSources.at(height).size() != 0) {
                 const Block* possibleSource = possibleSources.at(height).at(0);
@@ -1040,58 +1060,18 @@ GasperParticipant::FindBestLink(const Block *attestedBlock) {
 
 bool
 GasperParticipant::SaveVoteToFFGBuffer(rapidjson::Document *vote) {
-    int epoch = (*vote)["epoch"].GetInt();
-    int voterId = (*vote)["voterId"].GetInt();
-
-    // resize vector of votes if needed
-    if(m_votes.size() < epoch)
-        m_votes.resize(epoch);
-
-    // search for vote from the voter in the epoch
-    if (m_votes.at(epoch-1).find(voterId) == m_votes.at(epoch-1).end() ) {
-        // not found
-
-        // Extract values from block to rapidjson document vote and broadcast the vote
-        rapidjson::Document document;
-        rapidjson::Value value;
-        document.SetObject();
-
-        value = ATTEST;
-        document.AddMember("message", value, document.GetAllocator());
-
-        // casper justification values
-        std::string sourceBlockHash =  (*vote)["s"].GetString();
-        value.SetString(sourceBlockHash.c_str(), sourceBlockHash.size(), document.GetAllocator());
-        document.AddMember("s", value, document.GetAllocator());
-        std::string targetBlockHash = (*vote)["t"].GetString();
-        value.SetString(targetBlockHash.c_str(), targetBlockHash.size(), document.GetAllocator());
-        document.AddMember("t", value, document.GetAllocator());
-
-        value = (*vote)["hs"].GetInt();
-        document.AddMember("hs", value, document.GetAllocator());
-        value = (*vote)["ht"].GetInt();
-        document.AddMember("ht", value, document.GetAllocator());
-
-        value =  (*vote)["epoch"].GetInt();
-        document.AddMember("epoch", value, document.GetAllocator());
-        value =  (*vote)["voterId"].GetInt();
-        document.AddMember("voterId", value, document.GetAllocator());
-        value =  (*vote)["stake"].GetUint();
-        document.AddMember("stake", value, document.GetAllocator());
+    CasperVote casperVote = CasperVote::FromJSON(vote, "voterId");
 
+    // resize vector of tallies if needed
+    if((int) m_voteTallies.size() < casperVote.epoch)
+        m_voteTallies.resize(casperVote.epoch);
 
-        // create json string buffer
-        rapidjson::StringBuffer jsonBuffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
-        document.Accept(writer);
-
-        // insert vote (serialized json) to vote buffer
-        m_votes.at(epoch-1).insert({ voterId, jsonBuffer.GetString() });
-        return true;
-    } else {
-        // found
+    // count the vote if the voter has not voted in the epoch yet
+    if(!m_voteTallies.at(casperVote.epoch - 1).AddVote(casperVote))
         return false;
-    }
+
+    CheckSupermajority(casperVote.epoch);
+    return true;
 }
 
 bool
@@ -1099,39 +1079,22 @@ GasperParticipant::SaveVoteToAttestBuffer(rapidjson::Document *vote) {
     int blockIteration = (*vote)["blockIteration"].GetInt();
     int voterId = (*vote)["voterId"].GetInt();
 
-    // resize vector of votes if needed
-    if(m_receivedAttests.size() < blockIteration)
-        m_receivedAttests.resize(blockIteration);
-
-    // search for attest from the voter in the slot/block iteration
-    if (m_receivedAttests.at(blockIteration-1).find(voterId) == m_receivedAttests.at(blockIteration-1).end() ) {
-        // not found
-        // find block in blockchain
-        std::string   blockHash = (*vote)["blockHash"].GetString();
-        std::string   delimiter = "/";
-        size_t        pos = blockHash.find(delimiter);
-        int height = atoi(blockHash.substr(0, pos).c_str());
-        int minerId = atoi(blockHash.substr(pos+1, blockHash.size()).c_str());
-
-        int stake = (*vote)["stake"].GetUint();
-
-        NS_LOG_INFO(GetNode()->GetId() << " - Saving to attest buffer: h = " << height << " , mId: " << minerId);
-        Block block(height, minerId, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
-        const Block * blockPointer = m_blockchain.GetBlockPointer(block);
-
-        if(blockPointer != nullptr){
-            // insert vote (serialized json) to vote buffer
-            m_receivedAttests.at(blockIteration-1).insert({ voterId, std::make_pair(blockPointer, stake)});
-            return true;
-        }else{
-            NS_LOG_INFO(GetNode()->GetId() << " - Save attest failed (block does not exist): bIt = " << blockIteration << ", pId: " << voterId << ", h= " << height << ", mId: " << minerId);
-        }
-    }else {
-        NS_LOG_INFO(GetNode()->GetId() << " - Save attest failed (already saved): bIt = " << blockIteration << ", pId: " << voterId);
+    // the attests already accepted in the slot/block iteration are dropped by m_seenMessages before,
+    // the fork choice keeps only the latest attest of the voter
+    BlockKey blockKey = BlockKey::FromString((*vote)["blockHash"].GetString());
+
+    int stake = (*vote)["stake"].GetUint();
+
+    NS_LOG_INFO(GetNode()->GetId() << " - Saving to attest buffer: h = " << blockKey.GetHeight() << " , mId: " << blockKey.GetMinerId());
+    const Block * blockPointer = m_blockchain.GetBlockPointer(blockKey);
+
+    if(blockPointer == nullptr){
+        NS_LOG_INFO(GetNode()->GetId() << " - Save attest failed (block does not exist): bIt = " << blockIteration << ", pId: " << voterId << ", b: " << blockKey);
+        return false;
     }
 
-    // found
-    return false;
+    m_forkChoice.OnAttestation(voterId, blockIteration, blockPointer, stake);
+    return true;
 }
 
 
@@ -1147,8 +1110,11 @@ void GasperParticipant::BlockProposalPhase() {
     InformAboutState(m_iterationBP);  // print state to stderr
     int participantId = GetNode()->GetId();
 
-    crypto_vrf_prove(m_vrfProof, m_sk, (const unsigned char*) m_actualVrfSeed, sizeof m_actualVrfSeed);
-    crypto_vrf_proof_to_hash(m_vrfOut, m_vrfProof);
+    // the committee membership (threshold or sortition) may only be decided by the output of a valid proof
+    if(BatchVrfProver::GetInstance().Prove(m_vrfProof, m_sk, (const unsigned char*) m_actualVrfSeed, sizeof m_actualVrfSeed) != 0
+       || VrfBackend::ProofToHash(m_vrfOut, m_vrfProof) != 0)
+        NS_FATAL_ERROR(GetNode()->GetId() << " - Cannot compute the VRF proof of the participant");
+    ChargeCpuTime(VrfBackend::GetProveDelay());
 
     int chosenBP = memcmp(m_vrfOut, m_vrfThresholdBP, sizeof m_vrfOut);
     NS_LOG_INFO ( participantId << " - Chosen BP("<<m_iterationBP<<"): " << chosenBP << " r: " << ((chosenBP <= 0) ? "Chosen" : "Not chosen"));
@@ -1157,7 +1123,7 @@ void GasperParticipant::BlockProposalPhase() {
     // check output of VRF and if chosen then create and send
     if(chosen){
         // Extract info from blockchain
-        const Block* prevBlock = EvalHLMDBlock(m_iterationBP);
+        const Block* prevBlock = EvalHLMDBlock();
         int height =  prevBlock->GetBlockHeight() + 1;
         int parentBlockParticipantId = prevBlock->GetMinerId();
         double currentTime = Simulator::Now ().GetSeconds ();
@@ -1168,7 +1134,11 @@ void GasperParticipant::BlockProposalPhase() {
                         currentTime, currentTime, Ipv4Address("127.0.0.1"));
         newBlock.SetBlockProposalIteration(m_iterationBP);
 //        newBlock.SetVrfSeed(GenerateVrfSeed());
-        randombytes_buf(m_nextVrfSeed, sizeof m_nextVrfSeed);
+        // with the key pool the seed is the hash of the leader's VRF output, so the runs are reproducible
+        if (VrfKeyPool::GetInstance().IsEnabled())
+            crypto_generichash(m_nextVrfSeed, sizeof m_nextVrfSeed, m_vrfOut, sizeof m_vrfOut, NULL, 0);
+        else
+            randombytes_buf(m_nextVrfSeed, sizeof m_nextVrfSeed);
         newBlock.SetVrfSeed(m_nextVrfSeed);
         newBlock.SetParticipantPublicKey(m_pk);
         newBlock.SetVrfOutput(m_vrfOut);
@@ -1187,11 +1157,13 @@ void GasperParticipant::BlockProposalPhase() {
         AdvertiseVoteOrProposal(BLOCK_PROPOSAL, document);
         // inserting to block proposals vector -> in case that we will get this block again we do not advertise it again
         SaveBlockToVector(&m_receivedBlockProposals, m_iterationBP, newBlock);
+        m_seenMessages.Insert(BLOCK_PROPOSAL, participantId, m_iterationBP);
         NS_LOG_INFO (GetNode()->GetId() << " - Advertised block proposal:  " << newBlock);
     }
 
     // Create new block proposal event in m_blockProposalInterval seconds
     m_nextAttestEvent = Simulator::Schedule (Seconds(m_intervalBP), &GasperParticipant::AttestHlmdPhase, this);
+    BatchVrfProver::GetInstance().Expect(Simulator::Now() + Seconds(m_intervalBP), m_sk);
 }
 
 void GasperParticipant::ProcessReceivedProposedBlock(rapidjson::Document *message, Address receivedFrom) {
@@ -1199,6 +1171,12 @@ void GasperParticipant::ProcessReceivedProposedBlock(rapidjson::Document *messag
 
     // Converting from rapidjson document message to block object
 
+    // already accepted proposals are dropped before parsing and VRF verification
+    if(m_seenMessages.IsDuplicate(BLOCK_PROPOSAL, (*message)["minerId"].GetInt(), (*message)["blockProposalIteration"].GetInt())) {
+        m_nodeStats->blockReceivedBytes += (*message)["size"].GetInt();
+        return;
+    }
+
     // FIXED - Upper line is commented for correct checking of same blocks
     // (A->B, B->C, C->B => B receives the block from A and B, so block would not be compared as equal even when they are the same block created by A)
     Block proposedBlock = Block::FromJSON(message, InetSocketAddress::ConvertFrom(receivedFrom).GetIpv4 ());
@@ -1224,7 +1202,15 @@ void GasperParticipant::ProcessReceivedProposedBlock(rapidjson::Document *messag
     memcpy(actualVrfSeed, (*message)["currentSeed"].GetString(), sizeof actualVrfSeed);
 
     // generate vfrOut for proof and check if it is same as VRF output inside of the received block
-    crypto_vrf_verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    int vrfRc = VrfVerifyCache::GetInstance().Verify(vrfOut, pk, vrfProof, (const unsigned char*) actualVrfSeed, sizeof actualVrfSeed);
+    ChargeCpuTime(VrfBackend::GetVerifyDelay());
+
+    if(vrfRc != 0) {
+        NS_LOG_INFO(
+                GetNode()->GetId() << " - INVALID Block proposal - participantId: " << participantId << " block iterationBP: " << blockIteration
+                                                           << "Reason: invalid VRF proof");
+        return;
+    }
 
     int chosenBP = memcmp(vrfOut, m_vrfThresholdBP, sizeof vrfOut);
     bool chosen = (chosenBP <= 0) ? true : false;
@@ -1246,6 +1232,7 @@ void GasperParticipant::ProcessReceivedProposedBlock(rapidjson::Document *messag
 
     // Inserting received block proposal into vector
     bool inserted = SaveBlockToVector(&m_receivedBlockProposals, blockIteration, proposedBlock);
+    m_seenMessages.Insert(BLOCK_PROPOSAL, participantId, blockIteration);
 
     // sending only if this is new proposal
     if(inserted){
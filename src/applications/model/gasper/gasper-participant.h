@@ -8,6 +8,9 @@
 
 #include "ns3/gasper-node.h"
 #include "ns3/gasper-participant-helper.h"
+#include "ns3/gasper-fork-choice.h"
+#include "ns3/seen-message-cache.h"
+#include "ns3/stake-sortition.h"
 #include <random>
 #include <utility>
 #include <vector>
@@ -63,15 +66,6 @@ protected:
 
     virtual void DoDispose (void);
 
-    /**
-     * \brief Sends a message to a peer
-     * \param receivedMessage the type of the received message
-     * \param responseMessage the type of the response message
-     * \param d the stringified rapidjson document containing the info of the outgoing message
-     * \param outgoingSocket the socket of the peer
-     */
-    void SendMessage(enum Messages receivedMessage,  enum Messages responseMessage, std::string d, Ptr<Socket> outgoingSocket);
-
 
     /**
      * \brief Handle a document received by the application with unknown type number
@@ -118,19 +112,10 @@ protected:
     void ProcessReceivedAttest(rapidjson::Document *message, Address receivedFrom);
 
     /**
-     * finds best block using Hybrid LMD Ghost rule
-     * @param iteration iteration (also called as slot) in which we are looking for attests
+     * finds best block using Hybrid LMD Ghost rule (latest attests of the voters are counted)
      * @return pointer on block which is best according to the participant (committee voter)
      */
-    const Block* EvalHLMDBlock (int iteration);
-
-    /**
-     * between children finds the block with most followers
-     * @param children pointer to vector containing pointer to direct children of some block
-     * @param iteration iteration (also called as slot) in which we are looking for attests
-     * @return pointer to the block with most followers
-     */
-    const Block* FindArgMax (const std::vector<const Block *> *children, int iteration);
+    const Block* EvalHLMDBlock (void);
 
     /**
      * finds best link between checkpoints (the one with highest score based on Hybrid LMD rule)
@@ -164,19 +149,26 @@ protected:
     bool SaveBlockToVector(std::vector<std::vector<Block>> *blockVector, int iteration, Block block);
 
     /**
-     * extracts attest from vote and inserts attest to vote buffer containing attests if it is not already inside
+     * extracts attest from vote and passes it to the fork choice, which counts only the latest attest of the voter
+     * (the attests already accepted in the slot are dropped by m_seenMessages before)
      * @param vote rapidjson document containing the vote (attest + ffg vote)
-     * @return true if vote was inserted, false if vote is already in buffer
+     * @return true if the attested block is in the blockchain, false if the attest can't be counted
      */
     bool SaveVoteToAttestBuffer(rapidjson::Document *vote);
 
     /**
-     * extracts FFG vote from vote and inserts FFG vote to vote buffer containing FFG votes if it is not already inside
+     * extracts FFG vote from vote and counts it in the tally of its epoch if it is not already counted
      * @param vote rapidjson document containing the vote (attest + ffg vote)
      * @return true if vote was inserted, false if vote is already in buffer
      */
     bool SaveVoteToFFGBuffer(rapidjson::Document *vote);
 
+    /**
+     * justifies the best link of the epoch as soon as it has more than 2/3 of the total vote weight (if it is set)
+     * @param epoch epoch of the tally
+     */
+    void CheckSupermajority(int epoch);
+
     /**
      * handling insertion of block to blockchain to count blocks in epoch and know when to vote
      * @param newBlock new block to insert
@@ -192,10 +184,10 @@ protected:
      * Finds block in vector (blockProposals) and returns pointer to it
      * @param blockVector vector where pointer should be found
      * @param iteration phase iteration number
-     * @param blockHash hash of block which we are looking for
+     * @param blockKey key of block which we are looking for
      * @return returns pointer on block if block was found, nullptr otherwise
      */
-    Block* FindBlockInVector(std::vector<std::vector<Block>> *blockVector, int iteration, std::string blockHash);
+    Block* FindBlockInVector(std::vector<std::vector<Block>> *blockVector, int iteration, const BlockKey &blockKey);
 
     /**
      * increases total count of votes received in the iteration
@@ -221,6 +213,15 @@ protected:
      */
     void GenNextStakeSize();
 
+    /**
+     * checks if the voter of the received attest was chosen to the committee, with the sortition the weight
+     * of the attest (stake) has to be the number of the sub-users selected from the stake of the voter (balance)
+     * @param vrfOut verified VRF output of the voter
+     * @param message pointer to rapidjson document containing the attest
+     * @return true if the attest is from a committee member
+     */
+    bool IsAttestChosen(const unsigned char *vrfOut, rapidjson::Document *message);
+
     /**
      * counts average committee size from received attests or proposals
      * @param blockProposal true if we are looking for block proposal committee size
@@ -230,10 +231,10 @@ protected:
 
     /**
      * send request for missing block to peers
-     * @param missingBlockHash hash of requested missing block
+     * @param missingBlock key of requested missing block
      * @param doNotSendTo pointer to address of peer to which we should not send the message, default nullptr (send to all)
      */
-    void SendRequestForMissingBlock(std::string missingBlockHash, Address *doNotSendTo = nullptr);
+    void SendRequestForMissingBlock(const BlockKey &missingBlock, Address *doNotSendTo = nullptr);
 
     /**
     * processing of received message with request for missing block
@@ -254,7 +255,7 @@ protected:
      * @param source source checkpoint of link
      * @param target target checkpoint of link
      */
-    void UpdateBlockchain(std::string source, std::string target);
+    void UpdateBlockchain(const BlockKey &source, const BlockKey &target);
 
     GasperParticipantHelper *m_helper;
 
@@ -294,8 +295,14 @@ protected:
 
     std::vector<std::vector<Block>> m_receivedBlockProposals;     // vector of block proposals received in certain iterations
 
-    std::vector<std::map<int, std::string>> m_votes;              // buffer containing FFG votes for each epoch (map key is voter id, value is serialized vote JSON)
-    std::vector<std::map<int, std::pair<const Block*, int>>> m_receivedAttests;        // buffer containing attests for each slot/bpIteration (map key is voter id, value is Block pointer from vote and amount of stake)
+    std::vector<CasperVoteTally> m_voteTallies;                   // running tallies of the FFG votes for each epoch
+    uint32_t m_totalVoteWeight;                                   // total stake of the votes in an epoch for the early justification, 0 if disabled
+    GasperForkChoice m_forkChoice;                                 // Hybrid LMD GHOST store fed by the inserted blocks and the latest attests
+    SeenMessageCache m_seenMessages;                               // accepted proposals and attests, duplicates are dropped before VRF verification
+
+    uint32_t m_sortitionCommitteeSize;                            // expected weight of the attest committee selected by the stake weighted sortition, 0 for the VRF threshold
+    uint64_t m_sortitionTotalStake;                               // total stake of all participants for the sortition
+    StakeSortition *m_sortition;                                  // shared sortition tables, nullptr without the sortition
 
     EventId m_nextBlockProposalEvent; 				//!< Event to next block proposal
     EventId m_nextAttestEvent; 				        //!< Event to next attest voting
@@ -305,8 +312,8 @@ protected:
     int m_currentEpoch;                                 // number of actual epoch in which is participant voting
     std::pair<int, int> m_lastFinalized;                // info about last finalized checkpoint (block height and minerId)
 
-    std::vector<std::pair<std::string, Address>> m_requestsForBlocks;   // buffer containing requests for missing block (missing block has, peer who sent request)
-    std::vector<std::pair<std::string, std::string>> m_unprocessedSupermajorityLinks;   // buffer containing links which reach quorum, but one of blocks were missing (source hash, target hash)
+    std::vector<std::pair<BlockKey, Address>> m_requestsForBlocks;   // buffer containing requests for missing block (missing block key, peer who sent request)
+    std::vector<std::pair<BlockKey, BlockKey>> m_unprocessedSupermajorityLinks;   // buffer containing links which reach quorum, but one of blocks were missing (source key, target key)
 
     //debug
     double       m_timeStart;
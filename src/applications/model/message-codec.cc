@@ -0,0 +1,414 @@
+/**
+ * This file contains the definitions of the message codecs.
+ */
+
+#include "ns3/log.h"
+#include "message-codec.h"
+#include "../../rapidjson/writer.h"
+#include "../../rapidjson/stringbuffer.h"
+#include <cstring>
+#include <unordered_map>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MessageCodec");
+
+/**
+ * Dictionary of the member names used by the protocols messages.
+ * The indexes are part of the binary wire format, new keys have to be appended at the end.
+ */
+static const char* const g_messageKeys[] =
+{
+  "message", "type", "inv", "blocks", "chunks", "hash", "size", "fullBlock", "availableChunks",
+  "requestChunks", "chunk", "height", "minerId", "parentBlockMinerId", "timeCreated", "timeReceived",
+  "blockId", "casperState", "blockProposalIteration", "vrfSeed", "participantPublicKey", "vrfOutput",
+  "vrfProof", "currentSeed", "vrfPK", "blockHash", "blockIteration", "voterId", "algoAmount",
+  "s", "t", "hs", "ht", "epoch", "pId", "stake", "pk", "balance"
+};
+
+static const uint32_t g_messageKeysCount = sizeof(g_messageKeys) / sizeof(g_messageKeys[0]);
+
+
+static std::unordered_map<std::string, int>
+CreateMessageKeyIndexes (void)
+{
+  std::unordered_map<std::string, int> keyIndexes;
+
+  for (uint32_t i = 0; i < g_messageKeysCount; i++)
+    keyIndexes[g_messageKeys[i]] = i;
+
+  return keyIndexes;
+}
+
+static int
+FindMessageKey (const char *key, uint32_t length)
+{
+  static const std::unordered_map<std::string, int> keyIndexes = CreateMessageKeyIndexes();
+
+  std::unordered_map<std::string, int>::const_iterator it = keyIndexes.find(std::string(key, length));
+  return it == keyIndexes.end() ? -1 : it->second;
+}
+
+
+const char* getMessageCodecName(enum MessageCodecType codec)
+{
+  switch (codec)
+  {
+    case BINARY_CODEC: return "BINARY_CODEC";
+    case JSON_CODEC: return "JSON_CODEC";
+  }
+  return "UNKNOWN_CODEC";
+}
+
+
+enum MessageCodecType MessageCodec::m_defaultType = BINARY_CODEC;
+
+MessageCodec::~MessageCodec (void)
+{
+}
+
+void
+MessageCodec::EncodeFrame (const rapidjson::Value &message, std::string &buffer) const
+{
+  size_t headerPosition = buffer.size();
+  buffer.append(FRAME_HEADER_SIZE, '\0');
+
+  Encode(message, buffer);
+
+  uint32_t length = buffer.size() - headerPosition - FRAME_HEADER_SIZE;
+  buffer[headerPosition] = static_cast<char>((length >> 24) & 0xff);
+  buffer[headerPosition + 1] = static_cast<char>((length >> 16) & 0xff);
+  buffer[headerPosition + 2] = static_cast<char>((length >> 8) & 0xff);
+  buffer[headerPosition + 3] = static_cast<char>(length & 0xff);
+}
+
+uint32_t
+MessageCodec::ReadFrameLength (const char *data)
+{
+  const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+  return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16)
+         | (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+}
+
+std::string
+MessageCodec::ToJsonString (const rapidjson::Value &message)
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  message.Accept(writer);
+  return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+std::ostream&
+operator<< (std::ostream &os, const MessageRenderer &renderer)
+{
+#if SIMPOS_MESSAGE_RENDERING
+  os << MessageCodec::ToJsonString(renderer.GetMessage());
+#else
+  (void) renderer;
+  os << "<message rendering disabled>";
+#endif
+  return os;
+}
+
+const MessageCodec*
+MessageCodec::Get (enum MessageCodecType type)
+{
+  static const BinaryMessageCodec binaryCodec;
+  static const JsonMessageCodec jsonCodec;
+
+  switch (type)
+  {
+    case JSON_CODEC: return &jsonCodec;
+    case BINARY_CODEC:
+    default: return &binaryCodec;
+  }
+}
+
+const MessageCodec*
+MessageCodec::GetDefault (void)
+{
+  return Get(m_defaultType);
+}
+
+void
+MessageCodec::SetDefaultType (enum MessageCodecType type)
+{
+  NS_LOG_FUNCTION (getMessageCodecName(type));
+  m_defaultType = type;
+}
+
+enum MessageCodecType
+MessageCodec::GetDefaultType (void)
+{
+  return m_defaultType;
+}
+
+
+//---------------------------------------------------------------------------------------------
+// JsonMessageCodec
+//---------------------------------------------------------------------------------------------
+
+enum MessageCodecType
+JsonMessageCodec::GetType (void) const
+{
+  return JSON_CODEC;
+}
+
+void
+JsonMessageCodec::Encode (const rapidjson::Value &message, std::string &buffer) const
+{
+  rapidjson::StringBuffer jsonBuffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(jsonBuffer);
+  message.Accept(writer);
+  buffer.append(jsonBuffer.GetString(), jsonBuffer.GetSize());
+}
+
+bool
+JsonMessageCodec::Decode (const char *data, uint32_t size, rapidjson::Document &message) const
+{
+  message.Parse(data, size);
+  return !message.HasParseError() && message.IsObject();
+}
+
+
+//---------------------------------------------------------------------------------------------
+// BinaryMessageCodec
+//---------------------------------------------------------------------------------------------
+
+enum MessageCodecType
+BinaryMessageCodec::GetType (void) const
+{
+  return BINARY_CODEC;
+}
+
+void
+BinaryMessageCodec::Encode (const rapidjson::Value &message, std::string &buffer) const
+{
+  EncodeValue(message, buffer);
+}
+
+bool
+BinaryMessageCodec::Decode (const char *data, uint32_t size, rapidjson::Document &message) const
+{
+  const char *end = data + size;
+
+  if (size == 0 || static_cast<uint8_t>(*data) != TAG_OBJECT)
+    return false;
+
+  if (!DecodeValue(data, end, message, message.GetAllocator(), 0))
+    return false;
+
+  return data == end;
+}
+
+void
+BinaryMessageCodec::EncodeValue (const rapidjson::Value &value, std::string &buffer)
+{
+  switch (value.GetType())
+  {
+    case rapidjson::kNullType:
+      buffer.push_back(static_cast<char>(TAG_NULL));
+      break;
+    case rapidjson::kFalseType:
+      buffer.push_back(static_cast<char>(TAG_FALSE));
+      break;
+    case rapidjson::kTrueType:
+      buffer.push_back(static_cast<char>(TAG_TRUE));
+      break;
+    case rapidjson::kNumberType:
+    {
+      if (value.IsInt64())
+      {
+        int64_t number = value.GetInt64();
+        buffer.push_back(static_cast<char>(TAG_INT));
+        WriteVarint((static_cast<uint64_t>(number) << 1) ^ static_cast<uint64_t>(number >> 63), buffer);
+      }
+      else if (value.IsUint64())
+      {
+        buffer.push_back(static_cast<char>(TAG_UINT));
+        WriteVarint(value.GetUint64(), buffer);
+      }
+      else
+      {
+        double number = value.GetDouble();
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        buffer.push_back(static_cast<char>(TAG_DOUBLE));
+        for (int i = 0; i < 8; i++)
+          buffer.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+      }
+      break;
+    }
+    case rapidjson::kStringType:
+      buffer.push_back(static_cast<char>(TAG_STRING));
+      WriteVarint(value.GetStringLength(), buffer);
+      buffer.append(value.GetString(), value.GetStringLength());
+      break;
+    case rapidjson::kArrayType:
+      buffer.push_back(static_cast<char>(TAG_ARRAY));
+      WriteVarint(value.Size(), buffer);
+      for (rapidjson::Value::ConstValueIterator it = value.Begin(); it != value.End(); ++it)
+        EncodeValue(*it, buffer);
+      break;
+    case rapidjson::kObjectType:
+      buffer.push_back(static_cast<char>(TAG_OBJECT));
+      WriteVarint(value.MemberCount(), buffer);
+      for (rapidjson::Value::ConstMemberIterator it = value.MemberBegin(); it != value.MemberEnd(); ++it)
+      {
+        int keyIndex = FindMessageKey(it->name.GetString(), it->name.GetStringLength());
+
+        if (keyIndex >= 0)
+          WriteVarint(static_cast<uint64_t>(keyIndex) << 1, buffer);
+        else
+        {
+          WriteVarint((static_cast<uint64_t>(it->name.GetStringLength()) << 1) | 1, buffer);
+          buffer.append(it->name.GetString(), it->name.GetStringLength());
+        }
+        EncodeValue(it->value, buffer);
+      }
+      break;
+  }
+}
+
+bool
+BinaryMessageCodec::DecodeValue (const char *&data, const char *end, rapidjson::Value &value,
+                                 rapidjson::Document::AllocatorType &allocator, int depth)
+{
+  uint64_t length;
+
+  if (data >= end || depth > m_maxDepth)
+    return false;
+
+  switch (static_cast<uint8_t>(*data++))
+  {
+    case TAG_NULL:
+      value.SetNull();
+      return true;
+    case TAG_FALSE:
+      value.SetBool(false);
+      return true;
+    case TAG_TRUE:
+      value.SetBool(true);
+      return true;
+    case TAG_INT:
+    {
+      uint64_t zigzag;
+      if (!ReadVarint(data, end, zigzag))
+        return false;
+      value.SetInt64(static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1));
+      return true;
+    }
+    case TAG_UINT:
+    {
+      uint64_t number;
+      if (!ReadVarint(data, end, number))
+        return false;
+      value.SetUint64(number);
+      return true;
+    }
+    case TAG_DOUBLE:
+    {
+      uint64_t bits = 0;
+      double number;
+      if (end - data < 8)
+        return false;
+      for (int i = 0; i < 8; i++)
+        bits |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+      std::memcpy(&number, &bits, sizeof(number));
+      data += 8;
+      value.SetDouble(number);
+      return true;
+    }
+    case TAG_STRING:
+      if (!ReadVarint(data, end, length) || length > static_cast<uint64_t>(end - data))
+        return false;
+      value.SetString(data, static_cast<rapidjson::SizeType>(length), allocator);
+      data += length;
+      return true;
+    case TAG_ARRAY:
+    {
+      if (!ReadVarint(data, end, length) || length > static_cast<uint64_t>(end - data))
+        return false;
+
+      value.SetArray();
+      value.Reserve(static_cast<rapidjson::SizeType>(length), allocator);
+      for (uint64_t i = 0; i < length; i++)
+      {
+        rapidjson::Value item;
+        if (!DecodeValue(data, end, item, allocator, depth + 1))
+          return false;
+        value.PushBack(item, allocator);
+      }
+      return true;
+    }
+    case TAG_OBJECT:
+    {
+      if (!ReadVarint(data, end, length) || length > static_cast<uint64_t>(end - data))
+        return false;
+
+      value.SetObject();
+      for (uint64_t i = 0; i < length; i++)
+      {
+        uint64_t key;
+        rapidjson::Value member;
+
+        if (!ReadVarint(data, end, key))
+          return false;
+
+        if ((key & 1) == 0)
+        {
+          if ((key >> 1) >= g_messageKeysCount)
+            return false;
+          value.AddMember(rapidjson::StringRef(g_messageKeys[key >> 1]), member, allocator);
+        }
+        else
+        {
+          uint64_t keyLength = key >> 1;
+          if (keyLength > static_cast<uint64_t>(end - data))
+            return false;
+          // the name is kept in the allocator of the document, like a copied string value
+          char *name = static_cast<char*>(allocator.Malloc(keyLength + 1));
+          memcpy(name, data, keyLength);
+          name[keyLength] = '\0';
+          data += keyLength;
+          value.AddMember(rapidjson::StringRef(name, static_cast<size_t>(keyLength)), member, allocator);
+        }
+
+        // the member is decoded in place, so no value is copied or moved into the object
+        if (!DecodeValue(data, end, (value.MemberEnd() - 1)->value, allocator, depth + 1))
+          return false;
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+void
+BinaryMessageCodec::WriteVarint (uint64_t value, std::string &buffer)
+{
+  while (value >= 0x80)
+  {
+    buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<char>(value));
+}
+
+bool
+BinaryMessageCodec::ReadVarint (const char *&data, const char *end, uint64_t &value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64 && data < end; shift += 7)
+  {
+    uint8_t byte = static_cast<uint8_t>(*data++);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+} // Namespace ns3
@@ -0,0 +1,180 @@
+/**
+ * This file contains the declarations of the message codecs used to put the
+ * rapidjson documents of the protocol messages on the wire.
+ */
+
+#ifndef SIMPOS_MESSAGE_CODEC_H
+#define SIMPOS_MESSAGE_CODEC_H
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+#include "../../rapidjson/document.h"
+
+/**
+ * Switch of the per message rendering in the log. By default the messages are rendered only
+ * in builds with NS_LOG support (debug), so optimized builds never pay for it. Define it as 0
+ * to remove the rendering from the debug builds too.
+ */
+#ifndef SIMPOS_MESSAGE_RENDERING
+#ifdef NS3_LOG_ENABLE
+#define SIMPOS_MESSAGE_RENDERING 1
+#else
+#define SIMPOS_MESSAGE_RENDERING 0
+#endif
+#endif
+
+namespace ns3 {
+
+/**
+ * The implemented message codecs.
+ */
+enum MessageCodecType
+{
+  BINARY_CODEC,     //0 -> compact tagged binary encoding (default)
+  JSON_CODEC        //1 -> human readable json, useful for debugging
+};
+
+const char* getMessageCodecName(enum MessageCodecType codec);
+
+
+/**
+ * Base class of the message codecs. A codec turns the rapidjson document of a message
+ * into a payload and back. Every payload is put on the wire as a frame, which is
+ * the payload prefixed by its length (4 bytes, big endian), so no delimiter is needed
+ * and payloads are allowed to contain arbitrary bytes (e.g. vrf proofs).
+ */
+class MessageCodec
+{
+public:
+  static const uint32_t FRAME_HEADER_SIZE = 4;
+
+  virtual ~MessageCodec (void);
+
+  virtual enum MessageCodecType GetType (void) const = 0;
+
+  /**
+   * Appends the payload of the message to the buffer
+   * \param message the message to encode (must be an object)
+   * \param buffer the output buffer
+   */
+  virtual void Encode (const rapidjson::Value &message, std::string &buffer) const = 0;
+
+  /**
+   * Decodes the payload into the message document
+   * \param data pointer to the payload
+   * \param size size of the payload
+   * \param message the output document
+   * \return false if the payload is corrupted
+   */
+  virtual bool Decode (const char *data, uint32_t size, rapidjson::Document &message) const = 0;
+
+  /**
+   * Appends the whole frame (length prefix + payload) of the message to the buffer
+   */
+  void EncodeFrame (const rapidjson::Value &message, std::string &buffer) const;
+
+  /**
+   * \return the payload length stored in the frame header pointed by data
+   */
+  static uint32_t ReadFrameLength (const char *data);
+
+  /**
+   * Renders the message as json string, used only for logging
+   */
+  static std::string ToJsonString (const rapidjson::Value &message);
+
+  /**
+   * \return the codec instance of the given type
+   */
+  static const MessageCodec* Get (enum MessageCodecType type);
+
+  /**
+   * \return the codec used by the nodes created from now on
+   */
+  static const MessageCodec* GetDefault (void);
+
+  static void SetDefaultType (enum MessageCodecType type);
+  static enum MessageCodecType GetDefaultType (void);
+
+private:
+  static enum MessageCodecType m_defaultType;
+};
+
+
+/**
+ * Codec putting the stringified json on the wire, as the original simulator did.
+ */
+class JsonMessageCodec : public MessageCodec
+{
+public:
+  virtual enum MessageCodecType GetType (void) const;
+  virtual void Encode (const rapidjson::Value &message, std::string &buffer) const;
+  virtual bool Decode (const char *data, uint32_t size, rapidjson::Document &message) const;
+};
+
+
+/**
+ * Compact binary codec. Every value is encoded as one type tag followed by its content:
+ * integers as zigzag varints, doubles as 8 raw bytes, strings and containers prefixed by their
+ * varint length. Member names known to the protocols are sent as an index to the key dictionary,
+ * the other ones are sent as raw strings. The dictionary can only be appended to.
+ */
+class BinaryMessageCodec : public MessageCodec
+{
+public:
+  virtual enum MessageCodecType GetType (void) const;
+  virtual void Encode (const rapidjson::Value &message, std::string &buffer) const;
+  virtual bool Decode (const char *data, uint32_t size, rapidjson::Document &message) const;
+
+private:
+  enum ValueTag
+  {
+    TAG_NULL,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_INT,
+    TAG_UINT,
+    TAG_DOUBLE,
+    TAG_STRING,
+    TAG_ARRAY,
+    TAG_OBJECT
+  };
+
+  static void EncodeValue (const rapidjson::Value &value, std::string &buffer);
+  static bool DecodeValue (const char *&data, const char *end, rapidjson::Value &value,
+                           rapidjson::Document::AllocatorType &allocator, int depth);
+
+  static void WriteVarint (uint64_t value, std::string &buffer);
+  static bool ReadVarint (const char *&data, const char *end, uint64_t &value);
+
+  static const int m_maxDepth = 32;
+};
+
+
+/**
+ * Lazy rendering of a message for the log. The message is rendered only when the renderer
+ * is written to a stream, which NS_LOG_* macros do only when the log level is enabled, e.g.
+ * NS_LOG_INFO ("sent " << RenderMessage(d));
+ */
+class MessageRenderer
+{
+public:
+  explicit MessageRenderer (const rapidjson::Value &message) : m_message (message) {}
+
+  const rapidjson::Value &GetMessage (void) const { return m_message; }
+
+private:
+  const rapidjson::Value &m_message;
+};
+
+inline MessageRenderer RenderMessage (const rapidjson::Value &message)
+{
+  return MessageRenderer (message);
+}
+
+std::ostream& operator<< (std::ostream &os, const MessageRenderer &renderer);
+
+} // Namespace ns3
+
+#endif //SIMPOS_MESSAGE_CODEC_H
@@ -0,0 +1,76 @@
+/**
+ * This file contains the definitions of the functions declared in seen-message-cache.h
+ */
+
+#include "seen-message-cache.h"
+
+namespace ns3 {
+
+SeenMessageCache::SeenMessageCache (uint32_t capacity) : m_capacity (capacity)
+{
+}
+
+bool
+SeenMessageCache::IsDuplicate (enum Messages type, int senderId, int iteration)
+{
+  Counters &counters = m_counters[type];
+  counters.received++;
+
+  if (m_seen.find (MakeKey (type, senderId, iteration)) == m_seen.end ())
+    return false;
+
+  counters.duplicates++;
+  return true;
+}
+
+void
+SeenMessageCache::Insert (enum Messages type, int senderId, int iteration)
+{
+  uint64_t key = MakeKey (type, senderId, iteration);
+
+  if (!m_seen.insert (key).second)
+    return;
+
+  m_order.push_back (key);
+  if (m_order.size () > m_capacity)
+  {
+    m_seen.erase (m_order.front ());
+    m_order.pop_front ();
+  }
+}
+
+uint64_t
+SeenMessageCache::GetNoReceived (enum Messages type) const
+{
+  auto it = m_counters.find (type);
+  return it != m_counters.end () ? it->second.received : 0;
+}
+
+uint64_t
+SeenMessageCache::GetNoDuplicates (enum Messages type) const
+{
+  auto it = m_counters.find (type);
+  return it != m_counters.end () ? it->second.duplicates : 0;
+}
+
+double
+SeenMessageCache::GetDuplicateRate (enum Messages type) const
+{
+  uint64_t received = GetNoReceived (type);
+
+  if (received == 0)
+    return 0;
+
+  return static_cast<double>(GetNoDuplicates (type)) / received;
+}
+
+uint64_t
+SeenMessageCache::MakeKey (enum Messages type, int senderId, int iteration)
+{
+  // 8 bits of the type, 24 bits of the iteration and 32 bits of the sender
+  return (static_cast<uint64_t>(type) << 56)
+         | ((static_cast<uint64_t>(iteration) & 0xffffff) << 32)
+         | static_cast<uint32_t>(senderId);
+}
+
+} // Namespace ns3
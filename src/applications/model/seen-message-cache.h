@@ -0,0 +1,73 @@
+/**
+ * This file contains the declaration of the SeenMessageCache, which recognizes the gossiped
+ * votes and proposals that were already accepted, before their VRF proofs are verified again.
+ */
+
+#ifndef SIMPOS_SEEN_MESSAGE_CACHE_H
+#define SIMPOS_SEEN_MESSAGE_CACHE_H
+
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <unordered_set>
+#include "ns3/blockchain.h"
+
+namespace ns3 {
+
+/**
+ * Bounded set of the identities (message type, sender, iteration or epoch) of the accepted messages.
+ * When the capacity is reached, the oldest identity is forgotten. The cache counts the received
+ * and duplicate messages of every type.
+ */
+class SeenMessageCache
+{
+public:
+  explicit SeenMessageCache (uint32_t capacity = 65536);
+
+  /**
+   * \brief Counts the received message and checks if it was already accepted
+   * \param type the type of the message
+   * \param senderId the id of the voter or proposer
+   * \param iteration the iteration, slot or epoch of the message
+   * \return true if the message is a duplicate
+   */
+  bool IsDuplicate (enum Messages type, int senderId, int iteration);
+
+  /**
+   * Remembers the accepted message
+   */
+  void Insert (enum Messages type, int senderId, int iteration);
+
+  /**
+   * \return the number of received messages of the type
+   */
+  uint64_t GetNoReceived (enum Messages type) const;
+
+  /**
+   * \return the number of received duplicates of the type
+   */
+  uint64_t GetNoDuplicates (enum Messages type) const;
+
+  /**
+   * \return the ratio of the duplicates to the received messages of the type
+   */
+  double GetDuplicateRate (enum Messages type) const;
+
+private:
+  static uint64_t MakeKey (enum Messages type, int senderId, int iteration);
+
+  struct Counters
+  {
+    uint64_t received;
+    uint64_t duplicates;
+  };
+
+  uint32_t                                m_capacity;
+  std::unordered_set<uint64_t>            m_seen;         //the identities of the accepted messages
+  std::deque<uint64_t>                    m_order;        //the identities in the order of insertion, for the eviction
+  std::map<int, Counters>                 m_counters;     //the counters by the message type
+};
+
+} // Namespace ns3
+
+#endif /* SIMPOS_SEEN_MESSAGE_CACHE_H */
@@ -0,0 +1,92 @@
+/**
+ * This file contains the definitions of the functions declared in stake-sortition.h
+ */
+
+#include "ns3/log.h"
+#include "stake-sortition.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("StakeSortition");
+
+/**
+ * The table ends when the rest of the probability is under the precision of the VRF fraction
+ */
+static const double CDF_END = 1.0 - 1e-15;
+
+StakeSortition*
+StakeSortition::Get (uint32_t committeeSize, uint64_t totalStake)
+{
+  static std::map<std::pair<uint32_t, uint64_t>, StakeSortition> instances;
+
+  if (totalStake == 0)
+    NS_FATAL_ERROR ("The total stake of the sortition has to be set");
+
+  std::pair<uint32_t, uint64_t> key (committeeSize, totalStake);
+  auto it = instances.find (key);
+  if (it == instances.end ())
+    it = instances.insert (std::make_pair (key, StakeSortition (committeeSize, totalStake))).first;
+  return &it->second;
+}
+
+StakeSortition::StakeSortition (uint32_t committeeSize, uint64_t totalStake)
+{
+  m_probability = std::min (1.0, static_cast<double>(committeeSize) / totalStake);
+}
+
+uint32_t
+StakeSortition::Select (const unsigned char *vrfOut, uint64_t stake)
+{
+  if (stake == 0)
+    return 0;
+  if (m_probability >= 1.0)
+    return stake;
+
+  // the number of the sub-users j is the interval [CDF(j-1), CDF(j)) containing the fraction
+  const std::vector<double> &cdf = GetTable (stake);
+  return std::upper_bound (cdf.begin (), cdf.end (), ToFraction (vrfOut)) - cdf.begin ();
+}
+
+double
+StakeSortition::ToFraction (const unsigned char *vrfOut)
+{
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++)
+    value = (value << 8) | vrfOut[i];
+  return std::ldexp (static_cast<double>(value >> 11), -53);
+}
+
+const std::vector<double>&
+StakeSortition::GetTable (uint64_t stake)
+{
+  auto it = m_tables.find (stake);
+  if (it != m_tables.end ())
+    return it->second;
+
+  // the binomial probabilities are computed in the log space, (1-p)^w underflows for large stakes
+  std::vector<double> &cdf = m_tables[stake];
+  double logP = std::log (m_probability);
+  double logQ = std::log1p (-m_probability);
+  double logStakeFactorial = std::lgamma (stake + 1.0);
+  double mean = stake * m_probability;
+  double sum = 0;
+
+  for (uint64_t k = 0; k < stake; k++)
+  {
+    sum += std::exp (logStakeFactorial - std::lgamma (k + 1.0) - std::lgamma (stake - k + 1.0)
+                     + k * logP + (stake - k) * logQ);
+    cdf.push_back (sum);
+
+    if (sum >= CDF_END && k >= mean)
+      break;
+  }
+
+  NS_LOG_INFO ("Sortition table of stake " << stake << " has " << cdf.size () << " entries");
+  return cdf;
+}
+
+} // Namespace ns3
@@ -0,0 +1,63 @@
+/**
+ * This file contains the declaration of the StakeSortition, which selects the stake weighted
+ * committee members by the VRF output (Algorand cryptographic sortition).
+ */
+
+#ifndef SIMPOS_STAKE_SORTITION_H
+#define SIMPOS_STAKE_SORTITION_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Cryptographic sortition: every unit of the stake is a sub-user selected with the probability
+ * committeeSize / totalStake, so the number of the selected sub-users of the stake w follows the binomial
+ * distribution B(w, p). The VRF output read as a fraction in [0, 1) falls into one interval of its CDF,
+ * the index of the interval is the number of the selected sub-users (the weight of the vote).
+ *
+ * The CDF of every stake bucket (the stake value) is computed once and kept, the selection is then
+ * a binary search in the table. The tables end where the CDF reaches 1, so they stay short
+ * even for large stakes. The instances are shared by the participants with the same parameters.
+ */
+class StakeSortition
+{
+public:
+  /**
+   * \param committeeSize the expected number of the selected sub-users (the expected weight of the committee)
+   * \param totalStake the total stake of all participants
+   * \return the sortition shared by the participants with the same parameters
+   */
+  static StakeSortition* Get (uint32_t committeeSize, uint64_t totalStake);
+
+  StakeSortition (uint32_t committeeSize, uint64_t totalStake);
+
+  /**
+   * \brief Selects the sub-users of the stake by the VRF output
+   * \param vrfOut the VRF output (at least 8 bytes) of a successfully verified proof, the callers have to drop
+   *        the votes with an invalid proof before the selection
+   * \param stake the stake of the participant
+   * \return the number of the selected sub-users, 0 if the participant is not in the committee
+   */
+  uint32_t Select (const unsigned char *vrfOut, uint64_t stake);
+
+  /**
+   * \return the VRF output as a fraction in [0, 1), the ordering is the same as of memcmp
+   */
+  static double ToFraction (const unsigned char *vrfOut);
+
+private:
+  /**
+   * \brief Finds the CDF table of the stake, the table is computed at the first use
+   */
+  const std::vector<double>& GetTable (uint64_t stake);
+
+  double                                              m_probability;    //the probability of selecting one sub-user
+  std::unordered_map<uint64_t, std::vector<double>>   m_tables;         //the CDF tables by the stake
+};
+
+} // Namespace ns3
+
+#endif /* SIMPOS_STAKE_SORTITION_H */
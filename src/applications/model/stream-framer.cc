@@ -0,0 +1,124 @@
+/**
+ * This file contains the definitions of the functions declared in stream-framer.h
+ */
+
+#include "ns3/log.h"
+#include "stream-framer.h"
+#include "message-codec.h"
+#include <cstring>
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("StreamFramer");
+
+StreamFramer::StreamFramer (void) : m_head (0), m_size (0), m_peekedFrameSize (0)
+{
+}
+
+void
+StreamFramer::Append (Ptr<Packet> packet)
+{
+  uint32_t packetSize = packet->GetSize ();
+
+  if (packetSize == 0)
+    return;
+
+  Reserve(m_size + packetSize);
+
+  uint32_t capacity = m_buffer.size();
+  uint32_t tail = (m_head + m_size) & (capacity - 1);
+  uint32_t firstPart = std::min(packetSize, capacity - tail);
+
+  packet->CopyData (reinterpret_cast<uint8_t*>(&m_buffer[tail]), firstPart);
+  if (firstPart < packetSize)
+    packet->CreateFragment (firstPart, packetSize - firstPart)->CopyData (reinterpret_cast<uint8_t*>(&m_buffer[0]), packetSize - firstPart);
+
+  m_size += packetSize;
+}
+
+bool
+StreamFramer::PeekFrame (MessageView &frame)
+{
+  if (m_size < MessageCodec::FRAME_HEADER_SIZE)
+    return false;
+
+  uint32_t capacity = m_buffer.size();
+  char header[MessageCodec::FRAME_HEADER_SIZE];
+
+  for (uint32_t i = 0; i < MessageCodec::FRAME_HEADER_SIZE; i++)
+    header[i] = static_cast<char>(GetByte(i));
+
+  uint32_t payloadSize = MessageCodec::ReadFrameLength(header);
+
+  if (m_size - MessageCodec::FRAME_HEADER_SIZE < payloadSize)
+    return false;
+
+  uint32_t payloadStart = (m_head + MessageCodec::FRAME_HEADER_SIZE) & (capacity - 1);
+
+  if (payloadStart + payloadSize <= capacity)
+    frame.data = payloadSize > 0 ? &m_buffer[payloadStart] : "";
+  else
+  {
+    uint32_t firstPart = capacity - payloadStart;
+
+    m_linearized.resize(payloadSize);
+    std::memcpy(&m_linearized[0], &m_buffer[payloadStart], firstPart);
+    std::memcpy(&m_linearized[firstPart], &m_buffer[0], payloadSize - firstPart);
+    frame.data = &m_linearized[0];
+  }
+
+  frame.size = payloadSize;
+  m_peekedFrameSize = MessageCodec::FRAME_HEADER_SIZE + payloadSize;
+  return true;
+}
+
+void
+StreamFramer::PopFrame (void)
+{
+  NS_ASSERT_MSG (m_peekedFrameSize > 0, "PopFrame called without a peeked frame");
+
+  m_size -= m_peekedFrameSize;
+  m_head = m_size == 0 ? 0 : (m_head + m_peekedFrameSize) & (m_buffer.size() - 1);
+  m_peekedFrameSize = 0;
+}
+
+uint32_t
+StreamFramer::GetBufferedSize (void) const
+{
+  return m_size;
+}
+
+void
+StreamFramer::Reserve (uint32_t size)
+{
+  uint32_t capacity = m_buffer.size();
+
+  if (size <= capacity)
+    return;
+
+  uint32_t newCapacity = capacity > 0 ? capacity : m_initialCapacity;
+  while (newCapacity < size)
+    newCapacity <<= 1;
+
+  NS_LOG_INFO ("Growing the stream buffer from " << capacity << " to " << newCapacity << " bytes");
+
+  std::vector<char> newBuffer(newCapacity);
+  if (m_size > 0)
+  {
+    uint32_t firstPart = std::min(m_size, capacity - m_head);
+    std::memcpy(&newBuffer[0], &m_buffer[m_head], firstPart);
+    std::memcpy(&newBuffer[firstPart], &m_buffer[0], m_size - firstPart);
+  }
+
+  m_buffer.swap(newBuffer);
+  m_head = 0;
+}
+
+uint8_t
+StreamFramer::GetByte (uint32_t offset) const
+{
+  return static_cast<uint8_t>(m_buffer[(m_head + offset) & (m_buffer.size() - 1)]);
+}
+
+} // Namespace ns3
@@ -0,0 +1,78 @@
+/**
+ * This file contains the declaration of the StreamFramer, which splits the byte stream
+ * received from one peer into the length prefixed frames created by MessageCodec::EncodeFrame.
+ */
+
+#ifndef SIMPOS_STREAM_FRAMER_H
+#define SIMPOS_STREAM_FRAMER_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+
+namespace ns3 {
+
+/**
+ * Read only view of one received message payload. The view is valid only
+ * until the frame is popped from the framer, so it must not be stored.
+ */
+struct MessageView
+{
+  const char *data;
+  uint32_t    size;
+};
+
+
+/**
+ * Per peer framing of the received byte stream. The received data are kept in a growable
+ * ring buffer and the frames are handed out as views into it, the payload is copied only
+ * when the frame wraps around the end of the ring.
+ */
+class StreamFramer
+{
+public:
+  StreamFramer (void);
+
+  /**
+   * Appends the content of the received packet to the buffered data
+   */
+  void Append (Ptr<Packet> packet);
+
+  /**
+   * \brief Gets the first complete frame
+   * \param frame the view of the payload of the frame
+   * \return false if there is no complete frame buffered
+   */
+  bool PeekFrame (MessageView &frame);
+
+  /**
+   * Removes the frame returned by the last PeekFrame call
+   */
+  void PopFrame (void);
+
+  /**
+   * \return the number of buffered bytes
+   */
+  uint32_t GetBufferedSize (void) const;
+
+private:
+  /**
+   * Grows the ring so it can hold at least size bytes, the buffered data are moved to its beginning
+   */
+  void Reserve (uint32_t size);
+
+  uint8_t GetByte (uint32_t offset) const;
+
+  std::vector<char> m_buffer;                     //!< the ring, its size is always a power of two
+  uint32_t          m_head;                       //!< position of the first buffered byte
+  uint32_t          m_size;                       //!< number of buffered bytes
+  uint32_t          m_peekedFrameSize;            //!< size of the frame (header included) returned by PeekFrame, 0 if none
+  std::vector<char> m_linearized;                 //!< holds the payload of a frame wrapping around the end of the ring
+
+  static const uint32_t m_initialCapacity = 4096;
+};
+
+} // Namespace ns3
+
+#endif //SIMPOS_STREAM_FRAMER_H
@@ -0,0 +1,126 @@
+/**
+ * This file contains the definitions of the functions declared in vrf-backend.h
+ */
+
+#include "ns3/log.h"
+#include "vrf-backend.h"
+#include "../libsodium/include/sodium.h"
+#include <cstring>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VrfBackend");
+
+const char* getVrfBackendName(enum VrfBackendType backend)
+{
+  switch (backend)
+  {
+    case SODIUM_VRF:
+      return "SODIUM_VRF";
+    case SIMULATED_VRF:
+      return "SIMULATED_VRF";
+  }
+  return 0;
+}
+
+enum VrfBackendType VrfBackend::m_type = SODIUM_VRF;
+double VrfBackend::m_proveDelay = 0;
+double VrfBackend::m_verifyDelay = 0;
+
+int
+VrfBackend::Keypair (unsigned char *pk, unsigned char *sk)
+{
+  if (m_type == SODIUM_VRF)
+    return crypto_vrf_keypair (pk, sk);
+
+  unsigned char seed[32];
+  randombytes_buf (seed, sizeof seed);
+  return KeypairFromSeed (pk, sk, seed);
+}
+
+int
+VrfBackend::KeypairFromSeed (unsigned char *pk, unsigned char *sk, const unsigned char *seed)
+{
+  if (m_type == SODIUM_VRF)
+    return crypto_vrf_keypair_from_seed (pk, sk, seed);
+
+  // the secret key is the seed followed by the public key, as in libsodium
+  memmove (sk, seed, 32);
+  crypto_generichash (pk, PUBLIC_KEY_SIZE, sk, 32, NULL, 0);
+  memcpy (sk + 32, pk, PUBLIC_KEY_SIZE);
+  return 0;
+}
+
+int
+VrfBackend::Prove (unsigned char *proof, const unsigned char *sk, const unsigned char *m, unsigned long long mlen)
+{
+  if (m_type == SODIUM_VRF)
+    return crypto_vrf_prove (proof, sk, m, mlen);
+
+  // the output is the hash of the input keyed by the public key, the rest of the proof is unused
+  memset (proof, 0, PROOF_SIZE);
+  crypto_generichash (proof, OUTPUT_SIZE, m, mlen, sk + 32, PUBLIC_KEY_SIZE);
+  return 0;
+}
+
+int
+VrfBackend::ProofToHash (unsigned char *output, const unsigned char *proof)
+{
+  if (m_type == SODIUM_VRF)
+    return crypto_vrf_proof_to_hash (output, proof);
+
+  memcpy (output, proof, OUTPUT_SIZE);
+  return 0;
+}
+
+int
+VrfBackend::Verify (unsigned char *output, const unsigned char *pk, const unsigned char *proof,
+                    const unsigned char *m, unsigned long long mlen)
+{
+  if (m_type == SODIUM_VRF)
+    return crypto_vrf_verify (output, pk, proof, m, mlen);
+
+  unsigned char expected[PROOF_SIZE];
+  memset (expected, 0, sizeof expected);
+  crypto_generichash (expected, OUTPUT_SIZE, m, mlen, pk, PUBLIC_KEY_SIZE);
+
+  if (memcmp (expected, proof, sizeof expected) != 0)
+    return -1;
+
+  memcpy (output, expected, OUTPUT_SIZE);
+  return 0;
+}
+
+void
+VrfBackend::SetType (enum VrfBackendType type)
+{
+  NS_LOG_FUNCTION (getVrfBackendName(type));
+  m_type = type;
+}
+
+enum VrfBackendType
+VrfBackend::GetType (void)
+{
+  return m_type;
+}
+
+void
+VrfBackend::SetCpuDelays (double proveDelay, double verifyDelay)
+{
+  m_proveDelay = proveDelay;
+  m_verifyDelay = verifyDelay;
+}
+
+double
+VrfBackend::GetProveDelay (void)
+{
+  return m_proveDelay;
+}
+
+double
+VrfBackend::GetVerifyDelay (void)
+{
+  return m_verifyDelay;
+}
+
+} // Namespace ns3
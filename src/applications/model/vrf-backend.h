@@ -0,0 +1,64 @@
+/**
+ * This file contains the declaration of the VrfBackend, which selects the implementation of the VRF
+ * operations used by the proof of stake participants.
+ */
+
+#ifndef SIMPOS_VRF_BACKEND_H
+#define SIMPOS_VRF_BACKEND_H
+
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * The implementations of the VRF operations.
+ */
+enum VrfBackendType
+{
+  SODIUM_VRF,       //0 -> libsodium ECVRF (default)
+  SIMULATED_VRF     //1 -> keyed hash, no real proofs, for large simulations
+};
+
+const char* getVrfBackendName(enum VrfBackendType backend);
+
+
+/**
+ * VRF operations with the interface of the libsodium crypto_vrf_* functions. The simulated backend
+ * derives the output from a keyed hash (BLAKE2b keyed by the public key) of the input, so the outputs
+ * are uniformly distributed and compared against the same thresholds, but the proofs are not secure.
+ * The CPU time of the real operations can be charged in the simulated time instead (see BitcoinNode::ChargeCpuTime).
+ */
+class VrfBackend
+{
+public:
+  static const uint32_t PUBLIC_KEY_SIZE = 32;
+  static const uint32_t SECRET_KEY_SIZE = 64;
+  static const uint32_t PROOF_SIZE = 80;
+  static const uint32_t OUTPUT_SIZE = 64;
+
+  static int Keypair (unsigned char *pk, unsigned char *sk);
+  static int KeypairFromSeed (unsigned char *pk, unsigned char *sk, const unsigned char *seed);
+  static int Prove (unsigned char *proof, const unsigned char *sk, const unsigned char *m, unsigned long long mlen);
+  static int ProofToHash (unsigned char *output, const unsigned char *proof);
+  static int Verify (unsigned char *output, const unsigned char *pk, const unsigned char *proof,
+                     const unsigned char *m, unsigned long long mlen);
+
+  static void SetType (enum VrfBackendType type);
+  static enum VrfBackendType GetType (void);
+
+  /**
+   * \brief Sets the simulated CPU time (s) of one prove and one verify operation
+   */
+  static void SetCpuDelays (double proveDelay, double verifyDelay);
+  static double GetProveDelay (void);
+  static double GetVerifyDelay (void);
+
+private:
+  static enum VrfBackendType m_type;
+  static double m_proveDelay;
+  static double m_verifyDelay;
+};
+
+} // Namespace ns3
+
+#endif /* SIMPOS_VRF_BACKEND_H */
@@ -0,0 +1,190 @@
+/**
+ * This file contains the definitions of the functions declared in vrf-key-pool.h
+ */
+
+#include "ns3/log.h"
+#include "vrf-key-pool.h"
+#include "vrf-backend.h"
+#include "../libsodium/include/sodium.h"
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VrfKeyPool");
+
+static const char POOL_MAGIC[8] = {'S', 'I', 'M', 'P', 'O', 'S', 'K', 'P'};
+static const uint32_t POOL_VERSION = 1;
+
+/**
+ * Little endian helpers, the pool file does not depend on the host
+ */
+static void WriteUint (unsigned char *buffer, uint64_t value, int size)
+{
+  for (int i = 0; i < size; i++)
+    buffer[i] = (value >> (8 * i)) & 0xff;
+}
+
+static uint64_t ReadUint (const unsigned char *buffer, int size)
+{
+  uint64_t value = 0;
+  for (int i = 0; i < size; i++)
+    value |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+  return value;
+}
+
+VrfKeyPool&
+VrfKeyPool::GetInstance (void)
+{
+  static VrfKeyPool instance;
+  return instance;
+}
+
+VrfKeyPool::VrfKeyPool (void) : m_enabled (false), m_seed (0), m_map (nullptr), m_mapSize (0), m_noKeys (0)
+{
+}
+
+VrfKeyPool::~VrfKeyPool (void)
+{
+  if (m_map)
+    munmap (const_cast<unsigned char*>(m_map), m_mapSize);
+}
+
+void
+VrfKeyPool::SetSeed (uint64_t seed)
+{
+  NS_LOG_FUNCTION (seed);
+  m_seed = seed;
+  m_enabled = true;
+}
+
+bool
+VrfKeyPool::Load (const std::string &path)
+{
+  NS_LOG_FUNCTION (path);
+
+  int fd = open (path.c_str (), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat fileStat;
+  if (fstat (fd, &fileStat) != 0 || fileStat.st_size < HEADER_SIZE)
+  {
+    close (fd);
+    return false;
+  }
+
+  void *map = mmap (NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const unsigned char *header = static_cast<const unsigned char*>(map);
+  uint32_t noKeys = ReadUint (header + 24, 4);
+
+  if (memcmp (header, POOL_MAGIC, sizeof POOL_MAGIC) != 0
+      || ReadUint (header + 8, 4) != POOL_VERSION
+      || ReadUint (header + 12, 4) != VrfBackend::GetType ()
+      || static_cast<uint64_t>(fileStat.st_size) < HEADER_SIZE + static_cast<uint64_t>(noKeys) * ENTRY_SIZE)
+  {
+    NS_LOG_WARN ("Invalid key pool " << path);
+    munmap (map, fileStat.st_size);
+    return false;
+  }
+
+  if (m_map)
+    munmap (const_cast<unsigned char*>(m_map), m_mapSize);
+
+  m_map = header;
+  m_mapSize = fileStat.st_size;
+  m_noKeys = noKeys;
+  m_seed = ReadUint (header + 16, 8);
+  m_enabled = true;
+  return true;
+}
+
+bool
+VrfKeyPool::Save (const std::string &path, uint32_t noKeys) const
+{
+  NS_LOG_FUNCTION (path << noKeys);
+
+  // without a seed every generated pool would be the same one
+  if (!m_enabled)
+  {
+    NS_LOG_WARN ("The seed of the key pool is not set");
+    return false;
+  }
+
+  std::ofstream file (path.c_str (), std::ios::binary | std::ios::trunc);
+  if (!file)
+    return false;
+
+  unsigned char header[HEADER_SIZE];
+  memset (header, 0, sizeof header);
+  memcpy (header, POOL_MAGIC, sizeof POOL_MAGIC);
+  WriteUint (header + 8, POOL_VERSION, 4);
+  WriteUint (header + 12, VrfBackend::GetType (), 4);
+  WriteUint (header + 16, m_seed, 8);
+  WriteUint (header + 24, noKeys, 4);
+  file.write ((const char*) header, sizeof header);
+
+  unsigned char entry[ENTRY_SIZE];
+  for (uint32_t i = 0; i < noKeys; i++)
+  {
+    DeriveKeypair (i, entry, entry + VrfBackend::PUBLIC_KEY_SIZE);
+    file.write ((const char*) entry, sizeof entry);
+  }
+
+  return file.good ();
+}
+
+bool
+VrfKeyPool::IsEnabled (void) const
+{
+  return m_enabled;
+}
+
+void
+VrfKeyPool::GetKeypair (uint32_t index, unsigned char *pk, unsigned char *sk) const
+{
+  if (index >= m_noKeys)
+  {
+    DeriveKeypair (index, pk, sk);
+    return;
+  }
+
+  const unsigned char *entry = m_map + HEADER_SIZE + static_cast<size_t>(index) * ENTRY_SIZE;
+  memcpy (pk, entry, VrfBackend::PUBLIC_KEY_SIZE);
+  memcpy (sk, entry + VrfBackend::PUBLIC_KEY_SIZE, VrfBackend::SECRET_KEY_SIZE);
+}
+
+bool
+VrfKeyPool::GetGenesisSeed (unsigned char *vrfSeed) const
+{
+  if (!m_enabled)
+    return false;
+
+  unsigned char input[16];
+  WriteUint (input, m_seed, 8);
+  memcpy (input + 8, "genesis", 8);
+  crypto_generichash (vrfSeed, 32, input, sizeof input, NULL, 0);
+  return true;
+}
+
+void
+VrfKeyPool::DeriveKeypair (uint32_t index, unsigned char *pk, unsigned char *sk) const
+{
+  unsigned char input[12];
+  unsigned char keySeed[32];
+
+  WriteUint (input, m_seed, 8);
+  WriteUint (input + 8, index, 4);
+  crypto_generichash (keySeed, sizeof keySeed, input, sizeof input, NULL, 0);
+  VrfBackend::KeypairFromSeed (pk, sk, keySeed);
+}
+
+} // Namespace ns3
@@ -0,0 +1,87 @@
+/**
+ * This file contains the declaration of the VrfKeyPool, which provides reproducible VRF keypairs
+ * of the participants, derived from a seed or loaded from a pre-generated pool file.
+ */
+
+#ifndef SIMPOS_VRF_KEY_POOL_H
+#define SIMPOS_VRF_KEY_POOL_H
+
+#include <stdint.h>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * Keypairs of the participants by their node id. The keypair i is derived from the seed and the index i,
+ * so the same seed gives the same keys (and the same committees) in every run. The keys can be generated
+ * once into a pool file, which is memory mapped at startup. The keys with an index above the size of the
+ * pool are derived from the seed of the pool. If neither the seed nor the pool is set, the participants
+ * generate random keys as before.
+ *
+ * Pool file: 32 bytes header (magic, version, VRF backend, seed, number of keys) followed by
+ * the public key (32 bytes) and the secret key (64 bytes) of every participant.
+ */
+class VrfKeyPool
+{
+public:
+  /**
+   * \return the instance shared by all participants in the process
+   */
+  static VrfKeyPool& GetInstance (void);
+
+  /**
+   * \brief Enables the keys derived from the seed
+   */
+  void SetSeed (uint64_t seed);
+
+  /**
+   * \brief Memory maps the pool file and enables its keys
+   * \return false if the file cannot be mapped or it was generated for another VRF backend
+   */
+  bool Load (const std::string &path);
+
+  /**
+   * \brief Generates the pool file with the keys derived from the seed
+   * \return false if the seed is not set or the file cannot be written
+   */
+  bool Save (const std::string &path, uint32_t noKeys) const;
+
+  /**
+   * \return true if the keys are taken from the pool instead of generated randomly
+   */
+  bool IsEnabled (void) const;
+
+  /**
+   * \brief Gets the keypair of the participant, the pool has to be enabled
+   * \param index the id of the participant node
+   */
+  void GetKeypair (uint32_t index, unsigned char *pk, unsigned char *sk) const;
+
+  /**
+   * \brief Derives the VRF seed of the first round from the seed of the pool
+   * \return false if the pool is not enabled (the seed should be random)
+   */
+  bool GetGenesisSeed (unsigned char *vrfSeed) const;
+
+private:
+  VrfKeyPool (void);
+  ~VrfKeyPool (void);
+
+  static const uint32_t HEADER_SIZE = 32;
+  static const uint32_t ENTRY_SIZE = 96;
+
+  /**
+   * \brief Derives the keypair from the seed and the index
+   */
+  void DeriveKeypair (uint32_t index, unsigned char *pk, unsigned char *sk) const;
+
+  bool                  m_enabled;
+  uint64_t              m_seed;
+  const unsigned char  *m_map;          //the mapped pool file, nullptr if no pool is loaded
+  size_t                m_mapSize;
+  uint32_t              m_noKeys;       //the number of keys in the pool file
+};
+
+} // Namespace ns3
+
+#endif /* SIMPOS_VRF_KEY_POOL_H */
@@ -0,0 +1,129 @@
+/**
+ * This file contains the definitions of the functions declared in vrf-verify-cache.h
+ */
+
+#include "ns3/log.h"
+#include "vrf-verify-cache.h"
+#include "vrf-backend.h"
+#include <cstring>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VrfVerifyCache");
+
+VrfVerifyCache&
+VrfVerifyCache::GetInstance (void)
+{
+  static VrfVerifyCache instance;
+  return instance;
+}
+
+VrfVerifyCache::VrfVerifyCache (void) : m_maxSeeds (4), m_crossCheck (false), m_hits (0), m_misses (0)
+{
+}
+
+int
+VrfVerifyCache::Verify (unsigned char *output, const unsigned char *pk, const unsigned char *proof,
+                        const unsigned char *seed, unsigned long long seedLen)
+{
+  std::string seedKey ((const char*) seed, seedLen);
+  std::string key = std::string ((const char*) pk, 32) + std::string ((const char*) proof, 80);
+  Result result;
+  bool hit;
+  bool crossCheck;
+
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    Generation &generation = GetGeneration (seedKey);
+    auto it = generation.results.find (key);
+
+    if (it != generation.results.end ())
+    {
+      m_hits++;
+      result = it->second;
+      hit = true;
+      crossCheck = m_crossCheck;
+    }
+    else
+    {
+      m_misses++;
+      hit = false;
+      crossCheck = false;
+    }
+  }
+
+  if (!hit || crossCheck)
+  {
+    // the verification runs without the lock, so other threads are not blocked by it
+    Result fresh;
+    memset (fresh.output, 0, sizeof fresh.output);
+    fresh.rc = VrfBackend::Verify (fresh.output, pk, proof, seed, seedLen);
+
+    if (!hit)
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      GetGeneration (seedKey).results[key] = fresh;
+      result = fresh;
+    }
+    else if (fresh.rc != result.rc
+             || (fresh.rc == 0 && memcmp (fresh.output, result.output, sizeof fresh.output) != 0))
+      NS_FATAL_ERROR ("VrfVerifyCache: cached result does not match the verification");
+  }
+
+  // the output of an invalid proof is meaningless, the caller has to drop the message
+  if (result.rc == 0)
+    memcpy (output, result.output, sizeof result.output);
+  return result.rc;
+}
+
+void
+VrfVerifyCache::SetCrossCheck (bool crossCheck)
+{
+  std::lock_guard<std::mutex> lock (m_mutex);
+  m_crossCheck = crossCheck;
+}
+
+void
+VrfVerifyCache::SetMaxSeeds (uint32_t maxSeeds)
+{
+  if (maxSeeds == 0)
+    NS_FATAL_ERROR ("The VRF verify cache has to keep at least one seed");
+
+  std::lock_guard<std::mutex> lock (m_mutex);
+  m_maxSeeds = maxSeeds;
+}
+
+uint64_t
+VrfVerifyCache::GetNoHits (void) const
+{
+  std::lock_guard<std::mutex> lock (m_mutex);
+  return m_hits;
+}
+
+uint64_t
+VrfVerifyCache::GetNoMisses (void) const
+{
+  std::lock_guard<std::mutex> lock (m_mutex);
+  return m_misses;
+}
+
+VrfVerifyCache::Generation&
+VrfVerifyCache::GetGeneration (const std::string &seed)
+{
+  // there are only few seeds, the current one is usually at the back
+  for (auto it = m_generations.rbegin (); it != m_generations.rend (); it++)
+  {
+    if (it->seed == seed)
+      return *it;
+  }
+
+  m_generations.push_back (Generation ());
+  m_generations.back ().seed = seed;
+
+  if (m_generations.size () > m_maxSeeds)
+    m_generations.pop_front ();
+
+  return m_generations.back ();
+}
+
+} // Namespace ns3
@@ -0,0 +1,92 @@
+/**
+ * This file contains the declaration of the VrfVerifyCache, which shares the results of the VRF proof
+ * verifications between all participants simulated in the process.
+ */
+
+#ifndef SIMPOS_VRF_VERIFY_CACHE_H
+#define SIMPOS_VRF_VERIFY_CACHE_H
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ns3 {
+
+/**
+ * Process wide memo of VrfBackend::Verify results. Every proposal and vote is verified by all participants
+ * which receive it, so the result of the (public key, proof, seed) tuple is computed only by the first one.
+ * The results are grouped by the seed, only the results of the last few seeds (rounds, epochs) are kept.
+ */
+class VrfVerifyCache
+{
+public:
+  /**
+   * \return the instance shared by all participants in the process
+   */
+  static VrfVerifyCache& GetInstance (void);
+
+  /**
+   * \brief Same as VrfBackend::Verify, the result is taken from the cache if the tuple was already verified
+   * \param output the VRF output (64 bytes), written only if the proof is valid
+   * \param pk the public key of the prover (32 bytes)
+   * \param proof the VRF proof (80 bytes)
+   * \param seed the VRF input
+   * \param seedLen the length of the VRF input
+   * \return 0 if the proof is valid, -1 otherwise (the output must not be used)
+   */
+  int Verify (unsigned char *output, const unsigned char *pk, const unsigned char *proof,
+              const unsigned char *seed, unsigned long long seedLen);
+
+  /**
+   * \brief Enables verifying the cached results again, a mismatch stops the simulation (debugging)
+   */
+  void SetCrossCheck (bool crossCheck);
+
+  /**
+   * \brief Sets the number of the last seeds which results are kept
+   */
+  void SetMaxSeeds (uint32_t maxSeeds);
+
+  /**
+   * \return the number of verifications answered from the cache
+   */
+  uint64_t GetNoHits (void) const;
+
+  /**
+   * \return the number of computed verifications
+   */
+  uint64_t GetNoMisses (void) const;
+
+private:
+  VrfVerifyCache (void);
+
+  struct Result
+  {
+    int           rc;
+    unsigned char output[64];
+  };
+
+  struct Generation
+  {
+    std::string                               seed;
+    std::unordered_map<std::string, Result>   results;      //the results by the public key and the proof
+  };
+
+  /**
+   * \brief Finds the results of the seed, a new generation is added (and the oldest removed) for a new seed
+   */
+  Generation& GetGeneration (const std::string &seed);
+
+  mutable std::mutex        m_mutex;
+  std::deque<Generation>    m_generations;      //the results by the seed, the newest seed is at the back
+  uint32_t                  m_maxSeeds;
+  bool                      m_crossCheck;
+  uint64_t                  m_hits;
+  uint64_t                  m_misses;
+};
+
+} // Namespace ns3
+
+#endif /* SIMPOS_VRF_VERIFY_CACHE_H */